@@ -0,0 +1,329 @@
+/**
+ * almacenes.c: Conjunto de inventarios independientes (ver almacenes.h)
+ *
+ * Cada almacen es un arbol AVL propio con sus pools e indices; el del almacen
+ * activo vive en las globales de inventario.c y el de los demas en su
+ * EstadoInventario, de modo que todas las operaciones del nucleo sirven sin
+ * cambios una vez activado el almacen. La tabla de cadenas y el contador de
+ * IDs de pedido son comunes: un ID identifica el pedido en todo el conjunto.
+ *
+ * Guardar solo lee los arboles, asi que cada almacen se guarda en su propio
+ * hilo sin activarlo. Cargar reparte en hilos el mapeo y la validacion del
+ * checksum (lo que crece con el archivo) y arma los arboles despues, uno por
+ * uno, con su almacen activo.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "almacenes.h"
+
+typedef enum {
+    ARCHIVO_AUSENTE,                  // El almacen no tiene instantanea: arranca vacio
+    ARCHIVO_MAPEADO,                  // Instantanea mapeada y validada, lista para armar
+    ARCHIVO_OTRO                      // Formato anterior o invalido: lo decide cargar_arbol
+} EstadoArchivo;
+
+/**
+ * Estructura TrabajoAlmacenes: Guardado o mapeo de todos los almacenes en hilos
+ */
+typedef struct TrabajoAlmacenes {
+    const Almacenes *a;
+    bool guardar;                     // true: guardar_arbol; false: mapear y validar
+    int siguiente;                    // Proximo almacen sin tomar (acceso atomico)
+    bool ok[MAX_ALMACENES];           // Resultado del guardado de cada almacen
+    EstadoArchivo estado[MAX_ALMACENES];
+    void *mapeo[MAX_ALMACENES];       // Instantanea mapeada (ARCHIVO_MAPEADO)
+    size_t tam[MAX_ALMACENES];
+} TrabajoAlmacenes;
+
+
+void almacenes_iniciar(Almacenes *a) {
+    a->cantidad = 0;
+    a->activo = -1;
+}
+
+
+int almacenes_agregar(Almacenes *a, const char *nombre, const char *archivo, int desde) {
+    // Devuelve el indice del nuevo almacen, o -1 si no hay lugar o memoria
+    if (a->cantidad >= MAX_ALMACENES || almacenes_indice(a, nombre) >= 0) return -1;
+    EstadoInventario *e = estado_crear();
+    if (!e) return -1;
+    Almacen *al = &a->almacenes[a->cantidad];
+    snprintf(al->nombre, sizeof(al->nombre), "%s", nombre);
+    snprintf(al->archivo, sizeof(al->archivo), "%s", archivo);
+    al->desde = desde;
+    al->raiz = NULL;
+    al->estado = e;
+    return a->cantidad++;
+}
+
+
+int almacenes_indice(const Almacenes *a, const char *nombre) {
+    for (int i = 0; i < a->cantidad; i++) {
+        if (strcmp(a->almacenes[i].nombre, nombre) == 0) return i;
+    }
+    return -1;
+}
+
+
+int almacenes_ruta_fecha(const Almacenes *a, int fecha) {
+    // Almacen por rango: el de mayor 'desde' que no supera la fecha
+    int elegido = -1;
+    for (int i = 0; i < a->cantidad; i++) {
+        int desde = a->almacenes[i].desde;
+        if (desde > 0 && desde <= fecha &&
+            (elegido < 0 || desde > a->almacenes[elegido].desde)) {
+            elegido = i;
+        }
+    }
+    return elegido;
+}
+
+
+void almacenes_activar(Almacenes *a, int i) {
+    // Devolver el estado del activo a su almacen y traer el del pedido
+    if (a->activo == i) return;
+    if (a->activo >= 0) estado_intercambiar(a->almacenes[a->activo].estado);
+    estado_intercambiar(a->almacenes[i].estado);
+    a->activo = i;
+}
+
+
+void almacenes_desactivar(Almacenes *a) {
+    // Las globales vuelven al inventario propio del proceso
+    if (a->activo < 0) return;
+    estado_intercambiar(a->almacenes[a->activo].estado);
+    a->activo = -1;
+}
+
+
+bool almacenes_insertar(Almacenes *a, int i, int fecha, const char *producto, int stock) {
+    almacenes_activar(a, i);
+    Almacen *al = &a->almacenes[i];
+    int antes = al->raiz ? al->raiz->lotes_subarbol : 0;
+    // Sin memoria insertAVL devuelve NULL y el arbol queda intacto
+    Node *nuevo_root = insertAVL(al->raiz, fecha, producto, stock);
+    if (!nuevo_root) return false;
+    al->raiz = nuevo_root;
+    return al->raiz->lotes_subarbol > antes;
+}
+
+
+Node* almacenes_buscar(Almacenes *a, int i, int fecha) {
+    almacenes_activar(a, i);
+    return searchNode(a->almacenes[i].raiz, fecha);
+}
+
+
+bool almacenes_eliminar(Almacenes *a, int i, int fecha, uint32_t secuencia) {
+    almacenes_activar(a, i);
+    Almacen *al = &a->almacenes[i];
+    if (!buscar_lote(al->raiz, fecha, secuencia)) return false;
+    al->raiz = deleteNode(al->raiz, fecha, secuencia);
+    return true;
+}
+
+
+uint32_t almacenes_encolar(Almacenes *a, int i, int fecha, const char *destino, int cantidad) {
+    // Pedido sobre el primer lote del dia, como en el menu: solo si el lote
+    // alcanza, y descontando el stock al encolarlo
+    Node *lote = almacenes_buscar(a, i, fecha);
+    if (!lote || cantidad <= 0 || cantidad > lote->stock_total) return 0;
+    uint32_t id = enqueue_order(lote, destino, cantidad);
+    if (id) ajustar_stock(lote, -cantidad);
+    return id;
+}
+
+
+int almacenes_cancelar(Almacenes *a, uint32_t id) {
+    // Los IDs son unicos en el conjunto: se cancela en el almacen que lo tenga
+    for (int i = 0; i < a->cantidad; i++) {
+        almacenes_activar(a, i);
+        if (buscar_pedido_por_id(id)) return cancel_order_by_id(id);
+    }
+    return 0;
+}
+
+
+Totales almacenes_totales(const Almacenes *a) {
+    // Suma de los agregados de las raices: O(N) en almacenes
+    Totales t = { 0, 0, 0, 0 };
+    for (int i = 0; i < a->cantidad; i++) {
+        const Node *r = a->almacenes[i].raiz;
+        if (!r) continue;
+        t.lotes += r->lotes_subarbol;
+        t.stock += r->stock_subarbol;
+        t.pedidos += r->pedidos_subarbol;
+        t.pendiente += r->pendiente_subarbol;
+    }
+    return t;
+}
+
+
+void almacenes_reporte(const Almacenes *a, FILE *salida) {
+    // Mezcla por (fecha, secuencia) de los recorridos en orden de cada almacen;
+    // con pocos almacenes la menor cabeza se busca linealmente
+    IteradorRango it[MAX_ALMACENES];
+    Node *cabeza[MAX_ALMACENES];
+    for (int i = 0; i < a->cantidad; i++) {
+        it[i] = iterador_rango(a->almacenes[i].raiz, INT_MIN, INT_MAX);
+        cabeza[i] = iterador_rango_siguiente(&it[i]);
+    }
+
+    Totales t = almacenes_totales(a);
+    fprintf(salida, "\n=== REPORTE CONSOLIDADO (%d almacenes) ===\n", a->cantidad);
+    fprintf(salida, "Lotes: %d | Stock total: %lld | Pedidos pendientes: %ld (%lld unidades)\n",
+            t.lotes, t.stock, t.pedidos, t.pendiente);
+    for (;;) {
+        int menor = -1;
+        for (int i = 0; i < a->cantidad; i++) {
+            if (!cabeza[i]) continue;
+            if (menor < 0 ||
+                cabeza[i]->fecha_vencimiento < cabeza[menor]->fecha_vencimiento ||
+                (cabeza[i]->fecha_vencimiento == cabeza[menor]->fecha_vencimiento &&
+                 cabeza[i]->secuencia < cabeza[menor]->secuencia)) {
+                menor = i;
+            }
+        }
+        if (menor < 0) break;
+        Node *n = cabeza[menor];
+        fprintf(salida, "  %s | %-16s | %-20s | Stock: %d | Pedidos: %d\n",
+                formatear_fecha(n->fecha_vencimiento), a->almacenes[menor].nombre,
+                cadena_texto(n->producto), n->stock_total, n->num_pedidos);
+        cabeza[menor] = iterador_rango_siguiente(&it[menor]);
+    }
+}
+
+
+void almacenes_mapear(TrabajoAlmacenes *t, int i) {
+    // Parte de la carga que no toca el estado global: leer y verificar
+    const char *archivo = t->a->almacenes[i].archivo;
+    t->mapeo[i] = NULL;
+    FILE *f = fopen(archivo, "rb");
+    if (!f) {
+        t->estado[i] = ARCHIVO_AUSENTE;
+        return;
+    }
+    fclose(f);
+    void *datos = mapear_archivo(archivo, &t->tam[i]);
+    if (datos && snapshot_validar((const char*)datos, t->tam[i])) {
+        t->mapeo[i] = datos;
+        t->estado[i] = ARCHIVO_MAPEADO;
+        return;
+    }
+    if (datos) desmapear_archivo(datos, t->tam[i]);
+    t->estado[i] = ARCHIVO_OTRO;
+}
+
+
+void* almacenes_hilo(void *arg) {
+    // Cada hilo toma el proximo almacen libre hasta agotarlos
+    TrabajoAlmacenes *t = (TrabajoAlmacenes*)arg;
+    int i;
+    while ((i = __atomic_fetch_add(&t->siguiente, 1, __ATOMIC_RELAXED)) < t->a->cantidad) {
+        const Almacen *al = &t->a->almacenes[i];
+        if (t->guardar) t->ok[i] = guardar_arbol(al->raiz, al->archivo);
+        else almacenes_mapear(t, i);
+    }
+    return NULL;
+}
+
+
+void almacenes_repartir(TrabajoAlmacenes *t) {
+    // Un hilo por nucleo (sin pasar de la cantidad de almacenes); el actual
+    // tambien trabaja. Sin hilos disponibles todo queda en el actual.
+    t->siguiente = 0;
+#ifndef _WIN32
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    int hilos = nucleos > 0 ? (int)nucleos : 1;
+    if (hilos > t->a->cantidad) hilos = t->a->cantidad;
+    pthread_t extra[MAX_ALMACENES];
+    int lanzados = 0;
+    while (lanzados + 1 < hilos &&
+           pthread_create(&extra[lanzados], NULL, almacenes_hilo, t) == 0) {
+        lanzados++;
+    }
+    almacenes_hilo(t);
+    for (int k = 0; k < lanzados; k++) pthread_join(extra[k], NULL);
+#else
+    almacenes_hilo(t);
+#endif
+}
+
+
+bool almacenes_guardar(const Almacenes *a) {
+    // Cada almacen en su archivo; false si alguno no se pudo escribir
+    TrabajoAlmacenes *t = (TrabajoAlmacenes*)calloc(1, sizeof(TrabajoAlmacenes));
+    if (!t) return false;
+    t->a = a;
+    t->guardar = true;
+    almacenes_repartir(t);
+
+    bool ok = true;
+    for (int i = 0; i < a->cantidad; i++) {
+        if (!t->ok[i]) {
+            fprintf(stderr, "Error: No se pudo guardar el almacen '%s' en '%s'.\n",
+                    a->almacenes[i].nombre, a->almacenes[i].archivo);
+            ok = false;
+        }
+    }
+    free(t);
+    return ok;
+}
+
+
+bool almacenes_cargar(Almacenes *a) {
+    // Reemplaza el contenido de cada almacen por su instantanea; un almacen
+    // sin archivo queda vacio. false si algun archivo no se pudo cargar.
+    TrabajoAlmacenes *t = (TrabajoAlmacenes*)calloc(1, sizeof(TrabajoAlmacenes));
+    if (!t) return false;
+    t->a = a;
+    t->guardar = false;
+    almacenes_repartir(t);
+
+    // Armar los arboles en serie: cada uno en los pools de su almacen
+    bool ok = true;
+    for (int i = 0; i < a->cantidad; i++) {
+        Almacen *al = &a->almacenes[i];
+        almacenes_activar(a, i);
+        free_tree(al->raiz);
+        al->raiz = NULL;
+        if (t->estado[i] == ARCHIVO_MAPEADO) {
+            // snapshot_cargar suelta el mapeo: leer antes cuantos lotes trae
+            SnapshotCabecera cab;
+            memcpy(&cab, t->mapeo[i], sizeof(cab));
+            al->raiz = snapshot_cargar(t->mapeo[i], t->tam[i]);
+            if (!al->raiz && cab.num_nodos > 0) {
+                fprintf(stderr, "Error: No se pudo cargar el almacen '%s' desde '%s'.\n",
+                        al->nombre, al->archivo);
+                ok = false;
+            }
+        } else if (t->estado[i] == ARCHIVO_OTRO) {
+            al->raiz = cargar_arbol(al->archivo);
+            if (!al->raiz) {
+                fprintf(stderr, "Error: No se pudo cargar el almacen '%s' desde '%s'.\n",
+                        al->nombre, al->archivo);
+                ok = false;
+            }
+        }
+    }
+    free(t);
+    return ok;
+}
+
+
+void almacenes_liberar(Almacenes *a) {
+    // Liberar lotes, pools e indices de cada almacen (no la tabla de cadenas)
+    almacenes_desactivar(a);
+    for (int i = 0; i < a->cantidad; i++) {
+        estado_destruir(a->almacenes[i].estado);
+        a->almacenes[i].estado = NULL;
+        a->almacenes[i].raiz = NULL;
+    }
+    a->cantidad = 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * almacenes.h: Varios inventarios independientes en un proceso (un arbol por
+ * muelle, o por rango de fechas de un almacen grande), con guardado y carga
+ * en paralelo y reporte consolidado
+ *
+ * Compilar con -pthread junto a inventario.c; no admite VERSIONES ni
+ * INVENTARIO_CONCURRENTE (ambos suponen un unico arbol global).
+*/
+#ifndef ALMACENES_H
+#define ALMACENES_H
+
+#include "inventario.h"
+
+#if defined(VERSIONES) || defined(INVENTARIO_CONCURRENTE)
+#error "almacenes no admite VERSIONES ni INVENTARIO_CONCURRENTE (suponen un unico arbol)"
+#endif
+
+#define MAX_ALMACENES 64     // Almacenes por conjunto
+#define MAX_RUTA 256         // Longitud maxima del archivo de un almacen
+
+/**
+ * Estructura Almacen: Un inventario del conjunto y su archivo de instantanea
+ */
+typedef struct Almacen {
+    char nombre[MAX_NAME];            // Nombre del muelle o del rango
+    char archivo[MAX_RUTA];           // Instantanea propia (guardar_arbol/cargar_arbol)
+    int desde;                        // Primera fecha que recibe por ruteo por fecha (0 = ninguna)
+    Node *raiz;                       // Arbol de lotes del almacen
+    EstadoInventario *estado;         // Pools e indices mientras el almacen esta inactivo
+} Almacen;
+
+/**
+ * Estructura Almacenes: Conjunto de almacenes; uno a la vez es el activo
+ */
+typedef struct Almacenes {
+    Almacen almacenes[MAX_ALMACENES];
+    int cantidad;                     // Almacenes agregados
+    int activo;                       // Indice del almacen activo (-1 = ninguno)
+} Almacenes;
+
+void almacenes_iniciar(Almacenes *a);
+int almacenes_agregar(Almacenes *a, const char *nombre, const char *archivo, int desde);
+int almacenes_indice(const Almacenes *a, const char *nombre);
+int almacenes_ruta_fecha(const Almacenes *a, int fecha);
+void almacenes_activar(Almacenes *a, int i);
+void almacenes_desactivar(Almacenes *a);
+
+/* Operaciones sobre un almacen (lo activan) */
+bool almacenes_insertar(Almacenes *a, int i, int fecha, const char *producto, int stock);
+Node* almacenes_buscar(Almacenes *a, int i, int fecha);
+bool almacenes_eliminar(Almacenes *a, int i, int fecha, uint32_t secuencia);
+uint32_t almacenes_encolar(Almacenes *a, int i, int fecha, const char *destino, int cantidad);
+int almacenes_cancelar(Almacenes *a, uint32_t id);
+
+/* Todo el conjunto */
+Totales almacenes_totales(const Almacenes *a);
+void almacenes_reporte(const Almacenes *a, FILE *salida);
+bool almacenes_guardar(const Almacenes *a);
+bool almacenes_cargar(Almacenes *a);
+void almacenes_liberar(Almacenes *a);
+
+#endif
@@ -1,112 +1,12 @@
 #include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Estructura del pasajero (nodo del árbol)
-typedef struct Pasajero {
-    int documento; 
-    char destino[20];
-    char tipo_pasaje[20];
-    struct Pasajero *izq;
-    struct Pasajero *der;
-} Pasajero;
-
-// Crear un nuevo nodo
-Pasajero* nuevoPasajero(int documento, char destino[], char tipo[]) {
-    Pasajero p = (Pasajero)malloc(sizeof(Pasajero));
-    p->documento = documento;
-    strcpy(p->destino, destino);
-    strcpy(p->tipo_pasaje, tipo);
-    p->izq = p->der = NULL;
-    return p;
-}
-
-// Insertar en ABB
-Pasajero* insertar(Pasajero *raiz, int documento, char destino[], char tipo[]) {
-    if (raiz == NULL) {
-        return nuevoPasajero(documento, destino, tipo);
-    }
-    if (documento < raiz->documento) {
-        raiz->izq = insertar(raiz->izq, documento, destino, tipo);
-    } else if (documento > raiz->documento) {
-        raiz->der = insertar(raiz->der, documento, destino, tipo);
-    } else {
-        printf("El documento ya existe, no se inserta.\n");
-    }
-    return raiz;
-}
-
-// Recorrido INORDEN
-void inorden(Pasajero *r) {
-    if (r != NULL) {
-        inorden(r->izq);
-        printf("Doc: %d | Destino: %s | Tipo: %s\n", r->documento, r->destino, r->tipo_pasaje);
-        inorden(r->der);
-    }
-}
-
-// Recorrido PREORDEN
-void preorden(Pasajero *r) {
-    if (r != NULL) {
-        printf("Doc: %d | Destino: %s | Tipo: %s\n", r->documento, r->destino, r->tipo_pasaje);
-        preorden(r->izq);
-        preorden(r->der);
-    }
-}
-
-// Recorrido POSTORDEN
-void postorden(Pasajero *r) {
-    if (r != NULL) {
-        postorden(r->izq);
-        postorden(r->der);
-        printf("Doc: %d | Destino: %s | Tipo: %s\n", r->documento, r->destino, r->tipo_pasaje);
-    }
-}
-
-// Contar nodos
-int contar(Pasajero *r) {
-    if (r == NULL) return 0;
-    return 1 + contar(r->izq) + contar(r->der);
-}
-
-// Buscar el menor (para eliminación)
-Pasajero* minimo(Pasajero* r) {
-    while (r && r->izq != NULL) r = r->izq;
-    return r;
-}
-
-// Eliminar un pasajero
-Pasajero* eliminar(Pasajero *r, int documento) {
-    if (r == NULL) return r;
-
-    if (documento < r->documento) {
-        r->izq = eliminar(r->izq, documento);
-    } else if (documento > r->documento) {
-        r->der = eliminar(r->der, documento);
-    } else {
-        if (r->izq == NULL) {
-            Pasajero *temp = r->der;
-            free(r);
-            return temp;
-        } else if (r->der == NULL) {
-            Pasajero *temp = r->izq;
-            free(r);
-            return temp;
-        }
-        Pasajero *temp = minimo(r->der);
-        r->documento = temp->documento;
-        strcpy(r->destino, temp->destino);
-        strcpy(r->tipo_pasaje, temp->tipo_pasaje);
-        r->der = eliminar(r->der, temp->documento);
-    }
-    return r;
-}
+#include "pasajeros.h"
 
 // Menú
 int main() {
     Pasajero *raiz = NULL;
-    int op, documento;
+    int op, documento, capacidad, asignados;
     char destino[20], tipo[20];
+    Destino d;
 
     do {
         printf("\n--- MENU TIQUETES ---\n");
@@ -116,7 +16,11 @@ int main() {
         printf("4. Mostrar Postorden\n");
         printf("5. Contar pasajeros\n");
         printf("6. Eliminar pasajero\n");
-        printf("7. Salir\n");
+        printf("7. Buscar pasajero\n");
+        printf("8. Pasajeros por destino\n");
+        printf("9. Conteo por tipo de pasaje\n");
+        printf("10. Llenar bote\n");
+        printf("11. Salir\n");
         printf("Opcion: ");
         scanf("%d", &op);
 
@@ -124,11 +28,11 @@ int main() {
             case 1:
                 printf("Documento: ");
                 scanf("%d", &documento);
-                printf("Destino (Timbiqui/Juanchaco/Tumaco/Guapi): ");
-                scanf("%s", destino);
-                printf("Tipo (Ida / Ida y Regreso): ");
-                scanf("%s", tipo);
-                raiz = insertar(raiz, documento, destino, tipo);
+                printf("Destino (1 Timbiqui / 2 Juanchaco / 3 Tumaco / 4 Guapi): ");
+                scanf(" %19[^\n]", destino);
+                printf("Tipo (1 Ida / 2 Ida y Regreso): ");
+                scanf(" %19[^\n]", tipo);
+                raiz = insertar(raiz, documento, destinoDesdeTexto(destino), tipoDesdeTexto(tipo));
                 break;
 
             case 2:
@@ -152,9 +56,61 @@ int main() {
                 scanf("%d", &documento);
                 raiz = eliminar(raiz, documento);
                 break;
+
+            case 7: {
+                printf("Documento a buscar: ");
+                scanf("%d", &documento);
+                Pasajero *p = buscar(raiz, documento);
+                if (p != NULL) mostrarPasajero(p);
+                else printf("No existe un pasajero con ese documento.\n");
+                break;
+            }
+
+            case 8:
+                printf("Destino (1 Timbiqui / 2 Juanchaco / 3 Tumaco / 4 Guapi): ");
+                scanf(" %19[^\n]", destino);
+                d = destinoDesdeTexto(destino);
+                if (d == DESTINO_INVALIDO) {
+                    printf("Destino invalido.\n");
+                    break;
+                }
+                mostrarDestino(d);
+                printf("Total %s: %d (%d sin embarcar)\n", nombreDestino(d), pasajerosDestino(d), sinEmbarcar(d));
+                break;
+
+            case 9:
+                for (int t = 0; t < NUM_TIPOS_PASAJE; t++) {
+                    printf("%s: %d\n", nombreTipo((TipoPasaje)t), contarTipo((TipoPasaje)t));
+                    for (int i = 0; i < NUM_DESTINOS; i++) {
+                        printf("  %s: %d\n", nombreDestino((Destino)i), pasajerosTipo((Destino)i, (TipoPasaje)t));
+                    }
+                }
+                break;
+
+            case 10: {
+                printf("Destino (1 Timbiqui / 2 Juanchaco / 3 Tumaco / 4 Guapi): ");
+                scanf(" %19[^\n]", destino);
+                d = destinoDesdeTexto(destino);
+                if (d == DESTINO_INVALIDO) {
+                    printf("Destino invalido.\n");
+                    break;
+                }
+                printf("Capacidad del bote: ");
+                scanf("%d", &capacidad);
+                Pasajero *p = llenarBote(d, capacidad, &asignados);
+                if (p == NULL) {
+                    printf("No hay pasajeros sin embarcar para %s.\n", nombreDestino(d));
+                    break;
+                }
+                printf("Bote %d a %s con %d pasajeros:\n", p->bote, nombreDestino(d), asignados);
+                for (int i = 0; i < asignados; i++, p = p->sig_destino) mostrarPasajero(p);
+                printf("Quedan %d sin embarcar.\n", sinEmbarcar(d));
+                break;
+            }
         }
 
-    } while(op != 7);
+    } while(op != 11);
 
+    liberarArbol(raiz);
     return 0;
 }
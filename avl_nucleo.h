@@ -0,0 +1,218 @@
+/**
+ * avl_nucleo.h: Nucleo generico de arbol AVL (plantilla por macros, solo cabecera)
+ *
+ * Cada programa lo incluye una vez por tipo de nodo despues de definir los
+ * parametros; las funciones se generan static inline con el prefijo pedido,
+ * asi que la comparacion de claves y el acceso a los campos se resuelven al
+ * compilar (sin punteros a funcion) y el compilador puede integrarlos.
+ *
+ * Parametros obligatorios:
+ *   AVL_TIPO            Tipo del nodo
+ *   AVL_PREFIJO         Prefijo de las funciones (lote -> lote_rotar_derecha, ...)
+ *   AVL_CLAVE           Tipo de la clave de busqueda
+ *   AVL_COMPARAR(c, n)  Negativo, 0 o positivo segun la clave c frente al nodo n
+ *   AVL_IZQ, AVL_DER    Campos de los hijos
+ *   AVL_ALTURA          Campo de la altura (int; 1 en una hoja)
+ * Opcionales:
+ *   AVL_PADRE           Campo del padre: las rotaciones lo mantienen y se generan
+ *                       rebalancear_hacia_arriba, siguiente y anterior
+ *   AVL_ACTUALIZAR(n)   Recalcula los datos del subarbol (tamano, agregados) a
+ *                       partir de los hijos, despues de la altura
+ *   AVL_AL_ROTAR()      Se llama en cada rotacion (metricas)
+ *
+ * Sin guarda de inclusion a proposito: al final se borran los parametros para
+ * poder instanciar otro tipo en la misma unidad.
+ *
+ *   #define AVL_TIPO Pasajero
+ *   #define AVL_PREFIJO pasajero
+ *   #define AVL_CLAVE int
+ *   #define AVL_COMPARAR(c, n) (((c) > (n)->documento) - ((c) < (n)->documento))
+ *   #define AVL_IZQ izq
+ *   #define AVL_DER der
+ *   #define AVL_ALTURA altura
+ *   #include "avl_nucleo.h"
+*/
+#if !defined(AVL_TIPO) || !defined(AVL_PREFIJO) || !defined(AVL_CLAVE) || !defined(AVL_COMPARAR) || \
+    !defined(AVL_IZQ) || !defined(AVL_DER) || !defined(AVL_ALTURA)
+#error "avl_nucleo.h: faltan parametros de la plantilla (ver la cabecera del archivo)"
+#endif
+
+#ifndef AVL_ACTUALIZAR
+#define AVL_ACTUALIZAR(n) ((void)0)
+#endif
+#ifndef AVL_AL_ROTAR
+#define AVL_AL_ROTAR() ((void)0)
+#endif
+
+#define AVL_UNIR_(a, b) a##_##b
+#define AVL_UNIR(a, b) AVL_UNIR_(a, b)
+#define AVL_NOMBRE(f) AVL_UNIR(AVL_PREFIJO, f)
+
+
+static inline int AVL_NOMBRE(altura)(const AVL_TIPO *n) {
+    return n ? n->AVL_ALTURA : 0;
+}
+
+
+static inline void AVL_NOMBRE(actualizar)(AVL_TIPO *n) {
+    // Recalcular altura y datos del subarbol a partir de los hijos (ya actualizados)
+    int hi = AVL_NOMBRE(altura)(n->AVL_IZQ), hd = AVL_NOMBRE(altura)(n->AVL_DER);
+    n->AVL_ALTURA = 1 + (hi > hd ? hi : hd);
+    AVL_ACTUALIZAR(n);
+}
+
+
+static inline int AVL_NOMBRE(balance)(const AVL_TIPO *n) {
+    return n ? AVL_NOMBRE(altura)(n->AVL_IZQ) - AVL_NOMBRE(altura)(n->AVL_DER) : 0;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(rotar_derecha)(AVL_TIPO *y) {
+    AVL_TIPO *x = y->AVL_IZQ;   // x sube y y pasa a ser su hijo derecho
+    AVL_TIPO *t2 = x->AVL_DER;  // El subarbol derecho de x pasa a la izquierda de y
+    x->AVL_DER = y;
+    y->AVL_IZQ = t2;
+#ifdef AVL_PADRE
+    x->AVL_PADRE = y->AVL_PADRE;
+    y->AVL_PADRE = x;
+    if (t2) t2->AVL_PADRE = y;
+#endif
+    AVL_AL_ROTAR();
+
+    // Primero y, luego x porque x depende de y
+    AVL_NOMBRE(actualizar)(y);
+    AVL_NOMBRE(actualizar)(x);
+    return x;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(rotar_izquierda)(AVL_TIPO *x) {
+    AVL_TIPO *y = x->AVL_DER;   // y sube y x pasa a ser su hijo izquierdo
+    AVL_TIPO *t2 = y->AVL_IZQ;  // El subarbol izquierdo de y pasa a la derecha de x
+    y->AVL_IZQ = x;
+    x->AVL_DER = t2;
+#ifdef AVL_PADRE
+    y->AVL_PADRE = x->AVL_PADRE;
+    x->AVL_PADRE = y;
+    if (t2) t2->AVL_PADRE = x;
+#endif
+    AVL_AL_ROTAR();
+
+    AVL_NOMBRE(actualizar)(x);
+    AVL_NOMBRE(actualizar)(y);
+    return y;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(balancear)(AVL_TIPO *n) {
+    // Actualizar un nodo cuyos hijos ya estan balanceados y aplicar la rotacion
+    // que corresponda; devuelve la nueva raiz del subarbol
+    AVL_NOMBRE(actualizar)(n);
+    int balance = AVL_NOMBRE(balance)(n);
+    if (balance > 1) {
+        if (AVL_NOMBRE(balance)(n->AVL_IZQ) < 0) {
+            n->AVL_IZQ = AVL_NOMBRE(rotar_izquierda)(n->AVL_IZQ);  // Caso izquierda-derecha
+        }
+        return AVL_NOMBRE(rotar_derecha)(n);
+    }
+    if (balance < -1) {
+        if (AVL_NOMBRE(balance)(n->AVL_DER) > 0) {
+            n->AVL_DER = AVL_NOMBRE(rotar_derecha)(n->AVL_DER);    // Caso derecha-izquierda
+        }
+        return AVL_NOMBRE(rotar_izquierda)(n);
+    }
+    return n;
+}
+
+
+static inline void AVL_NOMBRE(rebalancear_camino)(AVL_TIPO **camino[], int n) {
+    // Rebalancear de abajo hacia arriba los enlaces guardados en una bajada
+    for (int i = n - 1; i >= 0; i--) {
+        if (*camino[i]) *camino[i] = AVL_NOMBRE(balancear)(*camino[i]);
+    }
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(buscar)(AVL_TIPO *n, AVL_CLAVE clave) {
+    // Nodo con esa clave exacta, o NULL
+    while (n) {
+        int c = AVL_COMPARAR(clave, n);
+        if (c == 0) break;
+        n = c < 0 ? n->AVL_IZQ : n->AVL_DER;
+    }
+    return n;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(primero_desde)(AVL_TIPO *n, AVL_CLAVE clave) {
+    // Cota inferior: el menor nodo con clave >= la pedida, o NULL
+    AVL_TIPO *mejor = NULL;
+    while (n) {
+        if (AVL_COMPARAR(clave, n) <= 0) {
+            mejor = n;
+            n = n->AVL_IZQ;
+        } else {
+            n = n->AVL_DER;
+        }
+    }
+    return mejor;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(minimo)(AVL_TIPO *n) {
+    while (n && n->AVL_IZQ) n = n->AVL_IZQ;
+    return n;
+}
+
+
+#ifdef AVL_PADRE
+static inline AVL_TIPO* AVL_NOMBRE(rebalancear_hacia_arriba)(AVL_TIPO *n, AVL_TIPO *raiz) {
+    // Subir por los padres rebalanceando cada ancestro; devuelve la raiz
+    while (n) {
+        AVL_TIPO *padre = n->AVL_PADRE;
+        int era_izquierdo = padre && padre->AVL_IZQ == n;
+        AVL_TIPO *sub = AVL_NOMBRE(balancear)(n);
+
+        // Reenganchar el subarbol (posiblemente rotado) en su padre
+        if (!padre) raiz = sub;
+        else if (era_izquierdo) padre->AVL_IZQ = sub;
+        else padre->AVL_DER = sub;
+        n = padre;
+    }
+    return raiz;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(siguiente)(AVL_TIPO *n) {
+    // Sucesor en orden por los punteros al padre (sin pila ni recursion)
+    if (n->AVL_DER) return AVL_NOMBRE(minimo)(n->AVL_DER);
+    while (n->AVL_PADRE && n->AVL_PADRE->AVL_DER == n) n = n->AVL_PADRE;
+    return n->AVL_PADRE;
+}
+
+
+static inline AVL_TIPO* AVL_NOMBRE(anterior)(AVL_TIPO *n) {
+    // Predecesor en orden, simetrico a siguiente
+    if (n->AVL_IZQ) {
+        n = n->AVL_IZQ;
+        while (n->AVL_DER) n = n->AVL_DER;
+        return n;
+    }
+    while (n->AVL_PADRE && n->AVL_PADRE->AVL_IZQ == n) n = n->AVL_PADRE;
+    return n->AVL_PADRE;
+}
+#endif
+
+#undef AVL_NOMBRE
+#undef AVL_UNIR
+#undef AVL_UNIR_
+#undef AVL_TIPO
+#undef AVL_PREFIJO
+#undef AVL_CLAVE
+#undef AVL_COMPARAR
+#undef AVL_IZQ
+#undef AVL_DER
+#undef AVL_ALTURA
+#undef AVL_PADRE
+#undef AVL_ACTUALIZAR
+#undef AVL_AL_ROTAR
@@ -0,0 +1,707 @@
+/**
+ * Microbenchmarks y generador de carga para los dos arboles
+ *
+ * Mide las operaciones del nucleo del inventario (insertAVL, searchNode,
+ * enqueue_order, cancel_order_in_node, despachar_tanda, compactar_pedidos,
+ * dequeue_order, deleteNode, guardar_arbol/cargar_arbol)
+ * y del arbol de pasajeros (insertar, buscar, llenarBote, eliminar) con cargas
+ * sinteticas:
+ *   secuencial   claves en orden creciente (peor caso para un ABB sin balanceo)
+ *   aleatoria    claves en orden aleatorio
+ *   sesgada      el 90% de las consultas y pedidos cae en el 10% de lotes mas
+ *                proximos a vencer (patron FEFO); las bajas van de la mas antigua
+ *   profunda     pocos lotes con colas de pedidos muy largas
+ * Por operacion informa ops/s, percentiles de latencia (p50, p90, p99, max) y al
+ * final el pico de memoria residente (RSS) del proceso.
+ *
+ * Con -DVERIFICAR agrega la carga "invariantes": una secuencia aleatoria de
+ * insertAVL, deleteNode, enqueue_order y cancel_order_in_node (con guardado y
+ * carga de ida y vuelta) que compara los totales con un modelo, llama a
+ * verificar_inventario y cuenta las reservas de los pools por operacion. Una
+ * falla (invariante roto, fuga o reserva de mas) hace terminar con codigo 1.
+ *
+ * Con varios almacenes (almacenes.c) compara ademas guardar y cargar un
+ * conjunto de arboles por rango de fechas en paralelo contra hacerlo en serie.
+ *
+ * Compilar con las mismas banderas -D que el programa que se quiere medir:
+ *   gcc -O2 -pthread -o benchmark benchmark.c inventario.c pasajeros.c almacenes.c
+ * (con VERSIONES o INVENTARIO_CONCURRENTE, sin almacenes.c)
+ *   gcc -O2 -pthread -DVERIFICAR -o benchmark benchmark.c inventario.c pasajeros.c almacenes.c
+ * Uso: ./benchmark [n] [semilla]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "inventario.h"
+#include "pasajeros.h"
+#if !defined(VERSIONES) && !defined(INVENTARIO_CONCURRENTE)
+#define BENCH_CON_ALMACENES
+#include "almacenes.h"
+#endif
+
+#define BENCH_N 100000                    // Operaciones por fase (por defecto)
+#define BENCH_FECHA_BASE 20000101         // Primera clave (el arbol solo compara enteros)
+#define BENCH_DESTINOS 16                 // Destinos distintos en los pedidos
+#define BENCH_LOTES_PROFUNDOS 8           // Lotes de la carga de colas profundas
+#define BENCH_CANCELACIONES_PROFUNDAS 2000 // Cancelaciones en colas profundas (recorrido lineal)
+#define BENCH_REPETICIONES_ARCHIVO 5      // Guardados y cargas medidos por carga
+#define BENCH_ARCHIVO "benchmark.dat"     // Instantanea temporal
+#define BENCH_ALMACENES 8                 // Almacenes (rangos de fechas) del conjunto
+#define BENCH_TANDA 1000                  // Pedidos por tanda en despachar_tanda
+#define BENCH_CAPACIDAD_BOTE 40           // Pasajeros por bote en llenarBote
+#define BENCH_FECHAS_INVARIANTES 256      // Fechas distintas de la carga aleatoria (muchas repetidas)
+#define BENCH_VERIFICAR_CADA 1000         // Operaciones entre verificaciones completas
+#define BENCH_GUARDAR_CADA 20000          // Operaciones entre guardado y carga de ida y vuelta
+
+/**
+ * Estructura Medicion: Latencias de una fase (una operacion repetida n veces)
+ */
+typedef struct Medicion {
+    uint64_t *latencias;              // Nanosegundos de cada operacion
+    size_t n;                         // Operaciones anotadas
+    size_t capacidad;                 // Capacidad del arreglo de latencias
+} Medicion;
+
+/**
+ * Estructura PedidoBench: Pedido encolado, para poder cancelarlo despues
+ */
+typedef struct PedidoBench {
+    int fecha;                        // Lote en cuya cola esta
+    int destino;                      // Indice en la tabla de destinos
+    int cantidad;                     // Cantidad solicitada
+} PedidoBench;
+
+typedef enum {
+    CARGA_SECUENCIAL,
+    CARGA_ALEATORIA,
+    CARGA_SESGADA
+} TipoCarga;
+
+const char *nombres_carga[] = { "secuencial", "aleatoria", "sesgada" };
+
+const char *destinos_bench[BENCH_DESTINOS] = {
+    "Buenaventura", "Cali", "Tumaco", "Guapi", "Juanchaco", "Timbiqui",
+    "Popayan", "Pasto", "Bogota", "Medellin", "Pereira", "Manizales",
+    "Ibague", "Neiva", "Quibdo", "Armenia"
+};
+
+
+uint64_t ahora_ns(void) {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+uint64_t aleatorio(uint64_t *s) {
+    // xorshift64*: suficiente para generar cargas reproducibles con una semilla
+    *s ^= *s >> 12;
+    *s ^= *s << 25;
+    *s ^= *s >> 27;
+    return *s * 2685821657736338717ull;
+}
+
+
+size_t aleatorio_menor(uint64_t *s, size_t n) {
+    return (size_t)(aleatorio(s) % n);
+}
+
+
+long rss_maximo_kb(void) {
+    // Pico de memoria residente del proceso (-1 si no se puede consultar)
+#ifdef _WIN32
+    return -1;
+#else
+    struct rusage uso;
+    if (getrusage(RUSAGE_SELF, &uso) != 0) return -1;
+#ifdef __APPLE__
+    return uso.ru_maxrss / 1024;  // macOS lo informa en bytes
+#else
+    return uso.ru_maxrss;
+#endif
+#endif
+}
+
+
+bool medicion_iniciar(Medicion *m, size_t capacidad) {
+    m->latencias = (uint64_t*)malloc((capacidad ? capacidad : 1) * sizeof(uint64_t));
+    m->n = 0;
+    m->capacidad = m->latencias ? capacidad : 0;
+    return m->latencias != NULL;
+}
+
+
+void medicion_anotar(Medicion *m, uint64_t ns) {
+    if (m->n < m->capacidad) m->latencias[m->n++] = ns;
+}
+
+// Medir una expresion y anotar su latencia
+#define MEDIR(m, expr) do { \
+        uint64_t t0_ = ahora_ns(); \
+        expr; \
+        medicion_anotar((m), ahora_ns() - t0_); \
+    } while (0)
+
+
+int comparar_latencias(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+uint64_t percentil(const Medicion *m, int p) {
+    // Percentil por rango mas cercano sobre las latencias ya ordenadas
+    if (m->n == 0) return 0;
+    size_t i = (size_t)(((double)p / 100.0) * (double)m->n);
+    if (i >= m->n) i = m->n - 1;
+    return m->latencias[i];
+}
+
+
+void medicion_reportar(const char *carga, const char *operacion, Medicion *m) {
+    // ops/s sobre el tiempo medido (sin el costo del bucle que genera la carga)
+    uint64_t total = 0;
+    for (size_t i = 0; i < m->n; i++) total += m->latencias[i];
+    qsort(m->latencias, m->n, sizeof(uint64_t), comparar_latencias);
+    double ops = total ? (double)m->n * 1e9 / (double)total : 0.0;
+    printf("%-11s %-22s %9zu %13.0f %9llu %9llu %9llu %11llu\n",
+           carga, operacion, m->n, ops,
+           (unsigned long long)percentil(m, 50), (unsigned long long)percentil(m, 90),
+           (unsigned long long)percentil(m, 99),
+           (unsigned long long)(m->n ? m->latencias[m->n - 1] : 0));
+    m->n = 0;
+}
+
+
+void barajar(int *v, size_t n, uint64_t *semilla) {
+    for (size_t i = n; i > 1; i--) {
+        size_t j = aleatorio_menor(semilla, i);
+        int t = v[i - 1];
+        v[i - 1] = v[j];
+        v[j] = t;
+    }
+}
+
+
+void generar_claves(int *claves, size_t n, bool aleatorias, uint64_t *semilla) {
+    for (size_t i = 0; i < n; i++) claves[i] = BENCH_FECHA_BASE + (int)i;
+    if (aleatorias) barajar(claves, n, semilla);
+}
+
+
+int clave_consulta(TipoCarga carga, size_t i, size_t n, uint64_t *semilla) {
+    // Clave de la i-esima consulta o pedido segun la carga
+    switch (carga) {
+        case CARGA_SECUENCIAL:
+            return BENCH_FECHA_BASE + (int)(i % n);
+        case CARGA_SESGADA: {
+            size_t calientes = n / 10 ? n / 10 : 1;
+            if (aleatorio_menor(semilla, 10) < 9) {
+                return BENCH_FECHA_BASE + (int)aleatorio_menor(semilla, calientes);
+            }
+            return BENCH_FECHA_BASE + (int)aleatorio_menor(semilla, n);
+        }
+        default:
+            return BENCH_FECHA_BASE + (int)aleatorio_menor(semilla, n);
+    }
+}
+
+
+Node* medir_archivo(const char *carga, Node *root, Medicion *m) {
+    // Guardar y recargar la instantanea; devuelve el arbol recargado
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        bool ok;
+        MEDIR(m, ok = guardar_arbol(root, BENCH_ARCHIVO));
+        if (!ok) {
+            printf("✗ No se pudo guardar '%s'.\n", BENCH_ARCHIVO);
+            return root;
+        }
+    }
+    medicion_reportar(carga, "guardar_arbol", m);
+
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        free_tree(root);
+        MEDIR(m, root = cargar_arbol(BENCH_ARCHIVO));
+        if (!root) {
+            printf("✗ No se pudo cargar '%s'.\n", BENCH_ARCHIVO);
+            return NULL;
+        }
+    }
+    medicion_reportar(carga, "cargar_arbol", m);
+#ifdef CARGA_PARALELA
+    // La misma carga armada en un solo hilo, para comparar
+    configurar_hilos_carga(1);
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        free_tree(root);
+        MEDIR(m, root = cargar_arbol(BENCH_ARCHIVO));
+        if (!root) {
+            printf("✗ No se pudo cargar '%s'.\n", BENCH_ARCHIVO);
+            configurar_hilos_carga(0);
+            return NULL;
+        }
+    }
+    configurar_hilos_carga(0);
+    medicion_reportar(carga, "cargar_arbol (1 hilo)", m);
+#endif
+    return root;
+}
+
+
+void bench_tandas(const char *nombre, TipoCarga carga, Node *root, size_t n, uint64_t *semilla, Medicion *m) {
+    // Pedidos completos (busqueda del lote, stock, encolado y descuento), uno
+    // por uno como la opcion 3 y luego en tandas; de la tanda se anota el
+    // tiempo repartido entre sus pedidos, para comparar por pedido
+    PedidoTanda *tanda = (PedidoTanda*)malloc(BENCH_TANDA * sizeof(PedidoTanda));
+    if (!tanda) {
+        printf("✗ Sin memoria para las tandas.\n");
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int fecha = clave_consulta(carga, i, n, semilla);
+        const char *destino = destinos_bench[aleatorio_menor(semilla, BENCH_DESTINOS)];
+        MEDIR(m, {
+            Node *lote = searchNode(root, fecha);
+            if (lote && lote->stock_total >= 1) {
+                if (enqueue_order(lote, destino, 1)) ajustar_stock(lote, -1);
+            }
+        });
+    }
+    medicion_reportar(nombre, "pedido (uno a uno)", m);
+
+    for (size_t i = 0; i < n; i += BENCH_TANDA) {
+        size_t k = n - i < BENCH_TANDA ? n - i : BENCH_TANDA;
+        for (size_t j = 0; j < k; j++) {
+            tanda[j].fecha_vencimiento = clave_consulta(carga, i + j, n, semilla);
+            strcpy(tanda[j].destino, destinos_bench[aleatorio_menor(semilla, BENCH_DESTINOS)]);
+            tanda[j].cantidad = 1;
+        }
+        uint64_t t0 = ahora_ns();
+        despachar_tanda(root, tanda, k);
+        uint64_t por_pedido = (ahora_ns() - t0) / k;
+        for (size_t j = 0; j < k; j++) medicion_anotar(m, por_pedido);
+    }
+    medicion_reportar(nombre, "despachar_tanda", m);
+    free(tanda);
+}
+
+
+void bench_inventario(TipoCarga carga, size_t n, uint64_t *semilla, Medicion *m) {
+    const char *nombre = nombres_carga[carga];
+    int *claves = (int*)malloc(n * sizeof(int));
+    PedidoBench *pedidos = (PedidoBench*)malloc(n * sizeof(PedidoBench));
+    if (!claves || !pedidos) {
+        printf("✗ Sin memoria para la carga %s.\n", nombre);
+        free(claves);
+        free(pedidos);
+        return;
+    }
+    Node *root = NULL;
+
+    // Recepcion de lotes
+    generar_claves(claves, n, carga != CARGA_SECUENCIAL, semilla);
+    for (size_t i = 0; i < n; i++) {
+        MEDIR(m, root = insertAVL(root, claves[i], "Producto", 1000));
+    }
+    medicion_reportar(nombre, "insertAVL", m);
+
+    // Consultas por fecha
+    for (size_t i = 0; i < n; i++) {
+        int fecha = clave_consulta(carga, i, n, semilla);
+        Node *lote;
+        MEDIR(m, lote = searchNode(root, fecha));
+        if (!lote) printf("✗ Lote %d no encontrado.\n", fecha);
+    }
+    medicion_reportar(nombre, "searchNode", m);
+
+    // Pedidos (la busqueda del lote queda fuera de la medicion)
+    size_t num_pedidos = 0;
+    for (size_t i = 0; i < n; i++) {
+        PedidoBench p = { clave_consulta(carga, i, n, semilla),
+                          (int)aleatorio_menor(semilla, BENCH_DESTINOS),
+                          1 + (int)aleatorio_menor(semilla, 100) };
+        Node *lote = searchNode(root, p.fecha);
+        uint32_t id;
+        MEDIR(m, id = enqueue_order(lote, destinos_bench[p.destino], p.cantidad));
+        if (id) pedidos[num_pedidos++] = p;
+    }
+    medicion_reportar(nombre, "enqueue_order", m);
+
+    root = medir_archivo(nombre, root, m);
+
+    // Cancelar la mitad de los pedidos, en orden aleatorio
+    for (size_t i = num_pedidos; i > 1; i--) {
+        size_t j = aleatorio_menor(semilla, i);
+        PedidoBench t = pedidos[i - 1];
+        pedidos[i - 1] = pedidos[j];
+        pedidos[j] = t;
+    }
+    for (size_t i = 0; i < num_pedidos / 2; i++) {
+        Node *lote = searchNode(root, pedidos[i].fecha);
+        MEDIR(m, cancel_order_in_node(lote, destinos_bench[pedidos[i].destino], pedidos[i].cantidad));
+    }
+    medicion_reportar(nombre, "cancel_order_in_node", m);
+
+    // Los mismos pedidos con descenso y control de stock: uno por uno y por tandas
+    bench_tandas(nombre, carga, root, n, semilla, m);
+
+    // Bajas: en la carga sesgada se retiran primero los lotes mas antiguos
+    generar_claves(claves, n, carga == CARGA_ALEATORIA, semilla);
+    for (size_t i = 0; i < n; i++) {
+        MEDIR(m, root = deleteNode(root, claves[i], 0));
+    }
+    medicion_reportar(nombre, "deleteNode", m);
+
+    free_tree(root);
+    free(claves);
+    free(pedidos);
+}
+
+
+#ifdef BENCH_CON_ALMACENES
+void bench_almacenes(size_t n, uint64_t *semilla, Medicion *m) {
+    // Los mismos n lotes (y un pedido por lote) repartidos por rango de fechas
+    // en BENCH_ALMACENES arboles: guardado y carga en serie contra en paralelo
+    const char *nombre = "almacenes";
+    Almacenes a;
+    almacenes_iniciar(&a);
+    size_t por_almacen = (n + BENCH_ALMACENES - 1) / BENCH_ALMACENES;
+    for (int i = 0; i < BENCH_ALMACENES; i++) {
+        char nombre_almacen[MAX_NAME], archivo[MAX_RUTA];
+        snprintf(nombre_almacen, sizeof(nombre_almacen), "rango%d", i);
+        snprintf(archivo, sizeof(archivo), "benchmark.%d.dat", i);
+        almacenes_agregar(&a, nombre_almacen, archivo,
+                          BENCH_FECHA_BASE + (int)(i * por_almacen));
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        int fecha = BENCH_FECHA_BASE + (int)aleatorio_menor(semilla, n);
+        int k = almacenes_ruta_fecha(&a, fecha);
+        almacenes_insertar(&a, k, fecha, "Producto", 1000);
+        almacenes_encolar(&a, k, fecha, destinos_bench[aleatorio_menor(semilla, BENCH_DESTINOS)],
+                          1 + (int)aleatorio_menor(semilla, 100));
+    }
+
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        bool ok = true;
+        MEDIR(m, for (int i = 0; i < a.cantidad; i++) {
+                     ok = guardar_arbol(a.almacenes[i].raiz, a.almacenes[i].archivo) && ok;
+                 });
+        if (!ok) printf("✗ No se pudieron guardar los almacenes.\n");
+    }
+    medicion_reportar(nombre, "guardar (serie)", m);
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        bool ok;
+        MEDIR(m, ok = almacenes_guardar(&a));
+        if (!ok) printf("✗ No se pudieron guardar los almacenes.\n");
+    }
+    medicion_reportar(nombre, "almacenes_guardar", m);
+
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        MEDIR(m, for (int i = 0; i < a.cantidad; i++) {
+                     almacenes_activar(&a, i);
+                     free_tree(a.almacenes[i].raiz);
+                     a.almacenes[i].raiz = cargar_arbol(a.almacenes[i].archivo);
+                 });
+    }
+    medicion_reportar(nombre, "cargar (serie)", m);
+    for (int r = 0; r < BENCH_REPETICIONES_ARCHIVO; r++) {
+        bool ok;
+        MEDIR(m, ok = almacenes_cargar(&a));
+        if (!ok) printf("✗ No se pudieron cargar los almacenes.\n");
+    }
+    medicion_reportar(nombre, "almacenes_cargar", m);
+
+    Totales t = almacenes_totales(&a);
+    if ((size_t)t.lotes != n) printf("✗ Se recuperaron %d de %zu lotes.\n", t.lotes, n);
+    for (int i = 0; i < a.cantidad; i++) remove(a.almacenes[i].archivo);
+    almacenes_liberar(&a);
+}
+#endif
+
+
+void bench_colas_profundas(size_t n, uint64_t *semilla, Medicion *m) {
+    // Pocos lotes con colas muy largas: encolar debe seguir en O(1) y cancelar
+    // por destino y cantidad recorre la cola hasta el pedido
+    const char *nombre = "profunda";
+    Node *root = NULL;
+    for (int i = 0; i < BENCH_LOTES_PROFUNDOS; i++) {
+        root = insertAVL(root, BENCH_FECHA_BASE + i, "Producto", 1000);
+    }
+
+    // La cantidad identifica la posicion del pedido dentro de su cola
+    for (size_t i = 0; i < n; i++) {
+        Node *lote = searchNode(root, BENCH_FECHA_BASE + (int)(i % BENCH_LOTES_PROFUNDOS));
+        int cantidad = 1 + (int)(i / BENCH_LOTES_PROFUNDOS);
+        MEDIR(m, enqueue_order(lote, destinos_bench[i % BENCH_DESTINOS], cantidad));
+    }
+    medicion_reportar(nombre, "enqueue_order", m);
+
+    root = medir_archivo(nombre, root, m);
+
+    size_t cancelaciones = n < BENCH_CANCELACIONES_PROFUNDAS ? n : BENCH_CANCELACIONES_PROFUNDAS;
+    for (size_t k = 0; k < cancelaciones; k++) {
+        size_t i = aleatorio_menor(semilla, n);
+        Node *lote = searchNode(root, BENCH_FECHA_BASE + (int)(i % BENCH_LOTES_PROFUNDOS));
+        int cantidad = 1 + (int)(i / BENCH_LOTES_PROFUNDOS);
+        MEDIR(m, cancel_order_in_node(lote, destinos_bench[i % BENCH_DESTINOS], cantidad));
+    }
+    medicion_reportar(nombre, "cancel_order_in_node", m);
+
+    // Sin historial abierto despachar solo liquida los pedidos de la cabeza
+    for (int i = 0; i < BENCH_LOTES_PROFUNDOS; i++) {
+        Node *lote = searchNode(root, BENCH_FECHA_BASE + i);
+        MEDIR(m, compactar_pedidos(lote));
+    }
+    medicion_reportar(nombre, "compactar_pedidos", m);
+    for (size_t i = 0; i < n / 2; i++) {
+        Node *lote = searchNode(root, BENCH_FECHA_BASE + (int)(i % BENCH_LOTES_PROFUNDOS));
+        MEDIR(m, dequeue_order(lote));
+    }
+    medicion_reportar(nombre, "dequeue_order", m);
+
+    // Bajas de lotes con la cola completa (libera todos sus pedidos)
+    for (int i = 0; i < BENCH_LOTES_PROFUNDOS; i++) {
+        MEDIR(m, root = deleteNode(root, BENCH_FECHA_BASE + i, 0));
+    }
+    medicion_reportar(nombre, "deleteNode", m);
+    free_tree(root);
+}
+
+
+#ifdef VERIFICAR
+bool totales_coinciden(Node *root, Totales esperado, const char *momento) {
+    // Totales del arbol (agregados de la raiz) frente a los del modelo
+    Totales t = totales_rango(root, 0, INT_MAX);
+    if (t.lotes == esperado.lotes && t.stock == esperado.stock &&
+        t.pedidos == esperado.pedidos && t.pendiente == esperado.pendiente) {
+        return true;
+    }
+    printf("✗ Totales distintos del modelo %s: lotes %d/%d, stock %lld/%lld, pedidos %ld/%ld, pendiente %lld/%lld\n",
+           momento, t.lotes, esperado.lotes, t.stock, esperado.stock,
+           t.pedidos, esperado.pedidos, t.pendiente, esperado.pendiente);
+    return false;
+}
+
+
+bool reservas_esperadas(ContadoresMemoria antes, int lotes, int pedidos, const char *operacion) {
+    // Cada operacion toma de los pools exactamente los elementos que agrega
+    ContadoresMemoria despues = contadores_memoria();
+    if (despues.reservas_lotes - antes.reservas_lotes == (unsigned long long)lotes &&
+        despues.reservas_pedidos - antes.reservas_pedidos == (unsigned long long)pedidos) {
+        return true;
+    }
+    printf("✗ %s reservo %llu lotes y %llu pedidos (se esperaban %d y %d).\n", operacion,
+           despues.reservas_lotes - antes.reservas_lotes,
+           despues.reservas_pedidos - antes.reservas_pedidos, lotes, pedidos);
+    return false;
+}
+
+
+Node* lote_al_azar(Node *root, uint64_t *semilla) {
+    // Primer lote desde una fecha al azar (o el primero, si no hay despues)
+    int fecha = BENCH_FECHA_BASE + (int)aleatorio_menor(semilla, BENCH_FECHAS_INVARIANTES);
+    Node *lote = iterador_rango(root, fecha, INT_MAX).actual;
+    return lote ? lote : buscar_lote_minimo(root);
+}
+
+
+bool bench_invariantes(size_t n, uint64_t *semilla, Medicion *m) {
+    // Secuencia aleatoria de altas, bajas, pedidos y cancelaciones sobre pocas
+    // fechas (muchos lotes por fecha y bajas con dos hijos) contra un modelo
+    // de los totales, verificando el arbol completo cada tanto
+    const char *nombre = "invariantes";
+    const char *productos_bench[] = { "Arroz", "Leche", "Atun", "Panela" };
+    Node *root = NULL;
+    Totales esperado = { 0, 0, 0, 0 };
+    int fallas = 0;
+
+    for (size_t i = 0; i < n && fallas == 0; i++) {
+        size_t op = aleatorio_menor(semilla, 100);
+        ContadoresMemoria antes = contadores_memoria();
+        if (op < 25 || !root) {
+            int fecha = BENCH_FECHA_BASE + (int)aleatorio_menor(semilla, BENCH_FECHAS_INVARIANTES);
+            int stock = 1 + (int)aleatorio_menor(semilla, 50);
+            MEDIR(m, root = insertAVL(root, fecha, productos_bench[aleatorio_menor(semilla, 4)], stock));
+            esperado.lotes++;
+            esperado.stock += stock;
+            if (!reservas_esperadas(antes, 1, 0, "insertAVL")) fallas++;
+        } else if (op < 45) {
+            // La baja descarta el stock y los pedidos pendientes del lote
+            Node *lote = lote_al_azar(root, semilla);
+            esperado.lotes--;
+            esperado.stock -= lote->stock_total;
+            esperado.pedidos -= lote->num_pedidos;
+            esperado.pendiente -= lote->cantidad_pendiente;
+            MEDIR(m, root = deleteNode(root, lote->fecha_vencimiento, lote->secuencia));
+            if (!reservas_esperadas(antes, 0, 0, "deleteNode")) fallas++;
+        } else if (op < 85) {
+            // Como el menu: el pedido se encola si el lote alcanza y descuenta el stock
+            Node *lote = lote_al_azar(root, semilla);
+            int cantidad = 1 + (int)aleatorio_menor(semilla, 4);
+            uint32_t id = 0;
+            if (lote->stock_total >= cantidad) {
+                MEDIR(m, id = enqueue_order(lote, destinos_bench[aleatorio_menor(semilla, 4)], cantidad);
+                         if (id) ajustar_stock(lote, -cantidad));
+            }
+            if (id) {
+                esperado.stock -= cantidad;
+                esperado.pedidos++;
+                esperado.pendiente += cantidad;
+            }
+            if (!reservas_esperadas(antes, 0, id ? 1 : 0, "enqueue_order")) fallas++;
+        } else {
+            // La cancelacion devuelve la cantidad al stock del lote
+            Node *lote = lote_al_azar(root, semilla);
+            int cantidad = 1 + (int)aleatorio_menor(semilla, 4);
+            int cancelado;
+            MEDIR(m, cancelado = cancel_order_in_node(lote, destinos_bench[aleatorio_menor(semilla, 4)], cantidad));
+            if (cancelado) {
+                esperado.stock += cantidad;
+                esperado.pedidos--;
+                esperado.pendiente -= cantidad;
+            }
+            if (!reservas_esperadas(antes, 0, 0, "cancel_order_in_node")) fallas++;
+        }
+
+        if ((i + 1) % BENCH_VERIFICAR_CADA == 0) {
+            if (!totales_coinciden(root, esperado, "tras las operaciones")) fallas++;
+            if (!verificar_inventario(root, stdout)) fallas++;
+        }
+        if ((i + 1) % BENCH_GUARDAR_CADA == 0 && fallas == 0) {
+            // Ida y vuelta por la instantanea: el stock guardado ya tiene
+            // descontados los pedidos y la carga no debe volver a descontarlos
+            if (!guardar_arbol(root, BENCH_ARCHIVO)) {
+                printf("✗ No se pudo guardar la instantanea.\n");
+                fallas++;
+                break;
+            }
+            free_tree(root);
+            root = cargar_arbol(BENCH_ARCHIVO);
+            if (!totales_coinciden(root, esperado, "tras guardar y cargar")) fallas++;
+            if (!verificar_inventario(root, stdout)) fallas++;
+        }
+    }
+    medicion_reportar(nombre, "operaciones mixtas", m);
+
+    // Bajas una a una: al final los pools no deben retener ningun elemento
+    while (root && fallas == 0) {
+        Node *lote = buscar_lote_minimo(root);
+        MEDIR(m, root = deleteNode(root, lote->fecha_vencimiento, lote->secuencia));
+    }
+    medicion_reportar(nombre, "deleteNode (vaciar)", m);
+    ContadoresMemoria c = contadores_memoria();
+    if (fallas == 0 && (c.lotes_vivos != 0 || c.pedidos_vivos != 0)) {
+        printf("✗ Fuga: quedaron %ld lotes y %ld pedidos en los pools.\n", c.lotes_vivos, c.pedidos_vivos);
+        fallas++;
+    }
+    free_tree(root);
+    if (fallas == 0) printf("✓ Invariantes verificados en %zu operaciones.\n", n);
+    return fallas == 0;
+}
+#endif
+
+
+void bench_pasajeros(TipoCarga carga, size_t n, uint64_t *semilla, Medicion *m) {
+    const char *nombre = nombres_carga[carga];
+    int *claves = (int*)malloc(n * sizeof(int));
+    if (!claves) {
+        printf("✗ Sin memoria para la carga %s.\n", nombre);
+        return;
+    }
+    Pasajero *raiz = NULL;
+
+    generar_claves(claves, n, carga != CARGA_SECUENCIAL, semilla);
+    for (size_t i = 0; i < n; i++) {
+        MEDIR(m, raiz = insertar(raiz, claves[i], (Destino)(i % NUM_DESTINOS), PASAJE_IDA));
+    }
+    medicion_reportar(nombre, "insertar", m);
+
+    for (size_t i = 0; i < n; i++) {
+        int documento = clave_consulta(carga, i, n, semilla);
+        Pasajero *p;
+        MEDIR(m, p = buscar(raiz, documento));
+        if (!p) printf("✗ Pasajero %d no encontrado.\n", documento);
+    }
+    medicion_reportar(nombre, "buscar", m);
+
+    // Embarcar todo el registro en botes de BENCH_CAPACIDAD_BOTE por destino
+    for (int d = 0; d < NUM_DESTINOS; d++) {
+        int asignados = 1;
+        while (asignados > 0) {
+            MEDIR(m, llenarBote((Destino)d, BENCH_CAPACIDAD_BOTE, &asignados));
+        }
+        if (sinEmbarcar((Destino)d) != 0) printf("✗ Quedaron pasajeros sin bote en %s.\n", nombreDestino((Destino)d));
+    }
+    medicion_reportar(nombre, "llenarBote", m);
+
+    generar_claves(claves, n, carga == CARGA_ALEATORIA, semilla);
+    for (size_t i = 0; i < n; i++) {
+        MEDIR(m, raiz = eliminar(raiz, claves[i]));
+    }
+    medicion_reportar(nombre, "eliminar", m);
+
+    liberarArbol(raiz);
+    free(claves);
+}
+
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : BENCH_N;
+    uint64_t semilla = argc > 2 ? strtoull(argv[2], NULL, 10) : 88172645463325252ull;
+    if (n == 0) n = BENCH_N;
+    if (semilla == 0) semilla = 1;  // xorshift no sale del cero
+
+    Medicion m;
+    size_t capacidad = n > BENCH_REPETICIONES_ARCHIVO ? n : BENCH_REPETICIONES_ARCHIVO;
+    if (!medicion_iniciar(&m, capacidad)) {
+        printf("✗ Sin memoria para las latencias.\n");
+        return 1;
+    }
+
+    printf("n = %zu, semilla = %llu (latencias en ns)\n", n, (unsigned long long)semilla);
+    printf("%-11s %-22s %9s %13s %9s %9s %9s %11s\n",
+           "carga", "operacion", "n", "ops/s", "p50", "p90", "p99", "max");
+
+    printf("--- Inventario (distribucion) ---\n");
+    for (int c = CARGA_SECUENCIAL; c <= CARGA_SESGADA; c++) {
+        bench_inventario((TipoCarga)c, n, &semilla, &m);
+    }
+    bench_colas_profundas(n, &semilla, &m);
+#ifdef VERIFICAR
+    bool invariantes_ok = bench_invariantes(n, &semilla, &m);
+#endif
+#ifdef BENCH_CON_ALMACENES
+    bench_almacenes(n, &semilla, &m);
+#endif
+
+    printf("--- Pasajeros (arbol) ---\n");
+    for (int c = CARGA_SECUENCIAL; c <= CARGA_SESGADA; c++) {
+        bench_pasajeros((TipoCarga)c, n, &semilla, &m);
+    }
+
+    long rss = rss_maximo_kb();
+    if (rss >= 0) printf("RSS maximo: %ld KB\n", rss);
+    else printf("RSS maximo: no disponible\n");
+#ifdef ESTADISTICAS
+    // Contadores internos acumulados por todas las cargas
+    estadisticas_volcar(NULL, "-");
+#endif
+
+    remove(BENCH_ARCHIVO);
+    inventario_destruir();
+    free(m.latencias);
+#ifdef VERIFICAR
+    if (!invariantes_ok) return 1;
+#endif
+    return 0;
+}
@@ -1,510 +1,9 @@
-
-
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdbool.h>
-#include <time.h>
-
-/* Constantes de configuracion */
-#define MAX_NAME 64      // Longitud maxima del nombre del producto
-#define MAX_DEST 64      // Longitud maxima del nombre del destino
-#define MIN_YEAR 2000    // Anio minimo valido para fechas
-#define MAX_YEAR 2100    // Anio maximo valido para fechas
-#define ARCHIVO_DATOS "inventario.dat"  // Archivo para persistencia
-
-/**
- * Estructura Order: Representa un pedido de despacho en la cola FIFO
-*/
-typedef struct Order {
-    char nombre_destino[MAX_DEST];   // Nombre del destino segun especificación
-    int cantidad_solicitada;          // Cantidad solicitada segun especificación
-    struct Order *siguiente;          // Puntero al siguiente pedido segun especificación
-} Order;
-
-/**
- * Estructura Node: Representa un nodo del arbol AVL (un lote de productos)
- */
-typedef struct Node {
-    int fecha_vencimiento;            // Fecha de vencimiento AAAAMMDD (clave del arbol)
-    char producto[MAX_NAME];          // Nombre del producto
-    int stock_total;                  // Stock total disponible segun especificacion
-    Order *cabeza_pedidos;            // Cabeza de la cola FIFO (primer pedido)
-    Order *tail;                      // Cola de la cola FIFO (ultimo pedido, para eficiencia)
-    struct Node *left, *right;       // Hijos izquierdo y derecho del arbol AVL
-    int height;                       // Altura del nodo para balanceo AVL
-} Node;
-
-
-int max(int a, int b) { 
-    return (a > b) ? a : b; 
-}
-
-
-int height(Node *n) { 
-    return n ? n->height : 0; 
-}
-
-
-int convertir_fecha_a_int(int dia, int mes, int anio) {
-    // Validar rango del anio
-    if (anio < MIN_YEAR || anio > MAX_YEAR) return -1;
-    
-    // Validar rango del mes
-    if (mes < 1 || mes > 12) return -1;
-    
-    // Validar rango basico del dia
-    if (dia < 1 || dia > 31) return -1;
-    
-    // Validar dias por mes (considera febrero con 29 dias para anios bisiestos)
-    int dias_mes[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    if (dia > dias_mes[mes - 1]) return -1;
-    
-    // Convertir a formato AAAAMMDD
-    return anio * 10000 + mes * 100 + dia;
-}
-
-
-char* formatear_fecha(int fecha) {
-    static char buffer[12];
-    int anio = fecha / 10000;
-    int mes = (fecha / 100) % 100;
-    int dia = fecha % 100;
-    sprintf(buffer, "%02d/%02d/%04d", dia, mes, anio);
-    return buffer;
-}
-
-
-bool validar_fecha(int fecha) {
-    // Extraer anio, mes y dia del formato AAAAMMDD
-    int anio = fecha / 10000;
-    int mes = (fecha / 100) % 100;
-    int dia = fecha % 100;
-    
-    // Validar rango del anio
-    if (anio < MIN_YEAR || anio > MAX_YEAR) return false;
-    
-    // Validar rango del mes
-    if (mes < 1 || mes > 12) return false;
-    
-    // Validar rango basico del dia
-    if (dia < 1 || dia > 31) return false;
-    
-    // Validacion de dias por mes (considera febrero con 29 dias para anios bisiestos)
-    int dias_mes[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-    if (dia > dias_mes[mes - 1]) return false;
-    
-    return true;
-}
-
-
-Node* newNode(int fecha, const char *producto, int stock) {
-    // Asignar memoria para el nuevo nodo
-    Node *n = (Node*)malloc(sizeof(Node));
-    if (!n) {
-        fprintf(stderr, "Error: No se pudo asignar memoria para el nodo.\n");
-        return NULL;
-    }
-    
-    // Inicializar campos del nodo
-    n->fecha_vencimiento = fecha;
-    strncpy(n->producto, producto, MAX_NAME-1);
-    n->producto[MAX_NAME-1] = '\0';  // Asegurar terminacion de cadena
-    n->stock_total = stock;
-    
-    // Inicializar cola FIFO vacia
-    n->cabeza_pedidos = n->tail = NULL;
-    
-    // Inicializar hijos del arbol como NULL
-    n->left = n->right = NULL;
-    
-    // Altura inicial de un nodo hoja es 1
-    n->height = 1;
-    
-    return n;
-}
-
-
-Node* rightRotate(Node *y) {
-    Node *x = y->left;        // x es el hijo izquierdo de y
-    Node *T2 = x->right;      // T2 es el subarbol derecho de x
-    
-    // Realizar la rotacion
-    x->right = y;             // y se convierte en hijo derecho de x
-    y->left = T2;             // T2 se convierte en hijo izquierdo de y
-    
-    // Actualizar alturas (primero y, luego x porque y depende de x)
-    y->height = max(height(y->left), height(y->right)) + 1;
-    x->height = max(height(x->left), height(x->right)) + 1;
-    
-    return x;  // x es la nueva raiz
-}
-
-
-Node* leftRotate(Node *x) {
-    Node *y = x->right;        // y es el hijo derecho de x
-    Node *T2 = y->left;       // T2 es el subarbol izquierdo de y
-    
-    // Realizar la rotacion
-    y->left = x;              // x se convierte en hijo izquierdo de y
-    x->right = T2;            // T2 se convierte en hijo derecho de x
-    
-    // Actualizar alturas (primero x, luego y porque y depende de x)
-    x->height = max(height(x->left), height(x->right)) + 1;
-    y->height = max(height(y->left), height(y->right)) + 1;
-    
-    return y;  // y es la nueva raiz
-}
-
-
-int getBalance(Node *n) {
-    if (!n) return 0;
-    return height(n->left) - height(n->right);
-}
-
-
-bool enqueue_order(Node *node, const char *destino, int cantidad) {
-    if (!node) return false;
-    
-    // Crear nuevo pedido
-    Order *o = (Order*)malloc(sizeof(Order));
-    if (!o) {
-        fprintf(stderr, "Error: No se pudo asignar memoria para el pedido.\n");
-        return false;
-    }
-    
-    // Inicializar datos del pedido
-    strncpy(o->nombre_destino, destino, MAX_DEST-1);
-    o->nombre_destino[MAX_DEST-1] = '\0';  // Asegurar terminacion de cadena
-    o->cantidad_solicitada = cantidad;
-    o->siguiente = NULL;
-    
-    // Agregar al final de la cola FIFO
-    if (!node->cabeza_pedidos) {
-        // Cola vacia: el nuevo pedido es tanto cabeza como cola
-        node->cabeza_pedidos = node->tail = o;
-    } else {
-        // Cola no vacia: agregar despues del último elemento
-        node->tail->siguiente = o;
-        node->tail = o;  // Actualizar puntero tail
-    }
-    
-    return true;
-}
-
-
-int count_orders(Node *node) {
-    int c = 0;
-    Order *p = node ? node->cabeza_pedidos : NULL;
-    while (p) { 
-        c++; 
-        p = p->siguiente; 
-    }
-    return c;
-}
-
-
-void free_orders(Order *head) {
-    Order *p = head;
-    while (p) {
-        Order *tmp = p;        // Guardar referencia al nodo actual
-        p = p->siguiente;     // Avanzar al siguiente
-        free(tmp);            // Liberar memoria del nodo actual
-    }
-}
-
-
-Node* searchNode(Node *root, int fecha) {
-    if (!root) return NULL;  // Árbol vacio o llegamos a una hoja
-    
-    // Comparar fechas
-    if (fecha == root->fecha_vencimiento) 
-        return root;  // Encontrado
-    else if (fecha < root->fecha_vencimiento) 
-        return searchNode(root->left, fecha);   // Buscar en subarbol izquierdo
-    else 
-        return searchNode(root->right, fecha);  // Buscar en subarbol derecho
-}
-
-
-Node* insertAVL(Node *node, int fecha, const char *producto, int stock) {
-    // Caso base: crear nuevo nodo si llegamos a una hoja
-    if (!node) {
-        Node *nuevo = newNode(fecha, producto, stock);
-        if (!nuevo) return NULL;  // Error de memoria
-        return nuevo;
-    }
-    
-    // Insertar recursivamente segun la fecha
-    if (fecha < node->fecha_vencimiento) {
-        // Insertar en subarbol izquierdo (fechas mas antiguas)
-        node->left = insertAVL(node->left, fecha, producto, stock);
-        if (!node->left) return NULL;  // Error en inserción
-    }
-    else if (fecha > node->fecha_vencimiento) {
-        // Insertar en subarbol derecho (fechas mas futuras)
-        node->right = insertAVL(node->right, fecha, producto, stock);
-        if (!node->right) return NULL;  // Error en inserción
-    }
-    else {
-        // FECHA DUPLICADA: segun especificación, no se procesan duplicados
-        printf("ERROR: Ya existe un lote con la fecha %d. No se puede insertar duplicado.\n", fecha);
-        return node;  // Retornar sin cambios
-    }
-
-    // Actualizar altura del nodo actual
-    node->height = 1 + max(height(node->left), height(node->right));
-    
-    // Obtener factor de balance
-    int balance = getBalance(node);
-
-    // CASO LL: Desbalance hacia la izquierda-izquierda
-    // Solución: Rotación simple a la derecha
-    if (balance > 1 && fecha < node->left->fecha_vencimiento) 
-        return rightRotate(node);
-    
-    // CASO RR: Desbalance hacia la derecha-derecha
-    // Solución: Rotación simple a la izquierda
-    if (balance < -1 && fecha > node->right->fecha_vencimiento) 
-        return leftRotate(node);
-    
-    // CASO LR: Desbalance hacia la izquierda-derecha
-    // Solución: Rotación doble (izquierda en hijo, luego derecha en raiz)
-    if (balance > 1 && fecha > node->left->fecha_vencimiento) {
-        node->left = leftRotate(node->left);
-        return rightRotate(node);
-    }
-    
-    // CASO RL: Desbalance hacia la derecha-izquierda
-    // Solución: Rotación doble (derecha en hijo, luego izquierda en raiz)
-    if (balance < -1 && fecha < node->right->fecha_vencimiento) {
-        node->right = rightRotate(node->right);
-        return leftRotate(node);
-    }
-    
-    // Árbol ya está balanceado
-    return node;
-}
-
-
-Node* minValueNode(Node *node) {
-    Node *current = node;
-    if (!current) return NULL;
-    
-    // En un BST, el minimo siempre está en el extremo izquierdo
-    while (current->left) 
-        current = current->left;
-    
-    return current;
-}
-
-
-Node* deleteNode(Node* root, int fecha) {
-    if (!root) return root;  // Caso base: arbol vacio
-    
-    // Buscar el nodo a eliminar recursivamente
-    if (fecha < root->fecha_vencimiento) 
-        root->left = deleteNode(root->left, fecha);
-    else if (fecha > root->fecha_vencimiento) 
-        root->right = deleteNode(root->right, fecha);
-    else {
-        // NODO ENCONTRADO: este es el nodo a eliminar
-        
-        // PASO CRÍTICO: Liberar la cola FIFO antes de eliminar el nodo
-        // Esto previene fugas de memoria (requisito de la rúbrica)
-        free_orders(root->cabeza_pedidos);
-        
-        // CASO 1: Nodo sin hijos o con un solo hijo
-        if (!root->left || !root->right) {
-            Node *temp = root->left ? root->left : root->right;
-            
-            if (!temp) {
-                // Sin hijos: simplemente liberar el nodo
-                free(root);
-                return NULL;
-            } else {
-                // Un hijo: copiar todos los campos del hijo al nodo actual
-                // Esto preserva la cola FIFO del hijo
-                root->fecha_vencimiento = temp->fecha_vencimiento;
-                strncpy(root->producto, temp->producto, MAX_NAME-1);
-                root->producto[MAX_NAME-1] = '\0';
-                root->stock_total = temp->stock_total;
-                root->cabeza_pedidos = temp->cabeza_pedidos;  // Preservar cola del hijo
-                root->tail = temp->tail;
-                root->left = temp->left;
-                root->right = temp->right;
-                root->height = temp->height;
-                
-                // IMPORTANTE: Limpiar punteros del hijo antes de liberarlo
-                // para evitar que se libere la cola dos veces
-                temp->cabeza_pedidos = NULL;
-                temp->tail = NULL;
-                free(temp);
-            }
-        } else {
-            // CASO 2: Nodo con dos hijos
-            // Estrategia: Reemplazar con el sucesor en orden (minimo del subarbol derecho)
-            
-            Node *temp = minValueNode(root->right);
-            
-            // Copiar datos del sucesor al nodo actual
-            root->fecha_vencimiento = temp->fecha_vencimiento;
-            strncpy(root->producto, temp->producto, MAX_NAME-1);
-            root->producto[MAX_NAME-1] = '\0';
-            root->stock_total = temp->stock_total;
-            
-            // Clonar la cola FIFO del sucesor (ya liberamos la cola actual arriba)
-            free_orders(root->cabeza_pedidos);
-            root->cabeza_pedidos = NULL; 
-            root->tail = NULL;
-            
-            // Clonar todos los pedidos del sucesor
-            Order *p = temp->cabeza_pedidos;
-            while (p) {
-                if (!enqueue_order(root, p->nombre_destino, p->cantidad_solicitada)) {
-                    fprintf(stderr, "Advertencia: Error al clonar algunos pedidos.\n");
-                }
-                p = p->siguiente;
-            }
-            
-            // Eliminar el sucesor del subarbol derecho
-            root->right = deleteNode(root->right, temp->fecha_vencimiento);
-        }
-    }
-    
-    if (!root) return root;  // Si el arbol quedó vacio
-    
-    // PASO CRÍTICO: Rebalancear el arbol despues de la eliminación
-    root->height = 1 + max(height(root->left), height(root->right));
-    int balance = getBalance(root);
-
-    // CASO LL: Desbalance hacia la izquierda-izquierda
-    if (balance > 1 && getBalance(root->left) >= 0) 
-        return rightRotate(root);
-    
-    // CASO LR: Desbalance hacia la izquierda-derecha
-    if (balance > 1 && getBalance(root->left) < 0) {
-        root->left = leftRotate(root->left);
-        return rightRotate(root);
-    }
-    
-    // CASO RR: Desbalance hacia la derecha-derecha
-    if (balance < -1 && getBalance(root->right) <= 0) 
-        return leftRotate(root);
-    
-    // CASO RL: Desbalance hacia la derecha-izquierda
-    if (balance < -1 && getBalance(root->right) > 0) {
-        root->right = rightRotate(root->right);
-        return leftRotate(root);
-    }
-    
-    return root;
-}
-
-
-Node* findNode(Node *root, int fecha) {
-    return searchNode(root, fecha);
-}
-
-
-int cancel_order_in_node(Node *node, const char *destino, int cantidad) {
-    if (!node || !node->cabeza_pedidos) return 0;
-    
-    Order *prev = NULL;           // Puntero al pedido anterior
-    Order *cur = node->cabeza_pedidos;  // Puntero al pedido actual
-    
-    // Buscar el pedido en la cola
-    while (cur) {
-        // Verificar si este es el pedido a cancelar (debe coincidir destino Y cantidad)
-        if (strcmp(cur->nombre_destino, destino) == 0 && cur->cantidad_solicitada == cantidad) {
-            // PEDIDO ENCONTRADO: eliminarlo de la cola
-            
-            if (!prev) {
-                // Es el primer pedido: actualizar cabeza
-                node->cabeza_pedidos = cur->siguiente;
-                if (node->tail == cur) node->tail = NULL;  // Si era el único, cola queda vacia
-            } else {
-                // No es el primer pedido: enlazar anterior con siguiente
-                prev->siguiente = cur->siguiente;
-                if (node->tail == cur) node->tail = prev;  // Si era el último, actualizar tail
-            }
-            
-            // Restaurar el stock del lote (sumar la cantidad cancelada)
-            node->stock_total += cantidad;
-            
-            // Liberar memoria del pedido eliminado
-            free(cur);
-            return 1;  // Éxito
-        }
-        
-        // Avanzar al siguiente pedido
-        prev = cur;
-        cur = cur->siguiente;
-    }
-    
-    return 0;  // Pedido no encontrado
-}
-
-
-void mostrar_pedidos(Node *node) {
-    if (!node || !node->cabeza_pedidos) {
-        printf("  No hay pedidos pendientes.\n");
-        return;
-    }
-    
-    Order *p = node->cabeza_pedidos;
-    int num = 1;
-    printf("  Pedidos pendientes:\n");
-    printf("  +-----+----------------------+--------------+\n");
-    printf("  | No. | Destino              | Cantidad     |\n");
-    printf("  +-----+----------------------+--------------+\n");
-    
-    while (p) {
-        printf("  | %-3d | %-20s | %12d |\n", num++, p->nombre_destino, p->cantidad_solicitada);
-        p = p->siguiente;
-    }
-    
-    printf("  +-----+----------------------+--------------+\n");
-}
-
-
-void inorder_report(Node *root) {
-    if (!root) return;
-    
-    // Recorrer subarbol izquierdo (fechas mas antiguas primero)
-    inorder_report(root->left);
-    
-    // Procesar nodo actual: mostrar informacion del lote
-
-    printf("LOTE: %s\n", root->producto);
-
-    
-    printf("Fecha de vencimiento: %s\n", formatear_fecha(root->fecha_vencimiento));
-    printf("Stock disponible: %d\n", root->stock_total);
-    printf("Pedidos pendientes: %d\n", count_orders(root));
-    mostrar_pedidos(root);
-    
-    // Recorrer subarbol derecho (fechas mas futuras despues)
-    inorder_report(root->right);
-}
-
-
-void free_tree(Node *root) {
-    if (!root) return;
-    
-    // Liberar recursivamente los subarboles
-    free_tree(root->left);
-    free_tree(root->right);
-    
-    // Liberar la cola FIFO del nodo (CRÍTICO para evitar fugas de memoria)
-    free_orders(root->cabeza_pedidos);
-    
-    // Finalmente, liberar el nodo
-    free(root);
-}
+#include "inventario.h"
 
 
- */
 void read_line(char *buffer, int size) {
     if (fgets(buffer, size, stdin) == NULL) {
         buffer[0] = '\0';  // En caso de error, dejar buffer vacio
@@ -523,106 +22,49 @@ void limpiar_buffer(void) {
 }
 
 
-bool guardar_arbol(Node *root, const char *filename) {
-    FILE *f = fopen(filename, "wb");
-    if (!f) return false;
-    
-    // Funcion auxiliar recursiva para guardar en pre-order
-    void guardar_nodo(Node *n) {
-        if (!n) {
-            int marcador = -1;  // Marcador de fin de nodo
-            fwrite(&marcador, sizeof(int), 1, f);
-            return;
-        }
-        
-        // Guardar datos del nodo
-        fwrite(&n->fecha_vencimiento, sizeof(int), 1, f);
-        fwrite(n->producto, sizeof(char), MAX_NAME, f);
-        fwrite(&n->stock_total, sizeof(int), 1, f);
-        
-        // Guardar cola FIFO: primero el numero de pedidos
-        int num_pedidos = count_orders(n);
-        fwrite(&num_pedidos, sizeof(int), 1, f);
-        
-        // Luego cada pedido (destino + cantidad)
-        Order *p = n->cabeza_pedidos;
-        while (p) {
-            fwrite(p->nombre_destino, sizeof(char), MAX_DEST, f);
-            fwrite(&p->cantidad_solicitada, sizeof(int), 1, f);
-            p = p->siguiente;
+unsigned parsear_columnas(const char *texto) {
+    // Letras de las columnas del reporte; vacio o '*' = todas, '-' = solo totales
+    if (texto[0] == '\0' || strcmp(texto, "*") == 0) return COLUMNAS_TODAS;
+    if (strcmp(texto, "-") == 0) return COLUMNAS_RESUMEN;
+    unsigned columnas = 0;
+    for (const char *c = texto; *c; c++) {
+        switch (*c) {
+            case 'p': case 'P': columnas |= COLUMNA_PRODUCTO; break;
+            case 'f': case 'F': columnas |= COLUMNA_FECHA; break;
+            case 's': case 'S': columnas |= COLUMNA_STOCK; break;
+            case 'n': case 'N': columnas |= COLUMNA_PEDIDOS; break;
+            case 'd': case 'D': columnas |= COLUMNA_DETALLE; break;
+            default: break;  // Separadores u otras letras se ignoran
         }
-        
-        // Guardar subarboles recursivamente (pre-order)
-        guardar_nodo(n->left);
-        guardar_nodo(n->right);
     }
-    
-    guardar_nodo(root);
-    fclose(f);
-    return true;
+    return columnas;
 }
 
 
-Node* cargar_arbol(const char *filename) {
-    FILE *f = fopen(filename, "rb");
-    if (!f) return NULL;
+Node* elegir_lote(Node *root, int fecha) {
+    // Lote de la fecha; si ese dia vence mas de uno, el usuario elige entre ellos
+    Node *primero = searchNode(root, fecha);
+    if (!primero) return NULL;
+    Node *siguiente = siguiente_inorden(primero);
+    if (!siguiente || siguiente->fecha_vencimiento != fecha) return primero;
     
-    Node* cargar_nodo(FILE *file) {
-        int fecha;
-        if (fread(&fecha, sizeof(int), 1, file) != 1) {
-            return NULL;
-        }
-        
-        if (fecha == -1) return NULL;  // Marcador de fin de nodo
-        
-        char producto[MAX_NAME];
-        int stock;
-        
-        // Leer datos del nodo
-        if (fread(producto, sizeof(char), MAX_NAME, file) != MAX_NAME ||
-            fread(&stock, sizeof(int), 1, file) != 1) {
-            return NULL;
-        }
-        
-        // Crear nodo con los datos leidos
-        Node *n = newNode(fecha, producto, stock);
-        if (!n) {
-            return NULL;
-        }
-        
-        // Cargar numero de pedidos
-        int num_pedidos;
-        if (fread(&num_pedidos, sizeof(int), 1, file) != 1) {
-            free(n);
-            return NULL;
-        }
-        
-        // Cargar cada pedido y reconstruir la cola FIFO
-        for (int i = 0; i < num_pedidos; i++) {
-            char destino[MAX_DEST];
-            int cantidad;
-            if (fread(destino, sizeof(char), MAX_DEST, file) != MAX_DEST ||
-                fread(&cantidad, sizeof(int), 1, file) != 1) {
-                free_tree(n);
-                return NULL;
-            }
-            enqueue_order(n, destino, cantidad);
-            n->stock_total -= cantidad;  // Ajustar stock (restar pedidos pendientes)
-        }
-        
-        // Cargar subarboles recursivamente (pre-order)
-        n->left = cargar_nodo(file);
-        n->right = cargar_nodo(file);
-        
-        // Actualizar altura del nodo
-        n->height = 1 + max(height(n->left), height(n->right));
-        
-        return n;
+    int total = 0;
+    printf("Lotes que vencen el %s:\n", formatear_fecha(fecha));
+    for (Node *n = primero; n && n->fecha_vencimiento == fecha; n = siguiente_inorden(n)) {
+        printf("  %d. %-20s | Stock: %d | Pedidos: %d\n", ++total, cadena_texto(n->producto),
+               n->stock_total, n->num_pedidos);
     }
-    
-    Node *root = cargar_nodo(f);
-    fclose(f);
-    return root;
+    int opcion;
+    printf("Seleccione el lote (1-%d): ", total);
+    if (scanf("%d", &opcion) != 1 || opcion < 1 || opcion > total) {
+        limpiar_buffer();
+        printf("Error: Lote invalido.\n");
+        return NULL;
+    }
+    limpiar_buffer();
+    Node *n = primero;
+    while (--opcion > 0) n = siguiente_inorden(n);
+    return n;
 }
 
 
@@ -638,6 +80,14 @@ Node* ingresar_productos_multiples(Node *root) {
     
     printf("\n=== INGRESO DE %d PRODUCTOS ===\n\n", cantidad);
     
+    // Los lotes validos se acumulan y se insertan juntos al final
+    LoteEntrada *lotes = (LoteEntrada*)malloc((size_t)cantidad * sizeof(LoteEntrada));
+    if (!lotes) {
+        printf("Error: No hay memoria para %d productos.\n", cantidad);
+        return root;
+    }
+    size_t n = 0;
+    
     for (int i = 0; i < cantidad; i++) {
         printf("--- Producto %d de %d ---\n", i + 1, cantidad);
         
@@ -677,28 +127,52 @@ Node* ingresar_productos_multiples(Node *root) {
         }
         limpiar_buffer();
         
-        // Verificar duplicados e insertar
-        if (searchNode(root, fecha)) {
-            printf("Ya existe un lote con fecha %s. Se omite.\n", formatear_fecha(fecha));
+        // Registrar el lote para la insercion masiva
+        lotes[n].fecha_vencimiento = fecha;
+        strcpy(lotes[n].producto, producto);
+        lotes[n].stock = stock;
+        n++;
+        printf("\n");
+    }
+    
+    // Insercion masiva: ordena (los lotes de un mismo dia en orden de llegada) y construye el arbol balanceado
+    size_t insertados;
+    root = insertar_lotes_masivo(root, lotes, n, &insertados);
+    for (size_t i = 0; i < n; i++) {
+        if (lotes[i].insertado) {
+            journal_registrar(JOURNAL_INSERTAR, lotes[i].fecha_vencimiento, 0, lotes[i].stock, 0, lotes[i].producto);
+            printf("Producto '%s' insertado correctamente.\n", lotes[i].producto);
         } else {
-            Node *nuevo_root = insertAVL(root, fecha, producto, stock);
-            if (nuevo_root) {
-                root = nuevo_root;
-                printf("Producto '%s' insertado correctamente.\n", producto);
-            } else {
-                printf("Error al insertar producto.\n");
-            }
+            printf("✗ No se pudo insertar '%s' (error de memoria).\n", lotes[i].producto);
         }
-        printf("\n");
     }
+    free(lotes);
     
     printf("=== Ingreso completado ===\n");
     return root;
 }
 
 
- */
-int main() {
+int main(int argc, char *argv[]) {
+    // Modo por lotes: sin menu ni mensajes interactivos
+    if (argc == 3 && strcmp(argv[1], "--ingesta") == 0) {
+        return ejecutar_ingesta(argv[2]);
+    }
+    
+    // --limite-cola <n>: pedidos residentes por lote; los mas viejos se
+    // despachan al historial al encolar sobre una cola llena
+    int limite = 0;
+    if (argc == 3 && strcmp(argv[1], "--limite-cola") == 0) {
+        limite = atoi(argv[2]);
+        if (limite <= 0) {
+            fprintf(stderr, "Error: El limite de la cola debe ser positivo.\n");
+            return 1;
+        }
+    } else if (argc != 1) {
+        fprintf(stderr, "Uso: %s [--ingesta <archivo|-> | --limite-cola <n>]\n", argv[0]);
+        return 1;
+    }
+    
     Node *root = NULL;  // Raíz del arbol AVL (inicialmente vacio)
     int opc = 0;
     
@@ -709,16 +183,36 @@ int main() {
     limpiar_buffer();
     
     if (respuesta == 's' || respuesta == 'S') {
-        root = cargar_arbol(ARCHIVO_DATOS);
+        // Instantanea mas las operaciones del journal posteriores a ella
+        root = cargar_inventario();
         if (root) {
             printf("✓ Inventario cargado correctamente.\n");
         } else {
             printf("ℹ No se encontró inventario guardado o el archivo esta vacio.\n");
         }
+    } else {
+        journal_abrir(JOURNAL_BASE_VACIA, 0);
+    }
+    
+    // El limite se fija despues de cargar: la carga no desaloja pedidos
+    if (historial_abrir(ARCHIVO_HISTORIAL) && limite > 0) {
+        limitar_cola_pedidos(limite);
+        printf("ℹ Colas limitadas a %d pedidos por lote (historial en '%s').\n", limite, ARCHIVO_HISTORIAL);
+    } else if (limite > 0) {
+        printf("ℹ Sin historial: las colas no se limitan.\n");
     }
     
     // Bucle principal del menú
     while (1) {
+#ifdef VERSIONES
+        // Recoger un guardado en segundo plano que ya termino
+        int fondo = guardado_recoger(false);
+        if (fondo > 0) printf("✓ Guardado en segundo plano completado en '%s'.\n", ARCHIVO_DATOS);
+        else if (fondo < 0) printf("✗ Error en el guardado en segundo plano.\n");
+#endif
+        // Commit agrupado de las operaciones de la opcion anterior
+        journal_confirmar(root);
+        
         // Mostrar menú de opciones
         
         printf("         SISTEMA LOGISTICO - BUENAVENTURA                \n");
@@ -732,6 +226,14 @@ int main() {
         printf("  7. Guardar inventario                                  \n");
         printf("  8. Cargar inventario                                   \n");
         printf("  9. Salir                                               \n");
+        printf(" 10. Totales por rango de fechas                         \n");
+        printf(" 11. Retirar lotes vencidos                              \n");
+        printf(" 13. Exportar reporte (texto, JSON o CSV)                \n");
+        printf(" 14. Consultar y despachar por producto                  \n");
+        printf(" 15. Despachar y compactar la cola de un lote            \n");
+#ifdef ESTADISTICAS
+        printf(" 12. Estadisticas internas                               \n");
+#endif
 
         printf("Seleccione opcion: ");
         
@@ -784,18 +286,14 @@ int main() {
             }
             limpiar_buffer();
 
-            // Verificar si ya existe un lote con esa fecha
-            if (searchNode(root, fecha)) {
-                printf("⚠ Ya existe un lote con fecha %s. No se procesa.\n", formatear_fecha(fecha));
+            // Insertar nuevo lote en el arbol AVL (si la fecha ya tiene lotes, se agrega a ese dia)
+            Node *nuevo_root = insertAVL(root, fecha, producto, cantidad);
+            if (nuevo_root) {
+                root = nuevo_root;
+                journal_registrar(JOURNAL_INSERTAR, fecha, 0, cantidad, 0, producto);
+                printf("✓ Lote insertado correctamente.\n");
             } else {
-                // Insertar nuevo lote en el arbol AVL
-                Node *nuevo_root = insertAVL(root, fecha, producto, cantidad);
-                if (nuevo_root) {
-                    root = nuevo_root;
-                    printf("✓ Lote insertado correctamente.\n");
-                } else {
-                    printf("✗ Error: No se pudo insertar el lote (error de memoria).\n");
-                }
+                printf("✗ Error: No se pudo insertar el lote (error de memoria).\n");
             }
         }
         // OPCION 2: Recepción múltiple de mercancía
@@ -812,7 +310,7 @@ int main() {
             
             // Buscar el lote con fecha mas proxima a vencer (minimo del arbol)
             // Esto garantiza que siempre se use el lote mas antiguo primero (FIFO por fecha)
-            Node *lote = minValueNode(root);
+            Node *lote = buscar_lote_minimo(root);
             if (!lote) {
                 printf("Error: No se pudo encontrar el lote mas proximo a vencer.\n");
                 continue;
@@ -821,7 +319,7 @@ int main() {
             // Mostrar información del lote seleccionado
             printf("\n=== REGISTRAR PEDIDO DE DESPACHO ===\n");
             printf("Lote seleccionado (fecha mas proxima a vencer):\n");
-            printf("  Producto: %s\n", lote->producto);
+            printf("  Producto: %s\n", cadena_texto(lote->producto));
             printf("  Fecha de vencimiento: %s\n", formatear_fecha(lote->fecha_vencimiento));
             printf("  Stock disponible: %d\n", lote->stock_total);
             
@@ -853,13 +351,36 @@ int main() {
             
             // Verificar disponibilidad de stock
             if (qty > lote->stock_total) {
-                printf("Error: Stock insuficiente (stock=%d). No se puede registrar pedido.\n", lote->stock_total);
+                if (qty > root->stock_subarbol) {
+                    printf("Error: Stock insuficiente (stock=%d, total del inventario=%lld). No se puede registrar pedido.\n",
+                           lote->stock_total, root->stock_subarbol);
+                    continue;
+                }
+                
+                // El lote no alcanza pero el inventario si: ofrecer repartir por vencimiento
+                printf("El lote solo tiene %d unidades. ¿Repartir el pedido entre los siguientes lotes por vencimiento? (s/n): ",
+                       lote->stock_total);
+                char resp;
+                scanf(" %c", &resp);
+                limpiar_buffer();
+                if (resp != 's' && resp != 'S') {
+                    printf("Pedido no registrado.\n");
+                    continue;
+                }
+                int asignadas = repartir_pedido_fefo(root, destino, qty, true);
+                if (asignadas == qty) {
+                    printf("✓ Pedido repartido correctamente (%d unidades).\n", qty);
+                } else {
+                    printf("✗ Error: Solo se asignaron %d de %d unidades (error de memoria).\n", asignadas, qty);
+                }
             } else {
                 // Agregar pedido a la cola FIFO del lote
-                if (enqueue_order(lote, destino, qty)) {
+                uint32_t id = enqueue_order(lote, destino, qty);
+                if (id) {
                     // Descontar stock del lote
-                    lote->stock_total -= qty;
-                    printf("✓ Pedido encolado correctamente.\n");
+                    ajustar_stock(lote, -qty);
+                    journal_registrar(JOURNAL_ENCOLAR, lote->fecha_vencimiento, lote->secuencia, qty, id, destino);
+                    printf("✓ Pedido #%u encolado correctamente.\n", id);
                     printf("  Nuevo stock: %d\n", lote->stock_total);
                 } else {
                     printf("✗ Error: No se pudo registrar el pedido (error de memoria).\n");
@@ -888,11 +409,13 @@ int main() {
             }
             
             // Verificar que el lote existe
-            Node *lote = searchNode(root, fecha);
-            if (!lote) {
+            if (!searchNode(root, fecha)) {
                 printf("✗ No existe lote con fecha %s.\n", formatear_fecha(fecha));
-            } else {
-                printf("Lote encontrado: %s - %s\n", formatear_fecha(fecha), lote->producto);
+                continue;
+            }
+            Node *lote = elegir_lote(root, fecha);
+            if (lote) {
+                printf("Lote encontrado: %s - %s\n", formatear_fecha(fecha), cadena_texto(lote->producto));
                 printf("¿Está seguro de eliminar este lote? (s/n): ");
                 char confirmar;
                 scanf(" %c", &confirmar);
@@ -900,7 +423,9 @@ int main() {
                 
                 if (confirmar == 's' || confirmar == 'S') {
                     // Eliminar el nodo completo (incluye liberar su cola FIFO)
-                    root = deleteNode(root, fecha);
+                    uint32_t secuencia = lote->secuencia;
+                    root = deleteNode(root, fecha, secuencia);
+                    journal_registrar(JOURNAL_ELIMINAR, fecha, secuencia, 0, 0, NULL);
                     printf("✓ Lote eliminado correctamente (memoria liberada).\n");
                 } else {
                     printf("Operación cancelada.\n");
@@ -929,11 +454,12 @@ int main() {
             }
             
             // Buscar el lote en el arbol
-            Node *n = findNode(root, fecha);
-            if (!n) {
+            if (!findNode(root, fecha)) {
                 printf("No existe lote con fecha %d.\n", fecha);
                 continue;
             }
+            Node *n = elegir_lote(root, fecha);
+            if (!n) continue;
             
             // Verificar que haya pedidos en la cola
             if (!n->cabeza_pedidos) {
@@ -945,33 +471,56 @@ int main() {
             printf("\nPedidos disponibles en este lote:\n");
             mostrar_pedidos(n);
             
-            char destino[MAX_DEST];
-            int cantidad;
-            
-            // Solicitar destino del pedido a cancelar
-            printf("Ingrese destino del pedido a cancelar: ");
-            read_line(destino, MAX_DEST);
-            if (strlen(destino) == 0) {
-                printf("Error: El destino no puede estar vacio.\n");
-                continue;
-            }
-            
-            // Solicitar cantidad exacta del pedido a cancelar
-            printf("Ingrese cantidad exacta del pedido a cancelar: ");
-            if (scanf("%d", &cantidad) != 1 || cantidad <= 0) {
-                printf("Error: Cantidad invalida. Debe ser un numero positivo.\n");
+            // Solicitar el ID del pedido (acceso directo por el indice)
+            unsigned int id;
+            printf("Ingrese ID del pedido a cancelar (0 para buscar por destino y cantidad): ");
+            if (scanf("%u", &id) != 1) {
+                printf("Error: ID invalido.\n");
                 limpiar_buffer();
                 continue;
             }
             limpiar_buffer();
             
-            // Intentar cancelar el pedido (busca por destino Y cantidad)
-            int ok = cancel_order_in_node(n, destino, cantidad);
-            if (ok) {
-                printf("✓ Pedido eliminado correctamente. Stock restaurado.\n");
+            Order *pedido;
+            if (id != 0) {
+                pedido = buscar_pedido_por_id(id);
+                if (!pedido || pedido->lote != n) {
+                    printf("✗ No existe un pedido con ID %u en este lote.\n", id);
+                    continue;
+                }
             } else {
-                printf("✗ No se encontro un pedido con ese destino y cantidad en la cola.\n");
+                char destino[MAX_DEST];
+                int cantidad;
+                
+                // Solicitar destino del pedido a cancelar
+                printf("Ingrese destino del pedido a cancelar: ");
+                read_line(destino, MAX_DEST);
+                if (strlen(destino) == 0) {
+                    printf("Error: El destino no puede estar vacio.\n");
+                    continue;
+                }
+                
+                // Solicitar cantidad exacta del pedido a cancelar
+                printf("Ingrese cantidad exacta del pedido a cancelar: ");
+                if (scanf("%d", &cantidad) != 1 || cantidad <= 0) {
+                    printf("Error: Cantidad invalida. Debe ser un numero positivo.\n");
+                    limpiar_buffer();
+                    continue;
+                }
+                limpiar_buffer();
+                
+                // Busqueda de respaldo por destino Y cantidad
+                pedido = buscar_pedido(n, destino, cantidad);
+                if (!pedido) {
+                    printf("✗ No se encontro un pedido con ese destino y cantidad en la cola.\n");
+                    continue;
+                }
             }
+            
+            // Cancelar el pedido localizado (el journal lo registra por ID)
+            journal_registrar(JOURNAL_CANCELAR, fecha, n->secuencia, pedido->cantidad_solicitada, pedido->id, cadena_texto(pedido->destino));
+            cancel_order_by_id(pedido->id);
+            printf("✓ Pedido eliminado correctamente. Stock restaurado.\n");
         }
         // OPCION 6: Reporte de estado (In-Order)
         else if (opc == 6) {
@@ -982,13 +531,27 @@ int main() {
         
                 printf("                   REPORTE DE INVENTARIO                      \n");
                 printf("  Ordenado por fecha: mas proxima a vencer → mas lejana       \n");
+                printf("  Lotes: %d | Stock total: %lld | Pedidos pendientes: %ld (%lld unidades)\n",
+                       root->lotes_subarbol, root->stock_subarbol,
+                       root->pedidos_subarbol, root->pendiente_subarbol);
                 inorder_report(root);
                 printf("\n");
             }
         }
-        // OPCION 7: Guardar inventario
+        // OPCION 7: Guardar inventario (checkpoint: la instantanea absorbe el journal)
         else if (opc == 7) {
-            if (guardar_arbol(root, ARCHIVO_DATOS)) {
+#ifdef VERSIONES
+            // La version actual se escribe en otro hilo; el menu sigue disponible
+            if (guardado_en_curso()) {
+                printf("ℹ Ya hay un guardado en curso.\n");
+                continue;
+            }
+            if (guardado_iniciar()) {
+                printf("ℹ Guardando inventario en segundo plano...\n");
+                continue;
+            }
+#endif
+            if (checkpoint_inventario(root)) {
                 printf("✓ Inventario guardado correctamente en '%s'.\n", ARCHIVO_DATOS);
             } else {
                 printf("✗ Error al guardar el inventario.\n");
@@ -996,6 +559,7 @@ int main() {
         }
         // OPCION 8: Cargar inventario
         else if (opc == 8) {
+            guardado_esperar();  // El archivo a cargar puede estar por reemplazarse
             if (root) {
                 printf("⚠ Ya hay datos en memoria. ¿Desea sobrescribir? (s/n): ");
                 char respuesta;
@@ -1008,13 +572,252 @@ int main() {
                 free_tree(root);
             }
             
-            root = cargar_arbol(ARCHIVO_DATOS);
+            // Volver al ultimo inventario guardado: los cambios del journal se descartan
+            // y el journal se reinicia siempre sobre lo que quedo cargado
+            SnapshotCabecera cab;
+            if (archivo_formato_anterior(ARCHIVO_DATOS)) {
+                // Como al iniciar: se convierte solo si se cargo completo
+                root = cargar_inventario_anterior();
+            } else if (snapshot_leer_cabecera(ARCHIVO_DATOS, &cab)) {
+                root = cargar_arbol(ARCHIVO_DATOS);
+                if (root || cab.num_nodos == 0) {
+                    journal_abrir(JOURNAL_BASE_SNAPSHOT, cab.checksum);
+                } else {
+                    // Instantanea ilegible: no registrar sobre ella
+                    journal_desactivar();
+                }
+            } else {
+                // Sin archivo: inventario vacio
+                root = NULL;
+                journal_abrir(JOURNAL_BASE_VACIA, 0);
+            }
             if (root) {
                 printf("✓ Inventario cargado correctamente desde '%s'.\n", ARCHIVO_DATOS);
             } else {
                 printf("✗ Error al cargar el inventario o el archivo no existe.\n");
             }
         }
+        // OPCION 10: Totales por rango de fechas (agregados del arbol, O(log n))
+        else if (opc == 10) {
+            int d1, m1, a1, d2, m2, a2;
+            
+            printf("\n=== TOTALES POR RANGO DE FECHAS ===\n");
+            printf("Desde (DD MM YYYY): ");
+            if (scanf("%d %d %d", &d1, &m1, &a1) != 3) {
+                printf("Error: Formato invalido. Use: DD MM YYYY\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            printf("Hasta (DD MM YYYY): ");
+            if (scanf("%d %d %d", &d2, &m2, &a2) != 3) {
+                printf("Error: Formato invalido. Use: DD MM YYYY\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            
+            int desde = convertir_fecha_a_int(d1, m1, a1);
+            int hasta = convertir_fecha_a_int(d2, m2, a2);
+            if (desde == -1 || hasta == -1 || desde > hasta) {
+                printf("Error: Rango de fechas invalido.\n");
+                continue;
+            }
+            
+            Totales t = totales_rango(root, desde, hasta);
+            printf("Lotes en el rango: %d\n", t.lotes);
+            printf("Stock disponible: %lld\n", t.stock);
+            printf("Pedidos pendientes: %ld (%lld unidades)\n", t.pedidos, t.pendiente);
+            
+            // Listado de los lotes del rango (sin recorrer el resto del arbol)
+            IteradorRango it = iterador_rango(root, desde, hasta);
+            Node *n;
+            while ((n = iterador_rango_siguiente(&it)) != NULL) {
+                printf("  %s | %-20s | Stock: %d | Pedidos: %d\n", formatear_fecha(n->fecha_vencimiento),
+                       cadena_texto(n->producto), n->stock_total, n->num_pedidos);
+            }
+        }
+        // OPCION 11: Retirar todos los lotes vencidos antes de una fecha
+        else if (opc == 11) {
+            int dia, mes, anio;
+            
+            printf("\n=== RETIRAR LOTES VENCIDOS ===\n");
+            printf("Retirar lotes que vencen antes de (DD MM YYYY): ");
+            if (scanf("%d %d %d", &dia, &mes, &anio) != 3) {
+                printf("Error: Formato invalido. Use: DD MM YYYY\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            
+            int corte = convertir_fecha_a_int(dia, mes, anio);
+            if (corte == -1 || !validar_fecha(corte)) {
+                printf("Error: Fecha invalida. Verifique el formato.\n");
+                continue;
+            }
+            
+            Totales quitados;
+            root = purgar_vencidos(root, corte, &quitados);
+            if (quitados.lotes > 0) journal_registrar(JOURNAL_PURGAR, corte, 0, 0, 0, NULL);
+            printf("✓ Lotes retirados: %d | Stock descartado: %lld | Pedidos cancelados: %ld (%lld unidades)\n",
+                   quitados.lotes, quitados.stock, quitados.pedidos, quitados.pendiente);
+        }
+        // OPCION 13: Reporte con columnas elegidas, a pantalla o a archivo
+        else if (opc == 13) {
+            int formato;
+            char columnas[32], ruta[256];
+            
+            printf("\n=== EXPORTAR REPORTE ===\n");
+            printf("Formato (1=texto, 2=JSON, 3=CSV): ");
+            if (scanf("%d", &formato) != 1 || formato < 1 || formato > 3) {
+                printf("Error: Formato invalido.\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            printf("Columnas (p=producto f=fecha s=stock n=pedidos d=detalle; vacio=todas, -=solo totales): ");
+            read_line(columnas, sizeof(columnas));
+            printf("Archivo de salida (vacio = pantalla): ");
+            read_line(ruta, sizeof(ruta));
+            
+            FILE *salida = ruta[0] ? fopen(ruta, "w") : stdout;
+            if (!salida) {
+                printf("✗ No se pudo abrir '%s'.\n", ruta);
+                continue;
+            }
+            FormatoReporte tipo = formato == 2 ? REPORTE_JSON : formato == 3 ? REPORTE_CSV : REPORTE_TEXTO;
+            bool ok = reporte_inventario(root, salida, tipo, parsear_columnas(columnas));
+            if (salida != stdout) {
+                ok = (fclose(salida) == 0) && ok;
+                if (ok) printf("✓ Reporte exportado en '%s'.\n", ruta);
+            }
+            if (!ok) printf("✗ Error al escribir el reporte.\n");
+        }
+        // OPCION 14: Lotes de un producto por vencimiento y despacho FEFO del producto
+        else if (opc == 14) {
+            char producto[MAX_NAME];
+            
+            printf("\n=== CONSULTAR PRODUCTO ===\n");
+            printf("Nombre del producto: ");
+            read_line(producto, MAX_NAME);
+            
+            // Lotes del producto desde el indice por producto (ya en orden FEFO)
+            Node *lote = producto_lote_fefo(root, producto);
+            if (!lote) {
+                printf("No hay lotes de '%s' en inventario.\n", producto);
+                continue;
+            }
+            for (Node *n = lote; n; n = n->producto_siguiente) {
+                printf("  %s | Stock: %d | Pedidos: %d\n", formatear_fecha(n->fecha_vencimiento),
+                       n->stock_total, n->num_pedidos);
+            }
+            Totales t = totales_producto(root, producto);
+            printf("Lotes: %d | Stock disponible: %lld | Pedidos pendientes: %ld (%lld unidades)\n",
+                   t.lotes, t.stock, t.pedidos, t.pendiente);
+            
+            printf("¿Registrar un pedido de este producto? (s/n): ");
+            char resp;
+            scanf(" %c", &resp);
+            limpiar_buffer();
+            if (resp != 's' && resp != 'S') continue;
+            
+            char destino[MAX_DEST];
+            int qty;
+            printf("Ingresar destino del pedido: ");
+            read_line(destino, MAX_DEST);
+            if (strlen(destino) == 0) {
+                printf("Error: El destino no puede estar vacio.\n");
+                continue;
+            }
+            printf("Ingresar cantidad solicitada: ");
+            if (scanf("%d", &qty) != 1) {
+                printf("Error: Cantidad invalida.\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            if (qty <= 0) {
+                printf("Error: La cantidad debe ser positiva.\n");
+                continue;
+            }
+            if (qty > t.stock) {
+                printf("Error: Stock insuficiente de '%s' (disponible=%lld).\n", producto, t.stock);
+                continue;
+            }
+            
+            // Se reparte entre los lotes del producto, del mas proximo a vencer en adelante
+            int asignadas = repartir_pedido_producto(root, producto, destino, qty, true);
+            if (asignadas == qty) {
+                printf("✓ Pedido registrado correctamente (%d unidades).\n", qty);
+            } else {
+                printf("✗ Error: Solo se asignaron %d de %d unidades (error de memoria).\n", asignadas, qty);
+            }
+        }
+        // OPCION 15: Despachar desde la cabeza de la cola (el stock ya estaba
+        // descontado) y unir pedidos consecutivos al mismo destino
+        else if (opc == 15) {
+            int dia, mes, anio;
+            
+            printf("\n=== DESPACHO DE LA COLA DE UN LOTE ===\n");
+            printf("Ingrese fecha del lote (DD MM YYYY): ");
+            if (scanf("%d %d %d", &dia, &mes, &anio) != 3) {
+                printf("Error: Formato invalido.\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            
+            int fecha = convertir_fecha_a_int(dia, mes, anio);
+            if (fecha == -1 || !validar_fecha(fecha)) {
+                printf("Error: Fecha invalida.\n");
+                continue;
+            }
+            if (!findNode(root, fecha)) {
+                printf("No existe lote con fecha %d.\n", fecha);
+                continue;
+            }
+            Node *n = elegir_lote(root, fecha);
+            if (!n) continue;
+            if (!n->cabeza_pedidos) {
+                printf("La cola de pedidos está vacia en ese lote.\n");
+                continue;
+            }
+            mostrar_pedidos(n);
+            
+            printf("¿Unir pedidos consecutivos al mismo destino? (s/n): ");
+            char resp;
+            scanf(" %c", &resp);
+            limpiar_buffer();
+            if (resp == 's' || resp == 'S') {
+                int fusionados = compactar_pedidos(n);
+                printf("✓ %d pedidos unidos al anterior. Quedan %d en la cola.\n", fusionados, n->num_pedidos);
+            }
+            
+            int cantidad;
+            printf("Pedidos a despachar desde la cabeza (0 = ninguno): ");
+            if (scanf("%d", &cantidad) != 1 || cantidad < 0) {
+                printf("Error: Cantidad invalida.\n");
+                limpiar_buffer();
+                continue;
+            }
+            limpiar_buffer();
+            if (cantidad > 0) {
+                int despachados = despachar_pedidos(n, cantidad);
+                printf("✓ %d pedidos despachados (historial en '%s'). Quedan %d en la cola.\n",
+                       despachados, ARCHIVO_HISTORIAL, n->num_pedidos);
+            }
+        }
+#ifdef ESTADISTICAS
+        // OPCION 12: Metricas internas y volcado legible por maquina
+        else if (opc == 12) {
+            estadisticas_reporte(root);
+            if (estadisticas_volcar(root, ARCHIVO_ESTADISTICAS)) {
+                printf("✓ Metricas volcadas en '%s'.\n", ARCHIVO_ESTADISTICAS);
+            } else {
+                printf("✗ No se pudo escribir '%s'.\n", ARCHIVO_ESTADISTICAS);
+            }
+        }
+#endif
         // OPCION 9: Salir del programa
         else if (opc == 9) {
             printf("\n¿Desea guardar el inventario antes de salir? (s/n): ");
@@ -1023,16 +826,21 @@ int main() {
             limpiar_buffer();
             
             if (respuesta == 's' || respuesta == 'S') {
-                if (guardar_arbol(root, ARCHIVO_DATOS)) {
+                if (checkpoint_inventario(root)) {
                     printf("✓ Inventario guardado.\n");
                 } else {
                     printf("✗ Error al guardar.\n");
                 }
             }
+            // Sin guardar, los cambios quedan en el journal y se recuperan al cargar
+            guardado_esperar();
+            journal_cerrar();
+            historial_cerrar();
             
             printf("Saliendo... liberando memoria.\n");
             // CRÍTICO: Liberar toda la memoria antes de terminar
             free_tree(root);
+            inventario_destruir();
             break;
         }
         // Opción invalida
@@ -1043,3 +851,4 @@ int main() {
     
     return 0;
 }
+
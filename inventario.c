@@ -0,0 +1,5516 @@
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+#if defined(INVENTARIO_CONCURRENTE) || ((defined(VERSIONES) || defined(CARGA_PARALELA)) && !defined(_WIN32))
+#include <pthread.h>
+#endif
+
+#include "inventario.h"
+
+/*
+ * Clave de un lote: la fecha de vencimiento ordena y, entre los lotes que
+ * vencen el mismo dia, la secuencia de llegada desempata. Juntas en un entero
+ * de 64 bits se comparan con una sola operacion.
+ */
+typedef int64_t ClaveLote;
+#define clave_lote(fecha, secuencia) (((ClaveLote)(fecha) << 32) | (uint32_t)(secuencia))
+#define clave_de(n) clave_lote((n)->fecha_vencimiento, (n)->secuencia)
+
+
+int max(int a, int b) { 
+    return (a > b) ? a : b; 
+}
+
+
+void actualizar_agregados(Node *n) {
+    // Recalcular los agregados a partir de los hijos (ya actualizados)
+    Node *l = n->left, *r = n->right;
+    n->lotes_subarbol = 1 + (l ? l->lotes_subarbol : 0) + (r ? r->lotes_subarbol : 0);
+    n->stock_subarbol = n->stock_total + (l ? l->stock_subarbol : 0) + (r ? r->stock_subarbol : 0);
+    n->pedidos_subarbol = n->num_pedidos + (l ? l->pedidos_subarbol : 0) + (r ? r->pedidos_subarbol : 0);
+    n->pendiente_subarbol = n->cantidad_pendiente + (l ? l->pendiente_subarbol : 0) + (r ? r->pendiente_subarbol : 0);
+}
+
+
+#ifdef INVENTARIO_CONCURRENTE
+// Lotes distintos comparten ancestros, y varias terminales el mismo lote:
+// contadores y agregados se actualizan de forma atomica
+#define SUMAR_AGREGADO(campo, d) __atomic_fetch_add(&(campo), (d), __ATOMIC_RELAXED)
+#define LEER_CONTADOR(campo) __atomic_load_n(&(campo), __ATOMIC_RELAXED)
+#else
+#define SUMAR_AGREGADO(campo, d) ((campo) += (d))
+#define LEER_CONTADOR(campo) (campo)
+#endif
+
+
+void propagar_agregados(Node *n, long long d_stock, long d_pedidos, long long d_pendiente) {
+    // Un cambio en el propio lote afecta a los agregados de todos sus ancestros
+    for (; n; n = n->parent) {
+        SUMAR_AGREGADO(n->stock_subarbol, d_stock);
+        SUMAR_AGREGADO(n->pedidos_subarbol, d_pedidos);
+        SUMAR_AGREGADO(n->pendiente_subarbol, d_pendiente);
+    }
+}
+
+
+#ifdef INVENTARIO_CONCURRENTE
+/*
+ * Capa de concurrencia (compilar con -DINVENTARIO_CONCURRENTE -pthread)
+ *
+ * - Bloqueo lector/escritor del inventario: los cambios de estructura
+ *   (insertar, eliminar, purgar, cargar, checkpoint) lo toman en escritura;
+ *   pedidos, cancelaciones, busquedas y reportes lo toman en lectura y
+ *   corren a la vez desde varias terminales.
+ * - Bloqueos por lote: protegen la cola de pedidos, el stock y los
+ *   contadores del propio lote. Se reparten en LOTES_BLOQUEOS franjas segun
+ *   la direccion del Node, para no agregar un mutex a cada nodo.
+ * - Un mutex de pedidos protege el pool de pedidos, el indice por ID y el
+ *   proximo ID; otro serializa el buffer del journal.
+ * Orden de adquisicion: inventario -> lote -> pedidos -> journal. El mutex de
+ * la tabla de cadenas se toma siempre ultimo y sin tomar otro mientras tanto.
+ */
+#define LOTES_BLOQUEOS 64             // Franjas de bloqueos por lote
+
+pthread_rwlock_t bloqueo_inventario = PTHREAD_RWLOCK_INITIALIZER;
+pthread_mutex_t bloqueo_pedidos = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t bloqueo_journal = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t bloqueo_cadenas = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t bloqueos_lotes[LOTES_BLOQUEOS];
+pthread_once_t bloqueos_lotes_iniciados = PTHREAD_ONCE_INIT;
+
+
+void iniciar_bloqueos_lotes(void) {
+    for (int i = 0; i < LOTES_BLOQUEOS; i++) pthread_mutex_init(&bloqueos_lotes[i], NULL);
+}
+
+
+void inventario_leer(void) {
+    pthread_once(&bloqueos_lotes_iniciados, iniciar_bloqueos_lotes);
+    pthread_rwlock_rdlock(&bloqueo_inventario);
+}
+
+
+void inventario_escribir(void) {
+    pthread_once(&bloqueos_lotes_iniciados, iniciar_bloqueos_lotes);
+    pthread_rwlock_wrlock(&bloqueo_inventario);
+}
+
+
+void inventario_soltar(void) {
+    pthread_rwlock_unlock(&bloqueo_inventario);
+}
+
+
+pthread_mutex_t* bloqueo_de_lote(Node *n) {
+    return &bloqueos_lotes[((uintptr_t)n / sizeof(Node)) % LOTES_BLOQUEOS];
+}
+
+
+void bloquear_lote(Node *n) {
+    pthread_mutex_lock(bloqueo_de_lote(n));
+}
+
+
+void desbloquear_lote(Node *n) {
+    pthread_mutex_unlock(bloqueo_de_lote(n));
+}
+
+#define bloquear_pedidos() pthread_mutex_lock(&bloqueo_pedidos)
+#define desbloquear_pedidos() pthread_mutex_unlock(&bloqueo_pedidos)
+#define bloquear_journal() pthread_mutex_lock(&bloqueo_journal)
+#define desbloquear_journal() pthread_mutex_unlock(&bloqueo_journal)
+#define bloquear_cadenas() pthread_mutex_lock(&bloqueo_cadenas)
+#define desbloquear_cadenas() pthread_mutex_unlock(&bloqueo_cadenas)
+#else
+// Un solo hilo (menu interactivo): los bloqueos no hacen nada
+#define bloquear_lote(n) ((void)0)
+#define desbloquear_lote(n) ((void)0)
+#define bloquear_pedidos() ((void)0)
+#define desbloquear_pedidos() ((void)0)
+#define bloquear_journal() ((void)0)
+#define desbloquear_journal() ((void)0)
+#define bloquear_cadenas() ((void)0)
+#define desbloquear_cadenas() ((void)0)
+#endif
+
+
+#ifdef ESTADISTICAS
+/**
+ * Metricas internas (compilar con -DESTADISTICAS)
+ *
+ * Contadores baratos en el camino caliente: rotaciones y reservas de memoria
+ * por tipo de operacion, histograma de profundidad de las busquedas, cola mas
+ * larga observada y duracion y bytes de guardados, cargas y fsync del journal.
+ * Las longitudes de cola por lote se calculan al pedir el reporte recorriendo
+ * el arbol. Con el indice B+ activo las busquedas no descienden el AVL y no
+ * entran en el histograma. Los contadores se suman con atomicos relajados para
+ * que la version concurrente no pierda incrementos; no se toma ningun bloqueo.
+ */
+#define ESTAD_PROFUNDIDADES 64            // Casilleros del histograma de profundidad
+#define ESTAD_COLAS 32                    // Casilleros (potencias de 2) de longitud de cola
+
+typedef enum {
+    ESTAD_OTRA,                           // Fuera de una operacion instrumentada
+    ESTAD_INSERCION,                      // insertAVL
+    ESTAD_ELIMINACION,                    // deleteNode
+    ESTAD_PEDIDO,                         // enqueue_order y pedidos del journal
+    ESTAD_CANCELACION,                    // Cancelacion de un pedido
+    ESTAD_MASIVA,                         // insertar_lotes_masivo
+    ESTAD_CARGA,                          // cargar_arbol
+    ESTAD_DESPACHO,                       // Despacho desde la cabeza de la cola
+    ESTAD_OPERACIONES
+} EstadOperacion;
+
+const char *estad_nombres[ESTAD_OPERACIONES] = {
+    "otra", "insercion", "eliminacion", "pedido", "cancelacion", "masiva", "carga", "despacho"
+};
+
+/**
+ * Estructura EstadPersistencia: Duracion y volumen de una clase de escritura o lectura
+ */
+typedef struct EstadPersistencia {
+    unsigned long long cantidad;      // Operaciones completadas
+    unsigned long long ns_total;      // Nanosegundos acumulados
+    unsigned long long ns_max;        // Operacion mas lenta
+    unsigned long long bytes;         // Bytes escritos o leidos
+} EstadPersistencia;
+
+/**
+ * Estructura Estadisticas: Contadores acumulados desde el inicio del proceso
+ */
+typedef struct Estadisticas {
+    unsigned long long operaciones[ESTAD_OPERACIONES];  // Operaciones por tipo
+    unsigned long long rotaciones[ESTAD_OPERACIONES];   // Rotaciones AVL por tipo
+    unsigned long long reservas[ESTAD_OPERACIONES];     // Elementos tomados de los pools
+    unsigned long long bloques;       // Bloques pedidos al sistema (malloc) por los pools
+    unsigned long long busquedas;     // Descensos de searchNode por el AVL
+    unsigned long long fallidas;      // Busquedas sin lote con esa fecha
+    unsigned long long profundidad[ESTAD_PROFUNDIDADES];  // Nodos visitados por busqueda
+    int cola_maxima;                  // Pedidos en la cola mas larga vista al encolar
+    EstadPersistencia guardados;      // Instantaneas escritas (incluye segundo plano)
+    EstadPersistencia cargas;         // Instantaneas leidas
+    EstadPersistencia journal;        // Grupos del journal escritos con fsync
+} Estadisticas;
+
+Estadisticas estadisticas;
+__thread EstadOperacion estad_actual = ESTAD_OTRA;  // Operacion en curso en este hilo
+
+
+uint64_t estad_reloj(void) {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+
+void estad_persistencia(EstadPersistencia *e, uint64_t inicio, size_t bytes) {
+    unsigned long long ns = estad_reloj() - inicio;
+    __atomic_fetch_add(&e->cantidad, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&e->ns_total, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&e->bytes, (unsigned long long)bytes, __ATOMIC_RELAXED);
+    unsigned long long max = __atomic_load_n(&e->ns_max, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&e->ns_max, &max, ns, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+
+void estad_busqueda(int profundidad, bool hallado) {
+    if (profundidad >= ESTAD_PROFUNDIDADES) profundidad = ESTAD_PROFUNDIDADES - 1;
+    __atomic_fetch_add(&estadisticas.busquedas, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&estadisticas.profundidad[profundidad], 1, __ATOMIC_RELAXED);
+    if (!hallado) __atomic_fetch_add(&estadisticas.fallidas, 1, __ATOMIC_RELAXED);
+}
+
+
+void estad_cola(int longitud) {
+    int max = __atomic_load_n(&estadisticas.cola_maxima, __ATOMIC_RELAXED);
+    while (longitud > max && !__atomic_compare_exchange_n(&estadisticas.cola_maxima, &max, longitud, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+#define ESTAD_SUMAR(campo) __atomic_fetch_add(&estadisticas.campo, 1, __ATOMIC_RELAXED)
+// Inicio de una operacion: las rotaciones y reservas siguientes se le atribuyen
+#define estad_operacion(op) (estad_actual = (op), (void)ESTAD_SUMAR(operaciones[op]))
+#define estad_rotacion() ((void)ESTAD_SUMAR(rotaciones[estad_actual]))
+#define estad_reserva() ((void)ESTAD_SUMAR(reservas[estad_actual]))
+#define estad_bloque() ((void)ESTAD_SUMAR(bloques))
+#define estad_guardado(inicio, bytes) estad_persistencia(&estadisticas.guardados, (inicio), (bytes))
+#define estad_carga(inicio, bytes) estad_persistencia(&estadisticas.cargas, (inicio), (bytes))
+#define estad_journal(inicio, bytes) estad_persistencia(&estadisticas.journal, (inicio), (bytes))
+#else
+// Sin metricas los ganchos no hacen nada y no se lee el reloj
+#define estad_reloj() ((uint64_t)0)
+#define estad_operacion(op) ((void)0)
+#define estad_rotacion() ((void)0)
+#define estad_reserva() ((void)0)
+#define estad_bloque() ((void)0)
+#define estad_busqueda(profundidad, hallado) ((void)(profundidad), (void)(hallado))
+#define estad_cola(longitud) ((void)0)
+#define estad_guardado(inicio, bytes) ((void)(inicio))
+#define estad_carga(inicio, bytes) ((void)(inicio))
+#define estad_journal(inicio, bytes) ((void)(inicio))
+#endif
+
+
+// Nucleo AVL generico instanciado para los lotes: clave (fecha, secuencia),
+// punteros al padre y agregados del subarbol. Genera lote_rotar_derecha,
+// lote_balancear, lote_rebalancear_hacia_arriba, lote_siguiente, ...
+#define AVL_TIPO Node
+#define AVL_PREFIJO lote
+#define AVL_CLAVE ClaveLote
+#define AVL_COMPARAR(c, n) (((c) > clave_de(n)) - ((c) < clave_de(n)))
+#define AVL_IZQ left
+#define AVL_DER right
+#define AVL_ALTURA height
+#define AVL_PADRE parent
+#define AVL_ACTUALIZAR(n) actualizar_agregados(n)
+#define AVL_AL_ROTAR() estad_rotacion()
+#include "avl_nucleo.h"
+
+
+/**
+ * Estructura PoolBloque: Bloque contiguo de elementos reservado de una sola vez
+ */
+typedef struct PoolBloque {
+    struct PoolBloque *siguiente;     // Siguiente bloque reservado por el pool
+    max_align_t datos[];              // Elementos del bloque (alineados)
+} PoolBloque;
+
+/**
+ * Estructura Pool: Asignador por tipo (slab) con lista libre propia
+ */
+typedef struct Pool {
+    size_t tam_elemento;              // Tamano de cada elemento
+    size_t por_bloque;                // Elementos por bloque
+    PoolBloque *bloques;              // Todos los bloques reservados
+    PoolBloque *actual;               // Bloque del que se estan tallando elementos
+    size_t usados;                    // Elementos tallados del bloque actual
+    void *libres;                     // Lista libre de elementos devueltos
+#ifdef VERIFICAR
+    long vivos;                       // Elementos entregados y no devueltos
+    unsigned long long reservas;      // Elementos entregados desde el inicio
+#endif
+} Pool;
+
+#define POOL_NODOS_POR_BLOQUE 256     // Lotes por bloque del pool de nodos
+#define POOL_PEDIDOS_POR_BLOQUE 1024  // Pedidos por bloque del pool de pedidos
+
+#ifdef VERIFICAR
+// Conteo de elementos vivos y reservas por pool, para detectar fugas y
+// reservas de mas en las pruebas aleatorias (verificar_inventario)
+#define POOL_CONTADORES , 0, 0
+#define pool_contar_reserva(pool) ((pool)->vivos++, (pool)->reservas++)
+#define pool_contar_liberacion(pool) ((pool)->vivos--)
+#define pool_contar_reinicio(pool) ((pool)->vivos = 0)
+#else
+#define POOL_CONTADORES
+#define pool_contar_reserva(pool) ((void)0)
+#define pool_contar_liberacion(pool) ((void)0)
+#define pool_contar_reinicio(pool) ((void)0)
+#endif
+
+#define POOL_INICIALIZADOR(tipo, n) { sizeof(tipo) < sizeof(void*) ? sizeof(void*) : sizeof(tipo), n, NULL, NULL, 0, NULL POOL_CONTADORES }
+
+Pool pool_nodos = POOL_INICIALIZADOR(Node, POOL_NODOS_POR_BLOQUE);
+Pool pool_pedidos = POOL_INICIALIZADOR(Order, POOL_PEDIDOS_POR_BLOQUE);
+
+
+void* pool_reservar(Pool *pool) {
+    // Reutilizar primero un elemento de la lista libre
+    if (pool->libres) {
+        void *e = pool->libres;
+        pool->libres = *(void**)e;
+        estad_reserva();
+        pool_contar_reserva(pool);
+        return e;
+    }
+
+    // Bloque actual agotado: pasar al siguiente ya reservado o pedir uno nuevo
+    if (!pool->actual || pool->usados == pool->por_bloque) {
+        if (pool->actual && pool->actual->siguiente) {
+            pool->actual = pool->actual->siguiente;
+        } else {
+            PoolBloque *b = (PoolBloque*)malloc(sizeof(PoolBloque) + pool->tam_elemento * pool->por_bloque);
+            if (!b) return NULL;
+            estad_bloque();
+            b->siguiente = NULL;
+            if (pool->actual) pool->actual->siguiente = b;
+            else pool->bloques = b;
+            pool->actual = b;
+        }
+        pool->usados = 0;
+    }
+
+    // Tallar el siguiente elemento del bloque actual
+    estad_reserva();
+    pool_contar_reserva(pool);
+    return (char*)pool->actual->datos + pool->tam_elemento * pool->usados++;
+}
+
+
+void pool_liberar(Pool *pool, void *e) {
+    if (!e) return;
+    // Devolver el elemento a la lista libre (el enlace se guarda en el propio elemento)
+    *(void**)e = pool->libres;
+    pool->libres = e;
+    pool_contar_liberacion(pool);
+}
+
+
+void pool_reiniciar(Pool *pool) {
+    // Liberacion masiva: todos los elementos quedan disponibles sin recorrerlos.
+    // Los bloques se conservan para reutilizarse en la siguiente carga.
+    pool->actual = pool->bloques;
+    pool->usados = 0;
+    pool->libres = NULL;
+    pool_contar_reinicio(pool);
+}
+
+
+void pool_destruir(Pool *pool) {
+    // Devolver todos los bloques al sistema
+    PoolBloque *b = pool->bloques;
+    while (b) {
+        PoolBloque *tmp = b;
+        b = b->siguiente;
+        free(tmp);
+    }
+    pool->bloques = pool->actual = NULL;
+    pool->usados = 0;
+    pool->libres = NULL;
+    pool_contar_reinicio(pool);
+}
+
+
+bool pool_preparar(Pool *pool, size_t n) {
+    // Dejar reservados de antemano los bloques para tallar n elementos mas,
+    // asi una tanda de pedidos no llama a malloc por cada bloque que agota
+    size_t disponibles = pool->actual ? pool->por_bloque - pool->usados : 0;
+    PoolBloque *ultimo = pool->actual;
+    for (PoolBloque *b = ultimo ? ultimo->siguiente : NULL; b; b = b->siguiente) {
+        disponibles += pool->por_bloque;
+        ultimo = b;
+    }
+    while (disponibles < n) {
+        PoolBloque *b = (PoolBloque*)malloc(sizeof(PoolBloque) + pool->tam_elemento * pool->por_bloque);
+        if (!b) return false;
+        estad_bloque();
+        b->siguiente = NULL;
+        if (ultimo) {
+            ultimo->siguiente = b;
+        } else {
+            // Pool sin bloques: el nuevo pasa a ser el actual
+            pool->bloques = pool->actual = b;
+            pool->usados = 0;
+        }
+        ultimo = b;
+        disponibles += pool->por_bloque;
+    }
+    return true;
+}
+
+
+#ifdef CARGA_PARALELA
+void pool_recortar(Pool *pool) {
+    // Devolver los bloques de reserva (los que siguen al actual): no guardan
+    // elementos vivos ni libres, y la carga paralela los trae en pools propios
+    if (!pool->actual) return;
+    PoolBloque *b = pool->actual->siguiente;
+    pool->actual->siguiente = NULL;
+    while (b) {
+        PoolBloque *tmp = b;
+        b = b->siguiente;
+        free(tmp);
+    }
+}
+
+
+void pool_absorber(Pool *destino, Pool *origen) {
+    // Pasar los bloques de un pool recien usado (sin reserva ni lista libre) a
+    // otro del mismo tipo. Van delante de los del destino, que los trata como
+    // ocupados; lo que quedo sin tallar en el ultimo de ellos se pierde.
+    if (!origen->bloques) return;
+    if (!destino->actual) {
+        destino->bloques = origen->bloques;
+        destino->actual = origen->actual;
+        destino->usados = origen->usados;
+    } else {
+        origen->actual->siguiente = destino->bloques;
+        destino->bloques = origen->bloques;
+    }
+#ifdef VERIFICAR
+    destino->vivos += origen->vivos;
+    destino->reservas += origen->reservas;
+#endif
+    origen->bloques = origen->actual = NULL;
+    origen->usados = 0;
+    pool_contar_reinicio(origen);
+}
+#endif
+
+
+uint32_t checksum_fnv1a(const void *datos, size_t tam) {
+    const unsigned char *p = (const unsigned char*)datos;
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tam; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+
+/*
+ * Tabla de cadenas internadas
+ *
+ * Productos y destinos se repiten mucho (unos pocos puertos y productos):
+ * cada nombre distinto se guarda una sola vez y lotes y pedidos llevan su ID
+ * de 32 bits. Comparar nombres es comparar IDs, y la instantanea escribe cada
+ * nombre una vez. Los textos no se mueven ni se liberan hasta salir, asi que
+ * un ID sigue valiendo entre cargas del inventario. El ID 0 es la cadena vacia.
+ */
+#define CADENAS_BLOQUE 4096            // Bytes por bloque del arena de textos
+#define CADENAS_POR_SEGMENTO 1024      // IDs por segmento del directorio
+#define CADENAS_SEGMENTOS 1024         // Segmentos como maximo (~1M nombres distintos)
+#define CADENAS_CAPACIDAD_INICIAL 256  // Ranuras iniciales de la tabla hash
+
+/**
+ * Estructura RanuraCadena: Entrada de la tabla hash de cadenas
+ */
+typedef struct RanuraCadena {
+    uint32_t id;                      // ID de la cadena (0 = ranura libre)
+    uint32_t hash;                    // Hash del texto, para no recalcularlo al crecer
+} RanuraCadena;
+
+/**
+ * Estructura TablaCadenas: Textos por ID y su indice hash
+ */
+typedef struct TablaCadenas {
+    const char **segmentos[CADENAS_SEGMENTOS];  // ID -> texto; los segmentos no se mueven
+    uint32_t cantidad;                // IDs asignados, incluido el 0
+    RanuraCadena *ranuras;            // Hash abierto con sondeo lineal
+    size_t capacidad;                 // Ranuras (potencia de 2)
+    PoolBloque *bloques;              // Arena de textos (el primero es el actual)
+    size_t usados;                    // Bytes ocupados del bloque actual
+} TablaCadenas;
+
+TablaCadenas cadenas;
+
+
+const char* cadena_texto(uint32_t id) {
+    if (id == 0) return "";
+    return cadenas.segmentos[id / CADENAS_POR_SEGMENTO][id % CADENAS_POR_SEGMENTO];
+}
+
+
+RanuraCadena* cadena_ranura(const char *s, size_t largo, uint32_t hash) {
+    // Ranura con el ID de s, o la libre donde iria
+    size_t i = hash & (cadenas.capacidad - 1);
+    while (cadenas.ranuras[i].id) {
+        RanuraCadena *r = &cadenas.ranuras[i];
+        if (r->hash == hash) {
+            const char *t = cadena_texto(r->id);
+            if (strncmp(t, s, largo) == 0 && t[largo] == '\0') return r;
+        }
+        i = (i + 1) & (cadenas.capacidad - 1);
+    }
+    return &cadenas.ranuras[i];
+}
+
+
+bool cadenas_crecer(void) {
+    size_t capacidad = cadenas.capacidad ? cadenas.capacidad * 2 : CADENAS_CAPACIDAD_INICIAL;
+    RanuraCadena *ranuras = (RanuraCadena*)calloc(capacidad, sizeof(RanuraCadena));
+    if (!ranuras) return false;
+    
+    // Reubicar las entradas existentes con el hash guardado
+    for (size_t i = 0; i < cadenas.capacidad; i++) {
+        RanuraCadena r = cadenas.ranuras[i];
+        if (!r.id) continue;
+        size_t j = r.hash & (capacidad - 1);
+        while (ranuras[j].id) j = (j + 1) & (capacidad - 1);
+        ranuras[j] = r;
+    }
+    free(cadenas.ranuras);
+    cadenas.ranuras = ranuras;
+    cadenas.capacidad = capacidad;
+    return true;
+}
+
+
+uint32_t cadena_agregar(const char *s, size_t largo, uint32_t hash) {
+    // Reservar el ID, copiar el texto al arena e indexarlo. 0 si no hay memoria
+    uint32_t id = cadenas.cantidad;
+    size_t seg = id / CADENAS_POR_SEGMENTO;
+    if (seg >= CADENAS_SEGMENTOS) return 0;
+    if (!cadenas.segmentos[seg]) {
+        cadenas.segmentos[seg] = (const char**)calloc(CADENAS_POR_SEGMENTO, sizeof(const char*));
+        if (!cadenas.segmentos[seg]) return 0;
+    }
+    if (!cadenas.bloques || cadenas.usados + largo + 1 > CADENAS_BLOQUE) {
+        PoolBloque *b = (PoolBloque*)malloc(sizeof(PoolBloque) + CADENAS_BLOQUE);
+        if (!b) return 0;
+        b->siguiente = cadenas.bloques;
+        cadenas.bloques = b;
+        cadenas.usados = 0;
+    }
+    char *texto = (char*)cadenas.bloques->datos + cadenas.usados;
+    memcpy(texto, s, largo);
+    texto[largo] = '\0';
+    cadenas.usados += largo + 1;
+    
+    cadenas.segmentos[seg][id % CADENAS_POR_SEGMENTO] = texto;
+    RanuraCadena *r = cadena_ranura(s, largo, hash);
+    r->id = id;
+    r->hash = hash;
+    cadenas.cantidad++;
+    return id;
+}
+
+
+uint32_t cadena_internar(const char *s) {
+    // ID de s, agregandola si es nueva (0 para la cadena vacia o sin memoria).
+    // Se recorta igual que los buffers de nombre de largo fijo
+    size_t largo = strnlen(s, MAX_NAME - 1);
+    if (largo == 0) return 0;
+    uint32_t hash = checksum_fnv1a(s, largo);
+    
+    bloquear_cadenas();
+    uint32_t id = 0;
+    if (cadenas.cantidad == 0) cadenas.cantidad = 1;  // El ID 0 queda para la cadena vacia
+    if (2 * (size_t)cadenas.cantidad < cadenas.capacidad || cadenas_crecer()) {
+        RanuraCadena *r = cadena_ranura(s, largo, hash);
+        id = r->id ? r->id : cadena_agregar(s, largo, hash);
+    }
+    desbloquear_cadenas();
+    if (!id) fprintf(stderr, "Error: No se pudo asignar memoria para el nombre.\n");
+    return id;
+}
+
+
+uint32_t cadena_buscar(const char *s) {
+    // ID de s si ya fue internada, o 0 (ningun lote ni pedido la usa)
+    size_t largo = strnlen(s, MAX_NAME - 1);
+    if (largo == 0) return 0;
+    uint32_t hash = checksum_fnv1a(s, largo);
+    bloquear_cadenas();
+    uint32_t id = cadenas.capacidad ? cadena_ranura(s, largo, hash)->id : 0;
+    desbloquear_cadenas();
+    return id;
+}
+
+
+uint32_t cadenas_cantidad(void) {
+    // Cota de los IDs en uso (para tablas indexadas por ID)
+    bloquear_cadenas();
+    uint32_t n = cadenas.cantidad ? cadenas.cantidad : 1;
+    desbloquear_cadenas();
+    return n;
+}
+
+
+void cadenas_destruir(void) {
+    PoolBloque *b = cadenas.bloques;
+    while (b) {
+        PoolBloque *tmp = b;
+        b = b->siguiente;
+        free(tmp);
+    }
+    for (size_t i = 0; i < CADENAS_SEGMENTOS; i++) free((void*)cadenas.segmentos[i]);
+    free(cadenas.ranuras);
+    memset(&cadenas, 0, sizeof(cadenas));
+}
+
+
+#ifdef VERSIONES
+#ifdef INVENTARIO_CONCURRENTE
+#error "VERSIONES asume un solo hilo que modifica el inventario; no se combina con INVENTARIO_CONCURRENTE"
+#endif
+/*
+ * Versiones persistentes del inventario (compilar con -DVERSIONES -pthread)
+ *
+ * Espejo del AVL por fecha con copia de camino: tomar una version es sumar
+ * una referencia a su raiz, y desde ese momento cada cambio de un lote copia
+ * solo los O(log n) nodos compartidos del camino desde la raiz; el resto se
+ * comparte con la version tomada. Mientras nadie tiene una version tomada los
+ * cambios se hacen en el lugar, sin copias.
+ *
+ * El AVL de Node sigue siendo el inventario vivo (punteros al padre, colas
+ * doblemente enlazadas, indice por ID), que no admite compartir nodos; las
+ * versiones guardan solo la imagen de cada lote que necesita la instantanea.
+ * Los pedidos de un lote forman una lista persistente del mas nuevo al mas
+ * viejo, asi que encolar comparte la cola anterior completa.
+ *
+ * Solo el hilo principal crea, copia y suelta nodos de version; el hilo de
+ * guardado solo lee la raiz que recibio, por eso las referencias no son atomicas.
+ */
+#define POOL_VERSIONES_POR_BLOQUE 256  // Nodos de version por bloque del pool
+
+/**
+ * Estructura VersionPedido: Pedido inmutable de una version (lista persistente)
+ */
+typedef struct VersionPedido {
+    uint32_t id;                      // ID del pedido
+    int cantidad_solicitada;          // Cantidad del pedido
+    uint32_t destino;                 // ID del destino (tabla de cadenas)
+    struct VersionPedido *anterior;   // Pedido encolado antes (NULL en el primero)
+    int refs;                         // Pedidos y lotes que apuntan a este
+} VersionPedido;
+
+/**
+ * Estructura VersionLote: Imagen de un lote en el AVL persistente
+ */
+typedef struct VersionLote {
+    int fecha_vencimiento;            // Clave del lote (AAAAMMDD)
+    uint32_t secuencia;               // Desempate entre lotes de la misma fecha
+    uint32_t producto;                // ID del producto (tabla de cadenas)
+    int stock_total;                  // Stock disponible
+    int num_pedidos;                  // Largo de la lista de pedidos
+    VersionPedido *ultimo_pedido;     // Pedido mas nuevo de la cola
+    struct VersionLote *left, *right; // Hijos (posiblemente compartidos con otras versiones)
+    int height;                       // Altura para balanceo AVL
+    int refs;                         // Versiones y padres que comparten este nodo
+} VersionLote;
+
+Pool pool_versiones = POOL_INICIALIZADOR(VersionLote, POOL_VERSIONES_POR_BLOQUE);
+Pool pool_versiones_pedidos = POOL_INICIALIZADOR(VersionPedido, POOL_PEDIDOS_POR_BLOQUE);
+VersionLote *version_actual = NULL;   // Imagen del inventario vivo
+bool version_valida = true;           // false si una falta de memoria la dejo incompleta
+int version_pausa = 0;                // > 0: los ganchos no hacen nada (cargas de instantaneas)
+int versiones_tomadas = 0;            // Versiones entregadas y aun no devueltas
+
+
+int version_altura(VersionLote *v) {
+    return v ? v->height : 0;
+}
+
+
+void version_actualizar(VersionLote *v) {
+    v->height = 1 + max(version_altura(v->left), version_altura(v->right));
+}
+
+
+VersionLote* version_retener(VersionLote *v) {
+    if (v) v->refs++;
+    return v;
+}
+
+
+void version_soltar_pedidos(VersionPedido *p) {
+    // Soltar la lista hasta el primer pedido que otra version sigue usando
+    while (p && --p->refs == 0) {
+        VersionPedido *anterior = p->anterior;
+        pool_liberar(&pool_versiones_pedidos, p);
+        p = anterior;
+    }
+}
+
+
+void version_soltar(VersionLote *v) {
+    // Solo se baja a los hijos de nodos que quedan sin referencias: la
+    // recursion recorre la parte exclusiva de la version, de altura O(log n)
+    if (!v || --v->refs > 0) return;
+    version_soltar(v->left);
+    version_soltar(v->right);
+    version_soltar_pedidos(v->ultimo_pedido);
+    pool_liberar(&pool_versiones, v);
+}
+
+
+VersionLote* version_nuevo(const Node *n) {
+    VersionLote *v = (VersionLote*)pool_reservar(&pool_versiones);
+    if (!v) {
+        version_valida = false;
+        return NULL;
+    }
+    v->fecha_vencimiento = n->fecha_vencimiento;
+    v->secuencia = n->secuencia;
+    v->producto = n->producto;
+    v->stock_total = n->stock_total;
+    v->num_pedidos = 0;
+    v->ultimo_pedido = NULL;
+    v->left = v->right = NULL;
+    v->height = 1;
+    v->refs = 1;
+    return v;
+}
+
+
+VersionLote* version_propio(VersionLote *v) {
+    // Consume una referencia a v y devuelve un nodo que solo usa el llamador:
+    // el mismo si nadie mas lo comparte, o una copia que comparte sus hijos
+    if (!v || v->refs == 1) return v;
+    VersionLote *c = (VersionLote*)pool_reservar(&pool_versiones);
+    v->refs--;  // Sigue vivo: otra version lo usa
+    if (!c) {
+        version_valida = false;
+        return NULL;
+    }
+    *c = *v;
+    c->refs = 1;
+    version_retener(c->left);
+    version_retener(c->right);
+    if (c->ultimo_pedido) c->ultimo_pedido->refs++;
+    return c;
+}
+
+
+VersionLote* version_rotar_derecha(VersionLote *y) {
+    // y ya es propio; x sube, asi que tambien debe serlo
+    VersionLote *x = y->left = version_propio(y->left);
+    if (!x) return y;
+    y->left = x->right;
+    x->right = y;
+    version_actualizar(y);
+    version_actualizar(x);
+    return x;
+}
+
+
+VersionLote* version_rotar_izquierda(VersionLote *x) {
+    VersionLote *y = x->right = version_propio(x->right);
+    if (!y) return x;
+    x->right = y->left;
+    y->left = x;
+    version_actualizar(x);
+    version_actualizar(y);
+    return y;
+}
+
+
+VersionLote* version_balancear(VersionLote *v) {
+    // Mismos casos que rebalancear_nodo, sobre un nodo propio
+    version_actualizar(v);
+    int balance = version_altura(v->left) - version_altura(v->right);
+    if (balance > 1) {
+        VersionLote *l = v->left;
+        if (version_altura(l->left) < version_altura(l->right)) {
+            v->left = version_rotar_izquierda(version_propio(l));
+        }
+        return version_rotar_derecha(v);
+    }
+    if (balance < -1) {
+        VersionLote *r = v->right;
+        if (version_altura(r->left) > version_altura(r->right)) {
+            v->right = version_rotar_derecha(version_propio(r));
+        }
+        return version_rotar_izquierda(v);
+    }
+    return v;
+}
+
+
+VersionLote* version_insertar_en(VersionLote *t, const Node *n) {
+    // Consume la referencia a t y devuelve la raiz del subarbol con el lote agregado
+    if (!t) return version_nuevo(n);
+    t = version_propio(t);
+    if (!t) return NULL;
+    ClaveLote clave = clave_de(n);
+    if (clave < clave_de(t)) t->left = version_insertar_en(t->left, n);
+    else if (clave > clave_de(t)) t->right = version_insertar_en(t->right, n);
+    return version_balancear(t);
+}
+
+
+VersionLote* version_eliminar_en(VersionLote *t, ClaveLote clave) {
+    // Consume la referencia a t y devuelve la raiz del subarbol sin el lote
+    if (!t) return NULL;
+    if (clave == clave_de(t) && (!t->left || !t->right)) {
+        // Cero o un hijo: el hijo ocupa su lugar
+        VersionLote *hijo = version_retener(t->left ? t->left : t->right);
+        version_soltar(t);
+        return hijo;
+    }
+    t = version_propio(t);
+    if (!t) return NULL;
+    if (clave < clave_de(t)) {
+        t->left = version_eliminar_en(t->left, clave);
+    } else if (clave > clave_de(t)) {
+        t->right = version_eliminar_en(t->right, clave);
+    } else {
+        // Dos hijos: tomar la imagen del sucesor y eliminarlo del subarbol derecho
+        VersionLote *s = t->right;
+        while (s->left) s = s->left;
+        if (s->ultimo_pedido) s->ultimo_pedido->refs++;
+        version_soltar_pedidos(t->ultimo_pedido);
+        t->fecha_vencimiento = s->fecha_vencimiento;
+        t->secuencia = s->secuencia;
+        t->producto = s->producto;
+        t->stock_total = s->stock_total;
+        t->num_pedidos = s->num_pedidos;
+        t->ultimo_pedido = s->ultimo_pedido;
+        t->right = version_eliminar_en(t->right, clave_de(t));
+    }
+    return version_balancear(t);
+}
+
+
+VersionLote* version_lote_propio(const Node *n) {
+    // Copia el camino compartido hasta el lote y lo devuelve listo para modificar
+    ClaveLote clave = clave_de(n);
+    VersionLote **enlace = &version_actual;
+    while (*enlace) {
+        VersionLote *v = *enlace = version_propio(*enlace);
+        if (!v) break;
+        if (clave == clave_de(v)) return v;
+        enlace = (clave < clave_de(v)) ? &v->left : &v->right;
+    }
+    return NULL;
+}
+
+
+bool version_activa(void) {
+    return version_pausa == 0 && version_valida;
+}
+
+
+void version_comprobar(void) {
+    // Sin memoria para la copia: abandonar la imagen (el guardado sera sincrono)
+    if (version_valida) return;
+    version_soltar(version_actual);
+    version_actual = NULL;
+}
+
+
+void version_insertar(Node *n) {
+    if (!version_activa()) return;
+    version_actual = version_insertar_en(version_actual, n);
+    version_comprobar();
+}
+
+
+void version_eliminar(const Node *n) {
+    if (!version_activa()) return;
+    version_actual = version_eliminar_en(version_actual, clave_de(n));
+    version_comprobar();
+}
+
+
+void version_actualizar_stock(Node *n) {
+    if (!version_activa()) return;
+    VersionLote *v = version_lote_propio(n);
+    if (v) v->stock_total = n->stock_total;
+    version_comprobar();
+}
+
+
+VersionPedido* version_pedido_nuevo(const Order *o, VersionPedido *anterior) {
+    // El nuevo pedido se queda con la referencia a anterior que tenia el llamador
+    VersionPedido *p = (VersionPedido*)pool_reservar(&pool_versiones_pedidos);
+    if (!p) {
+        version_valida = false;
+        return NULL;
+    }
+    p->id = o->id;
+    p->cantidad_solicitada = o->cantidad_solicitada;
+    p->destino = o->destino;
+    p->anterior = anterior;
+    p->refs = 1;
+    return p;
+}
+
+
+void version_encolar(Node *n, const Order *o) {
+    if (!version_activa()) return;
+    VersionLote *v = version_lote_propio(n);
+    VersionPedido *p = v ? version_pedido_nuevo(o, v->ultimo_pedido) : NULL;
+    if (p) {
+        v->ultimo_pedido = p;
+        v->num_pedidos++;
+    }
+    version_comprobar();
+}
+
+
+void version_quitar(Node *n, uint32_t id) {
+    // Cancelacion: se copian los pedidos mas nuevos que el cancelado que esten
+    // compartidos; los anteriores a el se siguen compartiendo
+    if (!version_activa()) return;
+    VersionLote *v = version_lote_propio(n);
+    if (v) {
+        v->stock_total = n->stock_total;
+        VersionPedido **enlace = &v->ultimo_pedido;
+        while (*enlace && (*enlace)->id != id) {
+            VersionPedido *p = *enlace;
+            if (p->refs > 1) {
+                VersionPedido *c = (VersionPedido*)pool_reservar(&pool_versiones_pedidos);
+                if (!c) {
+                    version_valida = false;
+                    break;
+                }
+                *c = *p;
+                c->refs = 1;
+                if (c->anterior) c->anterior->refs++;
+                p->refs--;
+                *enlace = p = c;
+            }
+            enlace = &p->anterior;
+        }
+        VersionPedido *p = version_valida ? *enlace : NULL;
+        if (p) {
+            // Saltear el pedido: su referencia al anterior pasa al enlace
+            *enlace = p->anterior;
+            if (p->refs > 1) {
+                if (p->anterior) p->anterior->refs++;
+                p->refs--;
+            } else {
+                pool_liberar(&pool_versiones_pedidos, p);
+            }
+            v->num_pedidos--;
+        }
+    }
+    version_comprobar();
+}
+
+
+void version_rehacer_pedidos(Node *n) {
+    // Despachos y compactaciones cambian la cola por la cabeza, que es el final
+    // de la lista persistente: se rearma la lista del lote de una vez en vez
+    // de copiarla por cada pedido
+    if (!version_activa()) return;
+    VersionLote *v = version_lote_propio(n);
+    if (v) {
+        VersionPedido *lista = NULL;
+        int k = 0;
+        for (Order *o = n->cabeza_pedidos; o; o = o->siguiente, k++) {
+            VersionPedido *p = version_pedido_nuevo(o, lista);
+            if (!p) break;
+            lista = p;
+        }
+        if (version_valida) {
+            version_soltar_pedidos(v->ultimo_pedido);
+            v->ultimo_pedido = lista;
+            v->num_pedidos = k;
+        } else {
+            version_soltar_pedidos(lista);
+        }
+    }
+    version_comprobar();
+}
+
+
+VersionLote* version_tomar(void) {
+    // La raiz queda inmutable mientras se tenga la referencia
+    versiones_tomadas++;
+    return version_retener(version_actual);
+}
+
+
+void version_devolver(VersionLote *v) {
+    version_soltar(v);
+    versiones_tomadas--;
+}
+
+#define version_pausar() (version_pausa++)
+#define version_reanudar() (version_pausa--)
+#else
+// Sin versiones persistentes los ganchos no hacen nada
+#define version_insertar(n) ((void)0)
+#define version_eliminar(n) ((void)0)
+#define version_actualizar_stock(n) ((void)0)
+#define version_encolar(n, o) ((void)0)
+#define version_quitar(n, id) ((void)0)
+#define version_rehacer_pedidos(n) ((void)0)
+#define version_pausar() ((void)0)
+#define version_reanudar() ((void)0)
+#endif
+
+
+void ajustar_stock(Node *n, int delta) {
+    SUMAR_AGREGADO(n->stock_total, delta);
+    propagar_agregados(n, delta, 0, 0);
+    version_actualizar_stock(n);
+}
+
+
+bool reservar_stock(Node *n, int cantidad) {
+    // Descuenta cantidad solo si alcanza el stock del lote
+#ifdef INVENTARIO_CONCURRENTE
+    // Sin bloqueo: comparar e intercambiar hasta ganar o quedarse sin stock
+    int actual = __atomic_load_n(&n->stock_total, __ATOMIC_RELAXED);
+    do {
+        if (actual < cantidad) return false;
+    } while (!__atomic_compare_exchange_n(&n->stock_total, &actual, actual - cantidad, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    propagar_agregados(n, -cantidad, 0, 0);
+#else
+    if (n->stock_total < cantidad) return false;
+    ajustar_stock(n, -cantidad);
+#endif
+    return true;
+}
+
+
+int convertir_fecha_a_int(int dia, int mes, int anio) {
+    // Validar rango del anio
+    if (anio < MIN_YEAR || anio > MAX_YEAR) return -1;
+    
+    // Validar rango del mes
+    if (mes < 1 || mes > 12) return -1;
+    
+    // Validar rango basico del dia
+    if (dia < 1 || dia > 31) return -1;
+    
+    // Validar dias por mes (considera febrero con 29 dias para anios bisiestos)
+    int dias_mes[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (dia > dias_mes[mes - 1]) return -1;
+    
+    // Convertir a formato AAAAMMDD
+    return anio * 10000 + mes * 100 + dia;
+}
+
+
+int formatear_entero(char *dst, long long v, int minimo) {
+    // Digitos de v (con ceros a la izquierda hasta minimo); devuelve el largo
+    char tmp[24];
+    int n = 0;
+    unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    while (n < minimo) tmp[n++] = '0';
+    int largo = 0;
+    if (v < 0) dst[largo++] = '-';
+    while (n > 0) dst[largo++] = tmp[--n];
+    return largo;
+}
+
+
+int formatear_fecha_en(char *dst, int fecha, bool iso) {
+    // DD/MM/AAAA, o AAAA-MM-DD para las exportaciones; devuelve el largo
+    if (fecha < 0) return formatear_entero(dst, fecha, 0);
+    int anio = fecha / 10000, mes = (fecha / 100) % 100, dia = fecha % 100;
+    int n = 0;
+    if (iso) {
+        n += formatear_entero(dst + n, anio, 4);
+        dst[n++] = '-';
+        n += formatear_entero(dst + n, mes, 2);
+        dst[n++] = '-';
+        n += formatear_entero(dst + n, dia, 2);
+    } else {
+        n += formatear_entero(dst + n, dia, 2);
+        dst[n++] = '/';
+        n += formatear_entero(dst + n, mes, 2);
+        dst[n++] = '/';
+        n += formatear_entero(dst + n, anio, 4);
+    }
+    return n;
+}
+
+
+char* formatear_fecha(int fecha) {
+#ifdef INVENTARIO_CONCURRENTE
+    static _Thread_local char buffer[16];  // Un buffer por terminal
+#else
+    static char buffer[16];
+#endif
+    buffer[formatear_fecha_en(buffer, fecha, false)] = '\0';
+    return buffer;
+}
+
+
+bool validar_fecha(int fecha) {
+    // Extraer anio, mes y dia del formato AAAAMMDD
+    int anio = fecha / 10000;
+    int mes = (fecha / 100) % 100;
+    int dia = fecha % 100;
+    
+    // Validar rango del anio
+    if (anio < MIN_YEAR || anio > MAX_YEAR) return false;
+    
+    // Validar rango del mes
+    if (mes < 1 || mes > 12) return false;
+    
+    // Validar rango basico del dia
+    if (dia < 1 || dia > 31) return false;
+    
+    // Validacion de dias por mes (considera febrero con 29 dias para anios bisiestos)
+    int dias_mes[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (dia > dias_mes[mes - 1]) return false;
+    
+    return true;
+}
+
+
+Node* crear_nodo_en(Pool *pool, int fecha, uint32_t producto, int stock) {
+    // Asignar memoria para el nuevo nodo (la carga paralela usa pools por hilo)
+    Node *n = (Node*)pool_reservar(pool);
+    if (!n) {
+        fprintf(stderr, "Error: No se pudo asignar memoria para el nodo.\n");
+        return NULL;
+    }
+    
+    // Inicializar campos del nodo
+    n->fecha_vencimiento = fecha;
+    n->secuencia = 0;  // insertAVL y las cargas lo fijan si la fecha ya tiene lotes
+    n->producto = producto;
+    n->stock_total = stock;
+    
+    // Inicializar cola FIFO vacia
+    n->cabeza_pedidos = NULL;
+#ifdef INVENTARIO_CONCURRENTE
+    n->entrada_pedidos = NULL;
+#endif
+    
+    // Inicializar hijos y padre del arbol como NULL
+    n->left = n->right = n->parent = NULL;
+    n->producto_anterior = n->producto_siguiente = NULL;
+    n->num_pedidos = 0;
+    n->cantidad_pendiente = 0;
+    
+    // Altura inicial de un nodo hoja es 1 (y agregados del propio lote)
+    lote_actualizar(n);
+    
+    return n;
+}
+
+
+Node* newNode(int fecha, uint32_t producto, int stock) {
+    return crear_nodo_en(&pool_nodos, fecha, producto, stock);
+}
+
+
+/**
+ * Estructura IndicePedidos: Tabla hash (encadenada) de pedido por ID
+ */
+typedef struct IndicePedidos {
+    Order **buckets;                  // Cabezas de las cadenas (capacidad potencia de 2)
+    size_t capacidad;                 // Cantidad de buckets
+    size_t cantidad;                  // Pedidos indexados
+    size_t reservados;                // Lugares ya prometidos a pedidos publicados sin indexar
+} IndicePedidos;
+
+#define INDICE_CAPACIDAD_INICIAL 1024
+
+IndicePedidos indice_pedidos;
+uint32_t siguiente_id_pedido = 1;     // Proximo ID a asignar (0 indica error)
+
+
+size_t indice_bucket(uint32_t id, size_t capacidad) {
+    // Mezcla multiplicativa: IDs consecutivos quedan repartidos entre buckets
+    return (size_t)((id * 2654435761u) & (capacidad - 1));
+}
+
+
+bool indice_crecer(void) {
+    size_t capacidad = indice_pedidos.capacidad ? indice_pedidos.capacidad * 2 : INDICE_CAPACIDAD_INICIAL;
+    Order **buckets = (Order**)calloc(capacidad, sizeof(Order*));
+    if (!buckets) return false;
+    
+    // Redistribuir las cadenas existentes
+    for (size_t i = 0; i < indice_pedidos.capacidad; i++) {
+        Order *o = indice_pedidos.buckets[i];
+        while (o) {
+            Order *sig = o->siguiente_hash;
+            size_t b = indice_bucket(o->id, capacidad);
+            o->siguiente_hash = buckets[b];
+            buckets[b] = o;
+            o = sig;
+        }
+    }
+    free(indice_pedidos.buckets);
+    indice_pedidos.buckets = buckets;
+    indice_pedidos.capacidad = capacidad;
+    return true;
+}
+
+
+bool indice_insertar(Order *o) {
+    // Mantener factor de carga <= 1, sin ocupar los lugares reservados
+    if (indice_pedidos.cantidad + indice_pedidos.reservados >= indice_pedidos.capacidad && !indice_crecer()) return false;
+    size_t b = indice_bucket(o->id, indice_pedidos.capacidad);
+    o->siguiente_hash = indice_pedidos.buckets[b];
+    indice_pedidos.buckets[b] = o;
+    indice_pedidos.cantidad++;
+    return true;
+}
+
+
+void indice_quitar(Order *o) {
+    if (!indice_pedidos.capacidad) return;
+    // Se compara por puntero: un pedido que ya no esta indexado se ignora
+    Order **p = &indice_pedidos.buckets[indice_bucket(o->id, indice_pedidos.capacidad)];
+    while (*p) {
+        if (*p == o) {
+            *p = o->siguiente_hash;
+            indice_pedidos.cantidad--;
+            return;
+        }
+        p = &(*p)->siguiente_hash;
+    }
+}
+
+
+Order* buscar_pedido_por_id(uint32_t id) {
+    if (!indice_pedidos.capacidad) return NULL;
+    Order *o = indice_pedidos.buckets[indice_bucket(id, indice_pedidos.capacidad)];
+    while (o && o->id != id) o = o->siguiente_hash;
+    return o;
+}
+
+
+bool indice_reservar(size_t n) {
+    // Capacidad para n pedidos mas sin crecer en medio de una tanda
+    while (indice_pedidos.cantidad + indice_pedidos.reservados + n > indice_pedidos.capacidad) {
+        if (!indice_crecer()) return false;
+    }
+    return true;
+}
+
+
+void indice_vaciar(void) {
+    if (indice_pedidos.buckets) {
+        memset(indice_pedidos.buckets, 0, indice_pedidos.capacidad * sizeof(Order*));
+    }
+    indice_pedidos.cantidad = 0;
+}
+
+
+void indice_destruir(void) {
+    free(indice_pedidos.buckets);
+    indice_pedidos.buckets = NULL;
+    indice_pedidos.capacidad = indice_pedidos.cantidad = 0;
+}
+
+
+/*
+ * Historial de pedidos despachados y limite de pedidos por lote
+ *
+ * Los pedidos despachados desde la cabeza de la cola se agregan a un archivo
+ * de texto de solo agregado, una linea por pedido:
+ *
+ *   <id>,<fecha AAAAMMDD>,<secuencia>,<destino>,<cantidad>
+ *
+ * Con un limite por lote, encolar sobre una cola llena despacha primero al
+ * historial los pedidos mas viejos: cada cola deja residentes a lo sumo
+ * limite pedidos (limite * sizeof(Order) bytes) y la instantanea y los
+ * reportes dejan de cargar con el historial.
+ */
+FILE *historial = NULL;               // Historial abierto (NULL: los despachados no se archivan)
+bool historial_pendiente = false;     // Lineas escritas aun sin fsync
+int limite_cola = 0;                  // Pedidos residentes por lote (0: sin limite)
+
+
+bool historial_abrir(const char *ruta) {
+    if (historial) fclose(historial);
+    historial = fopen(ruta, "ab");
+    historial_pendiente = false;
+    if (!historial) {
+        fprintf(stderr, "Advertencia: No se pudo abrir el historial '%s'.\n", ruta);
+        limite_cola = 0;  // Sin historial no se puede desalojar
+        return false;
+    }
+    return true;
+}
+
+
+void historial_cerrar(void) {
+    if (!historial) return;
+    fclose(historial);
+    historial = NULL;
+    historial_pendiente = false;
+    limite_cola = 0;
+}
+
+
+bool limitar_cola_pedidos(int maximo) {
+    // Sin historial no se acota: los pedidos desalojados se perderian
+    if (maximo > 0 && !historial) return false;
+    limite_cola = maximo > 0 ? maximo : 0;
+    return true;
+}
+
+
+void historial_agregar(const Order *o) {
+    fprintf(historial, "%u,%d,%u,%s,%d\n", o->id, o->lote->fecha_vencimiento, o->lote->secuencia,
+            cadena_texto(o->destino), o->cantidad_solicitada);
+    __atomic_store_n(&historial_pendiente, true, __ATOMIC_RELAXED);
+}
+
+
+void limite_desalojar(Node *node, int entrantes) {
+    // Despacha los pedidos mas viejos que dejarian la cola por encima del
+    // limite al sumarle entrantes
+    if (limite_cola <= 0) return;
+    int exceso = LEER_CONTADOR(node->num_pedidos) + entrantes - limite_cola;
+    if (exceso > 0) despachar_pedidos(node, exceso);
+}
+
+
+void cola_agregar(Node *node, Order *o) {
+    // La cola no guarda puntero al final: el anterior de la cabeza es el
+    // ultimo pedido, asi que agregar sigue siendo O(1)
+    Order *cabeza = node->cabeza_pedidos;
+    o->siguiente = NULL;
+    if (!cabeza) {
+        // Cola vacia: el nuevo pedido es tanto cabeza como ultimo
+        o->anterior = o;
+        node->cabeza_pedidos = o;
+    } else {
+        o->anterior = cabeza->anterior;
+        cabeza->anterior->siguiente = o;
+        cabeza->anterior = o;
+    }
+}
+
+
+uint32_t encolar_pedido(Node *node, uint32_t destino, int cantidad, uint32_t id) {
+    // id 0: asignar el proximo ID libre. La cola del lote la protege el llamador
+    if (!node) return 0;
+    
+    // Crear nuevo pedido
+    bloquear_pedidos();
+    Order *o = (Order*)pool_reservar(&pool_pedidos);
+    if (!o) {
+        desbloquear_pedidos();
+        fprintf(stderr, "Error: No se pudo asignar memoria para el pedido.\n");
+        return 0;
+    }
+    
+    // Inicializar datos del pedido
+    if (id == 0) id = siguiente_id_pedido;
+    o->destino = destino;
+    o->cantidad_solicitada = cantidad;
+    o->id = id;
+    o->lote = node;
+    if (!indice_insertar(o)) {
+        pool_liberar(&pool_pedidos, o);
+        desbloquear_pedidos();
+        fprintf(stderr, "Error: No se pudo indexar el pedido.\n");
+        return 0;
+    }
+    if (id >= siguiente_id_pedido) siguiente_id_pedido = id + 1;
+    desbloquear_pedidos();
+    
+    // Agregar al final de la cola FIFO
+    cola_agregar(node, o);
+    
+    // Mantener contadores del lote y de sus ancestros
+    SUMAR_AGREGADO(node->num_pedidos, 1);
+    SUMAR_AGREGADO(node->cantidad_pendiente, cantidad);
+    propagar_agregados(node, 0, 1, cantidad);
+    version_encolar(node, o);
+    estad_cola(LEER_CONTADOR(node->num_pedidos));
+    
+    return id;
+}
+
+
+uint32_t enqueue_order(Node *node, const char *destino, int cantidad) {
+    // Devuelve el ID asignado al pedido, o 0 si no se pudo encolar
+    estad_operacion(ESTAD_PEDIDO);
+    uint32_t id_destino = cadena_internar(destino);
+    if (!id_destino && destino[0]) return 0;
+    if (node) limite_desalojar(node, 1);
+    return encolar_pedido(node, id_destino, cantidad, 0);
+}
+
+
+int count_orders(Node *node) {
+    return node ? LEER_CONTADOR(node->num_pedidos) : 0;
+}
+
+
+#ifdef INVENTARIO_CONCURRENTE
+void publicar_pedido(Node *node, Order *o) {
+    // Productor: apilar en la entrada del lote con comparar e intercambiar
+    Order *cabeza = __atomic_load_n(&node->entrada_pedidos, __ATOMIC_RELAXED);
+    do {
+        o->siguiente = cabeza;
+    } while (!__atomic_compare_exchange_n(&node->entrada_pedidos, &cabeza, o, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+void drenar_entrada(Node *node) {
+    // Consumidor unico (con el bloqueo del lote o el de escritura): toma toda
+    // la pila de una vez, la invierte a orden de llegada y la engancha al
+    // final de la cola FIFO doblemente enlazada
+    Order *pila = __atomic_exchange_n(&node->entrada_pedidos, NULL, __ATOMIC_ACQUIRE);
+    Order *lista = NULL;
+    while (pila) {
+        Order *sig = pila->siguiente;
+        pila->siguiente = lista;
+        lista = pila;
+        pila = sig;
+    }
+    while (lista) {
+        Order *sig = lista->siguiente;
+        cola_agregar(node, lista);
+        lista = sig;
+    }
+}
+#else
+#define drenar_entrada(node) ((void)0)
+#endif
+
+
+void free_orders(Order *head) {
+    Order *p = head;
+    bloquear_pedidos();
+    while (p) {
+        Order *tmp = p;        // Guardar referencia al nodo actual
+        p = p->siguiente;     // Avanzar al siguiente
+        indice_quitar(tmp);   // El ID deja de ser valido
+        pool_liberar(&pool_pedidos, tmp);  // Devolver el pedido al pool
+    }
+    desbloquear_pedidos();
+}
+
+
+int retirar_pedidos(Node *node, int maximo, bool archivar) {
+    // Despacha hasta maximo pedidos desde la cabeza de la cola y devuelve
+    // cuantos salieron. El stock ya se desconto al encolarlos: despachar lo
+    // liquida, el pedido solo deja de contar como pendiente. La cola la
+    // protege el llamador
+    drenar_entrada(node);
+    Order *cabeza = node->cabeza_pedidos;
+    Order *ultimo = cabeza ? cabeza->anterior : NULL;
+    Order *o = cabeza;
+    int retirados = 0;
+    long long cantidad = 0;
+    while (o && retirados < maximo) {
+        if (archivar && historial) historial_agregar(o);
+        cantidad += o->cantidad_solicitada;
+        retirados++;
+        o = o->siguiente;
+    }
+    if (retirados == 0) return 0;
+    
+    // Cortar el tramo de una vez: la nueva cabeza hereda el enlace al ultimo
+    node->cabeza_pedidos = o;
+    if (o) o->anterior = ultimo;
+    bloquear_pedidos();
+    while (cabeza != o) {
+        Order *sig = cabeza->siguiente;
+        indice_quitar(cabeza);
+        pool_liberar(&pool_pedidos, cabeza);
+        cabeza = sig;
+    }
+    desbloquear_pedidos();
+    
+    SUMAR_AGREGADO(node->num_pedidos, -retirados);
+    SUMAR_AGREGADO(node->cantidad_pendiente, -cantidad);
+    propagar_agregados(node, 0, -retirados, -cantidad);
+    version_rehacer_pedidos(node);
+    return retirados;
+}
+
+
+int fusionar_pedidos(Node *node) {
+    // Une cada tramo de pedidos consecutivos al mismo destino en el primero,
+    // que conserva su ID y su lugar en la cola; los IDs absorbidos dejan de
+    // existir. Stock y cantidad pendiente no cambian
+    drenar_entrada(node);
+    int fusionados = 0;
+    Order *o = node->cabeza_pedidos;
+    bloquear_pedidos();
+    while (o && o->siguiente) {
+        Order *s = o->siguiente;
+        if (s->destino != o->destino || s->cantidad_solicitada > INT_MAX - o->cantidad_solicitada) {
+            o = s;
+            continue;
+        }
+        o->cantidad_solicitada += s->cantidad_solicitada;
+        o->siguiente = s->siguiente;
+        if (s->siguiente) s->siguiente->anterior = o;
+        else node->cabeza_pedidos->anterior = o;  // s era el ultimo
+        indice_quitar(s);
+        pool_liberar(&pool_pedidos, s);
+        fusionados++;
+    }
+    desbloquear_pedidos();
+    
+    if (fusionados > 0) {
+        SUMAR_AGREGADO(node->num_pedidos, -fusionados);
+        propagar_agregados(node, 0, -fusionados, 0);
+        version_rehacer_pedidos(node);
+    }
+    return fusionados;
+}
+
+
+int despachar_pedidos(Node *node, int maximo) {
+    // Despacho al historial (si esta abierto); el journal guarda cuantos
+    // pedidos salieron de la cabeza
+    if (!node || maximo <= 0) return 0;
+    estad_operacion(ESTAD_DESPACHO);
+    int retirados = retirar_pedidos(node, maximo, true);
+    if (retirados > 0) {
+        journal_registrar(JOURNAL_DESPACHAR, node->fecha_vencimiento, node->secuencia, retirados, 0, NULL);
+    }
+    return retirados;
+}
+
+
+uint32_t dequeue_order(Node *node) {
+    // Despacha el pedido de la cabeza: devuelve su ID, o 0 si la cola esta vacia
+    if (!node) return 0;
+    drenar_entrada(node);
+    uint32_t id = node->cabeza_pedidos ? node->cabeza_pedidos->id : 0;
+    return despachar_pedidos(node, 1) ? id : 0;
+}
+
+
+int compactar_pedidos(Node *node) {
+    // Devuelve cuantos pedidos se absorbieron en el anterior
+    if (!node) return 0;
+    int fusionados = fusionar_pedidos(node);
+    if (fusionados > 0) {
+        journal_registrar(JOURNAL_COMPACTAR, node->fecha_vencimiento, node->secuencia, fusionados, 0, NULL);
+    }
+    return fusionados;
+}
+
+
+Node* siguiente_inorden(Node *n) {
+    return lote_siguiente(n);
+}
+
+
+/**
+ * Estructura IteradorInorden: Recorrido en orden con memoria O(1)
+ *
+ * A diferencia de Morris no modifica temporalmente el arbol: el sucesor se
+ * obtiene con los punteros al padre, asi que el recorrido puede cortarse en
+ * cualquier momento sin dejar enlaces a medias.
+ */
+typedef struct IteradorInorden {
+    Node *actual;                     // Proximo lote a devolver (NULL al terminar)
+} IteradorInorden;
+
+
+IteradorInorden iterador_inorden(Node *root) {
+    IteradorInorden it = { lote_minimo(root) };
+    return it;
+}
+
+
+Node* iterador_siguiente(IteradorInorden *it) {
+    Node *n = it->actual;
+    if (n) it->actual = siguiente_inorden(n);
+    return n;
+}
+
+
+#ifdef VERSIONES
+VersionLote* version_construir(IteradorInorden *it, long n) {
+    // Los n lotes siguientes del iterador como AVL balanceado, en O(n)
+    if (n <= 0) return NULL;
+    VersionLote *left = version_construir(it, n / 2);
+    Node *lote = iterador_siguiente(it);
+    VersionLote *v = version_nuevo(lote);
+    if (!v) {
+        version_soltar(left);
+        return NULL;
+    }
+    for (Order *o = lote->cabeza_pedidos; o; o = o->siguiente) {
+        VersionPedido *p = version_pedido_nuevo(o, v->ultimo_pedido);
+        if (!p) break;
+        v->ultimo_pedido = p;
+        v->num_pedidos++;
+    }
+    v->left = left;
+    v->right = version_construir(it, n - n / 2 - 1);
+    version_actualizar(v);
+    return v;
+}
+
+
+void version_reconstruir(Node *root) {
+    // Imagen completa del inventario vivo, tras cargas y reconstrucciones masivas
+    version_soltar(version_actual);
+    version_valida = true;
+    IteradorInorden it = iterador_inorden(root);
+    version_actual = version_construir(&it, root ? root->lotes_subarbol : 0);
+    version_comprobar();
+}
+
+
+void version_vaciar(void) {
+    // Sin versiones tomadas ningun nodo sobrevive: reinicio de ambos pools
+    if (versiones_tomadas == 0) {
+        pool_reiniciar(&pool_versiones);
+        pool_reiniciar(&pool_versiones_pedidos);
+    } else {
+        version_soltar(version_actual);
+    }
+    version_actual = NULL;
+    version_valida = true;
+}
+
+
+void version_destruir(void) {
+    pool_destruir(&pool_versiones);
+    pool_destruir(&pool_versiones_pedidos);
+    version_actual = NULL;
+}
+#else
+#define version_reconstruir(root) ((void)0)
+#define version_vaciar() ((void)0)
+#define version_destruir() ((void)0)
+#endif
+
+
+#ifdef INDICE_BMAS
+/*
+ * Indice alternativo de lotes por fecha (compilar con -DINDICE_BMAS)
+ *
+ * Arbol B+ de nodos anchos: las claves de cada nodo estan contiguas y la
+ * carga fria (nombre, cola de pedidos, agregados) queda fuera de linea en el
+ * Node del AVL, al que apuntan las hojas. Un descenso toca ~log32(n) nodos
+ * en lugar de ~log2(n) Node de 140 bytes dispersos en el heap.
+ *
+ * El AVL sigue siendo el dueno de los lotes (agregados, snapshot, reportes);
+ * el B+ se mantiene en paralelo y atiende las busquedas puntuales y el minimo
+ * detras de searchNode/buscar_lote_minimo.
+ */
+
+#define BMAS_ORDEN 32                  // Claves por nodo (256 bytes: cuatro lineas de cache)
+#define BMAS_MIN (BMAS_ORDEN / 2 - 1)  // Claves minimas de un nodo que no es raiz
+#define POOL_BMAS_POR_BLOQUE 64        // Nodos B+ por bloque del pool
+
+/**
+ * Estructura BMasNodo: Nodo ancho del arbol B+ (claves juntas, lotes aparte)
+ */
+typedef struct BMasNodo {
+    ClaveLote claves[BMAS_ORDEN];     // Claves (fecha, secuencia) ordenadas, sin saltos de puntero
+    int num_claves;                   // Claves ocupadas
+    bool hoja;                        // Las hojas guardan lotes; los internos, hijos
+    union {
+        struct BMasNodo *hijos[BMAS_ORDEN + 1];  // Interno: hijos[i] < claves[i] <= hijos[i+1]
+        Node *lotes[BMAS_ORDEN];                  // Hoja: lote de cada clave
+    };
+    struct BMasNodo *siguiente;       // Hoja siguiente en orden de clave
+} BMasNodo;
+
+Pool pool_bmas = POOL_INICIALIZADOR(BMasNodo, POOL_BMAS_POR_BLOQUE);
+BMasNodo *bmas_raiz = NULL;
+bool bmas_activo = true;              // false si una falta de memoria lo dejo incompleto
+
+
+BMasNodo* bmas_nuevo(bool hoja) {
+    BMasNodo *b = (BMasNodo*)pool_reservar(&pool_bmas);
+    if (!b) return NULL;
+    b->num_claves = 0;
+    b->hoja = hoja;
+    b->siguiente = NULL;
+    return b;
+}
+
+
+int bmas_posicion(const BMasNodo *b, ClaveLote clave) {
+    // Cantidad de claves <= clave: recorrido lineal sin saltos que el compilador vectoriza
+    int i = 0;
+    for (int k = 0; k < b->num_claves; k++) i += b->claves[k] <= clave;
+    return i;
+}
+
+
+Node** bmas_ranura(ClaveLote clave) {
+    BMasNodo *b = bmas_raiz;
+    if (!b) return NULL;
+    while (!b->hoja) b = b->hijos[bmas_posicion(b, clave)];
+    int i = bmas_posicion(b, clave);
+    return (i > 0 && b->claves[i - 1] == clave) ? &b->lotes[i - 1] : NULL;
+}
+
+
+Node* bmas_buscar(ClaveLote clave) {
+    Node **ranura = bmas_ranura(clave);
+    return ranura ? *ranura : NULL;
+}
+
+
+Node* bmas_primero_desde(ClaveLote clave) {
+    // Primer lote con clave >= clave: se baja por la posicion de clave - 1 y,
+    // si la hoja no tiene ninguno, es el primero de la hoja siguiente
+    BMasNodo *b = bmas_raiz;
+    if (!b) return NULL;
+    while (!b->hoja) b = b->hijos[bmas_posicion(b, clave - 1)];
+    int i = bmas_posicion(b, clave - 1);
+    if (i < b->num_claves) return b->lotes[i];
+    return b->siguiente ? b->siguiente->lotes[0] : NULL;
+}
+
+
+void bmas_actualizar(ClaveLote clave, Node *lote) {
+    // El lote de esa clave se movio a otro Node
+    Node **ranura = bmas_ranura(clave);
+    if (ranura) *ranura = lote;
+}
+
+
+Node* bmas_minimo(void) {
+    BMasNodo *b = bmas_raiz;
+    if (!b) return NULL;
+    while (!b->hoja) b = b->hijos[0];
+    return b->num_claves ? b->lotes[0] : NULL;
+}
+
+
+bool bmas_dividir(BMasNodo *p, int i) {
+    // Partir el hijo lleno p->hijos[i] en dos y subir el separador a p
+    BMasNodo *c = p->hijos[i];
+    BMasNodo *d = bmas_nuevo(c->hoja);
+    if (!d) return false;
+    
+    int mitad = BMAS_ORDEN / 2;
+    ClaveLote separador;
+    if (c->hoja) {
+        // Hoja: la primera clave de la mitad derecha se copia como separador
+        d->num_claves = BMAS_ORDEN - mitad;
+        memcpy(d->claves, c->claves + mitad, d->num_claves * sizeof(ClaveLote));
+        memcpy(d->lotes, c->lotes + mitad, d->num_claves * sizeof(Node*));
+        d->siguiente = c->siguiente;
+        c->siguiente = d;
+        separador = d->claves[0];
+    } else {
+        // Interno: la clave central sube y no se queda en ninguna mitad
+        separador = c->claves[mitad];
+        d->num_claves = BMAS_ORDEN - mitad - 1;
+        memcpy(d->claves, c->claves + mitad + 1, d->num_claves * sizeof(ClaveLote));
+        memcpy(d->hijos, c->hijos + mitad + 1, (d->num_claves + 1) * sizeof(BMasNodo*));
+    }
+    c->num_claves = mitad;
+    
+    memmove(p->claves + i + 1, p->claves + i, (p->num_claves - i) * sizeof(ClaveLote));
+    memmove(p->hijos + i + 2, p->hijos + i + 1, (p->num_claves - i) * sizeof(BMasNodo*));
+    p->claves[i] = separador;
+    p->hijos[i + 1] = d;
+    p->num_claves++;
+    return true;
+}
+
+
+bool bmas_insertar_clave(ClaveLote clave, Node *lote) {
+    if (!bmas_raiz && !(bmas_raiz = bmas_nuevo(true))) return false;
+    
+    // Raiz llena: crece un nivel hacia arriba
+    if (bmas_raiz->num_claves == BMAS_ORDEN) {
+        BMasNodo *r = bmas_nuevo(false);
+        if (!r) return false;
+        r->hijos[0] = bmas_raiz;
+        if (!bmas_dividir(r, 0)) {
+            pool_liberar(&pool_bmas, r);
+            return false;
+        }
+        bmas_raiz = r;
+    }
+    
+    // Descenso con division preventiva: nunca se baja a un nodo lleno
+    BMasNodo *b = bmas_raiz;
+    while (!b->hoja) {
+        int i = bmas_posicion(b, clave);
+        if (b->hijos[i]->num_claves == BMAS_ORDEN) {
+            if (!bmas_dividir(b, i)) return false;
+            if (clave >= b->claves[i]) i++;
+        }
+        b = b->hijos[i];
+    }
+    
+    int i = bmas_posicion(b, clave);
+    if (i > 0 && b->claves[i - 1] == clave) return true;  // Ya indexada
+    memmove(b->claves + i + 1, b->claves + i, (b->num_claves - i) * sizeof(ClaveLote));
+    memmove(b->lotes + i + 1, b->lotes + i, (b->num_claves - i) * sizeof(Node*));
+    b->claves[i] = clave;
+    b->lotes[i] = lote;
+    b->num_claves++;
+    return true;
+}
+
+
+void bmas_insertar(ClaveLote clave, Node *lote) {
+    // Sin memoria el indice deja de ser fiable: las busquedas vuelven al AVL
+    if (bmas_activo && !bmas_insertar_clave(clave, lote)) bmas_activo = false;
+}
+
+
+void bmas_reparar(BMasNodo *p, int i) {
+    // El hijo p->hijos[i] quedo por debajo del minimo: pedir prestado o fusionar
+    BMasNodo *c = p->hijos[i];
+    BMasNodo *izq = i > 0 ? p->hijos[i - 1] : NULL;
+    BMasNodo *der = i < p->num_claves ? p->hijos[i + 1] : NULL;
+    
+    if (izq && izq->num_claves > BMAS_MIN) {
+        // Rotar la ultima clave del hermano izquierdo
+        memmove(c->claves + 1, c->claves, c->num_claves * sizeof(ClaveLote));
+        if (c->hoja) {
+            memmove(c->lotes + 1, c->lotes, c->num_claves * sizeof(Node*));
+            c->claves[0] = izq->claves[izq->num_claves - 1];
+            c->lotes[0] = izq->lotes[izq->num_claves - 1];
+            p->claves[i - 1] = c->claves[0];
+        } else {
+            memmove(c->hijos + 1, c->hijos, (c->num_claves + 1) * sizeof(BMasNodo*));
+            c->claves[0] = p->claves[i - 1];
+            c->hijos[0] = izq->hijos[izq->num_claves];
+            p->claves[i - 1] = izq->claves[izq->num_claves - 1];
+        }
+        c->num_claves++;
+        izq->num_claves--;
+    } else if (der && der->num_claves > BMAS_MIN) {
+        // Rotar la primera clave del hermano derecho
+        if (c->hoja) {
+            c->claves[c->num_claves] = der->claves[0];
+            c->lotes[c->num_claves] = der->lotes[0];
+            memmove(der->lotes, der->lotes + 1, (der->num_claves - 1) * sizeof(Node*));
+        } else {
+            c->claves[c->num_claves] = p->claves[i];
+            c->hijos[c->num_claves + 1] = der->hijos[0];
+            p->claves[i] = der->claves[0];
+            memmove(der->hijos, der->hijos + 1, der->num_claves * sizeof(BMasNodo*));
+        }
+        memmove(der->claves, der->claves + 1, (der->num_claves - 1) * sizeof(ClaveLote));
+        if (c->hoja) p->claves[i] = der->claves[0];
+        c->num_claves++;
+        der->num_claves--;
+    } else {
+        // Ambos hermanos en el minimo: fusionar el par que rodea al separador k
+        int k = izq ? i - 1 : i;
+        BMasNodo *a = p->hijos[k], *b = p->hijos[k + 1];
+        if (a->hoja) {
+            memcpy(a->claves + a->num_claves, b->claves, b->num_claves * sizeof(ClaveLote));
+            memcpy(a->lotes + a->num_claves, b->lotes, b->num_claves * sizeof(Node*));
+            a->num_claves += b->num_claves;
+            a->siguiente = b->siguiente;
+        } else {
+            a->claves[a->num_claves] = p->claves[k];
+            memcpy(a->claves + a->num_claves + 1, b->claves, b->num_claves * sizeof(ClaveLote));
+            memcpy(a->hijos + a->num_claves + 1, b->hijos, (b->num_claves + 1) * sizeof(BMasNodo*));
+            a->num_claves += b->num_claves + 1;
+        }
+        memmove(p->claves + k, p->claves + k + 1, (p->num_claves - k - 1) * sizeof(ClaveLote));
+        memmove(p->hijos + k + 1, p->hijos + k + 2, (p->num_claves - k - 1) * sizeof(BMasNodo*));
+        p->num_claves--;
+        pool_liberar(&pool_bmas, b);
+    }
+}
+
+
+bool bmas_eliminar_en(BMasNodo *b, ClaveLote clave) {
+    // Recursion acotada por la altura del B+ (3 o 4 niveles para millones de lotes)
+    int i = bmas_posicion(b, clave);
+    if (b->hoja) {
+        if (i == 0 || b->claves[i - 1] != clave) return false;
+        memmove(b->claves + i - 1, b->claves + i, (b->num_claves - i) * sizeof(ClaveLote));
+        memmove(b->lotes + i - 1, b->lotes + i, (b->num_claves - i) * sizeof(Node*));
+        b->num_claves--;
+        return true;
+    }
+    if (!bmas_eliminar_en(b->hijos[i], clave)) return false;
+    if (b->hijos[i]->num_claves < BMAS_MIN) bmas_reparar(b, i);
+    return true;
+}
+
+
+void bmas_eliminar(ClaveLote clave) {
+    if (!bmas_raiz || !bmas_eliminar_en(bmas_raiz, clave)) return;
+    
+    // La raiz se quedo sin claves: el arbol pierde un nivel
+    if (bmas_raiz->num_claves == 0) {
+        BMasNodo *vieja = bmas_raiz;
+        bmas_raiz = vieja->hoja ? NULL : vieja->hijos[0];
+        pool_liberar(&pool_bmas, vieja);
+    }
+}
+
+
+void bmas_vaciar(void) {
+    pool_reiniciar(&pool_bmas);
+    bmas_raiz = NULL;
+    bmas_activo = true;
+}
+
+
+void bmas_reconstruir(Node *root) {
+    // Carga masiva en O(n) desde el recorrido en orden del AVL: hojas llenas
+    // repartidas de forma pareja y niveles internos construidos de abajo arriba
+    bmas_vaciar();
+    size_t n = root ? (size_t)root->lotes_subarbol : 0;
+    if (n == 0) return;
+    
+    size_t num = (n + BMAS_ORDEN - 1) / BMAS_ORDEN;
+    BMasNodo **nivel = (BMasNodo**)malloc(num * sizeof(BMasNodo*));
+    ClaveLote *minimos = (ClaveLote*)malloc(num * sizeof(ClaveLote));
+    if (!nivel || !minimos) {
+        free(nivel);
+        free(minimos);
+        bmas_activo = false;
+        return;
+    }
+    
+    IteradorInorden it = iterador_inorden(root);
+    BMasNodo *previa = NULL;
+    bool ok = true;
+    for (size_t j = 0; ok && j < num; j++) {
+        BMasNodo *h = bmas_nuevo(true);
+        if (!h) {
+            ok = false;
+            break;
+        }
+        h->num_claves = (int)(n * (j + 1) / num - n * j / num);
+        for (int k = 0; k < h->num_claves; k++) {
+            Node *lote = iterador_siguiente(&it);
+            h->claves[k] = clave_de(lote);
+            h->lotes[k] = lote;
+        }
+        if (previa) previa->siguiente = h;
+        previa = h;
+        nivel[j] = h;
+        minimos[j] = h->claves[0];
+    }
+    
+    // Cada nivel interno agrupa hasta BMAS_ORDEN + 1 hijos por nodo
+    while (ok && num > 1) {
+        size_t padres = (num + BMAS_ORDEN) / (BMAS_ORDEN + 1);
+        for (size_t j = 0; j < padres; j++) {
+            size_t lo = num * j / padres, hi = num * (j + 1) / padres;
+            BMasNodo *p = bmas_nuevo(false);
+            if (!p) {
+                ok = false;
+                break;
+            }
+            for (size_t k = lo; k < hi; k++) {
+                p->hijos[k - lo] = nivel[k];
+                if (k > lo) p->claves[k - lo - 1] = minimos[k];
+            }
+            p->num_claves = (int)(hi - lo - 1);
+            minimos[j] = minimos[lo];  // j <= lo: no pisa entradas pendientes
+            nivel[j] = p;
+        }
+        num = padres;
+    }
+    
+    if (ok) {
+        bmas_raiz = nivel[0];
+    } else {
+        bmas_vaciar();
+        bmas_activo = false;
+    }
+    free(nivel);
+    free(minimos);
+}
+
+
+void bmas_destruir(void) {
+    pool_destruir(&pool_bmas);
+    bmas_raiz = NULL;
+}
+
+#else
+// Sin el indice B+ los ganchos no hacen nada y las busquedas usan el AVL
+#define bmas_insertar(clave, lote) ((void)0)
+#define bmas_actualizar(clave, lote) ((void)0)
+#define bmas_eliminar(clave) ((void)0)
+#define bmas_vaciar() ((void)0)
+#define bmas_reconstruir(root) ((void)0)
+#define bmas_destruir() ((void)0)
+#endif
+
+
+/**
+ * Indice secundario por producto
+ *
+ * Los nombres de producto estan internados, asi que el ID sirve de posicion
+ * directa en un arreglo (sin hash ni comparar cadenas). Cada entrada enlaza los
+ * lotes de ese producto en una lista doble ordenada por vencimiento, con los
+ * enlaces dentro del propio Node: la cabeza es el lote FEFO del producto y la
+ * baja de un lote es O(1). Al insertar, el lote anterior del mismo producto
+ * se busca a la vez desde la cola de su lista y hacia atras en el arbol (por
+ * predecesores en orden), y se corta con el primero que lo encuentra: O(1)
+ * cuando los lotes llegan con vencimientos crecientes o el producto domina
+ * esa zona del arbol. Las cargas y reconstrucciones arman todas las listas en
+ * una sola pasada en orden.
+ */
+
+/**
+ * Estructura EntradaProducto: Lotes de un producto, del mas proximo a vencer al ultimo
+ */
+typedef struct EntradaProducto {
+    Node *primero;                    // Lote FEFO del producto
+    Node *ultimo;                     // Lote del producto que vence mas tarde
+    int lotes;                        // Lotes del producto en el inventario
+} EntradaProducto;
+
+/**
+ * Estructura IndiceProductos: Entradas por ID de producto
+ */
+typedef struct IndiceProductos {
+    EntradaProducto *entradas;        // Indexadas por el ID internado del nombre
+    uint32_t capacidad;               // Entradas reservadas (ceros si no hay lotes)
+    bool valido;                      // false si falto memoria: se rearma al consultar
+} IndiceProductos;
+
+#define PRODUCTOS_CAPACIDAD_INICIAL 64
+
+IndiceProductos productos = { NULL, 0, true };
+
+
+bool productos_crecer(uint32_t id) {
+    uint32_t capacidad = productos.capacidad ? productos.capacidad : PRODUCTOS_CAPACIDAD_INICIAL;
+    while (capacidad <= id) capacidad *= 2;
+    EntradaProducto *e = (EntradaProducto*)realloc(productos.entradas, capacidad * sizeof(EntradaProducto));
+    if (!e) return false;
+    memset(e + productos.capacidad, 0, (capacidad - productos.capacidad) * sizeof(EntradaProducto));
+    productos.entradas = e;
+    productos.capacidad = capacidad;
+    return true;
+}
+
+
+void producto_enlazar(Node *n) {
+    // n ya esta en el arbol en su posicion definitiva
+    if (!productos.valido) return;
+    if (n->producto >= productos.capacidad && !productos_crecer(n->producto)) {
+        productos.valido = false;  // Sin memoria: la proxima consulta rearma el indice
+        return;
+    }
+    EntradaProducto *e = &productos.entradas[n->producto];
+    
+    // Ultimo lote del producto anterior a n (NULL: n va primero), buscado por
+    // la lista y por el arbol en paralelo
+    Node *cola = e->ultimo, *arbol = n, *ant;
+    while (1) {
+        if (!cola || clave_de(cola) < clave_de(n)) {
+            ant = cola;
+            break;
+        }
+        cola = cola->producto_anterior;
+        arbol = lote_anterior(arbol);
+        if (!arbol || arbol->producto == n->producto) {
+            ant = arbol;
+            break;
+        }
+    }
+    
+    n->producto_anterior = ant;
+    n->producto_siguiente = ant ? ant->producto_siguiente : e->primero;
+    if (n->producto_siguiente) n->producto_siguiente->producto_anterior = n;
+    else e->ultimo = n;
+    if (ant) ant->producto_siguiente = n;
+    else e->primero = n;
+    e->lotes++;
+}
+
+
+void producto_desenlazar(Node *n) {
+    if (!productos.valido) return;
+    EntradaProducto *e = &productos.entradas[n->producto];
+    if (n->producto_anterior) n->producto_anterior->producto_siguiente = n->producto_siguiente;
+    else e->primero = n->producto_siguiente;
+    if (n->producto_siguiente) n->producto_siguiente->producto_anterior = n->producto_anterior;
+    else e->ultimo = n->producto_anterior;
+    n->producto_anterior = n->producto_siguiente = NULL;
+    e->lotes--;
+}
+
+
+void productos_vaciar(void) {
+    if (productos.entradas) memset(productos.entradas, 0, productos.capacidad * sizeof(EntradaProducto));
+    productos.valido = true;
+}
+
+
+void productos_reconstruir(Node *root) {
+    // Recorrido en orden: cada lote se agrega al final de la lista de su producto
+    productos_vaciar();
+    IteradorInorden it = iterador_inorden(root);
+    Node *n;
+    while ((n = iterador_siguiente(&it)) != NULL) {
+        n->producto_anterior = n->producto_siguiente = NULL;
+        producto_enlazar(n);
+    }
+}
+
+
+void productos_destruir(void) {
+    free(productos.entradas);
+    productos.entradas = NULL;
+    productos.capacidad = 0;
+    productos.valido = true;
+}
+
+
+EntradaProducto* producto_entrada(Node *root, const char *producto) {
+    // Entrada del producto, o NULL si no tiene lotes
+    if (!root) return NULL;
+    if (!productos.valido) {
+        productos_reconstruir(root);
+        if (!productos.valido) return NULL;
+    }
+    uint32_t id = cadena_buscar(producto);
+    if (id == 0 && producto[0]) return NULL;  // Nombre nunca visto
+    if (id >= productos.capacidad || !productos.entradas[id].primero) return NULL;
+    return &productos.entradas[id];
+}
+
+
+Node* producto_lote_fefo(Node *root, const char *producto) {
+    // Lote del producto mas proximo a vencer en O(1); los siguientes se
+    // recorren con producto_siguiente
+    EntradaProducto *e = producto_entrada(root, producto);
+    return e ? e->primero : NULL;
+}
+
+
+Totales totales_producto(Node *root, const char *producto) {
+    // Recorre solo los lotes del producto
+    Totales t = {0, 0, 0, 0};
+    for (Node *n = producto_lote_fefo(root, producto); n; n = n->producto_siguiente) {
+        t.lotes++;
+        t.stock += LEER_CONTADOR(n->stock_total);
+        t.pedidos += LEER_CONTADOR(n->num_pedidos);
+        t.pendiente += LEER_CONTADOR(n->cantidad_pendiente);
+    }
+    return t;
+}
+
+
+// Lote mas proximo a vencer (extremo izquierdo del AVL), cacheado para que
+// el despacho FEFO no descienda el arbol en cada pedido. Las rotaciones no
+// cambian cual es el nodo mas a la izquierda: solo se actualiza al insertar,
+// eliminar o reconstruir el arbol.
+Node *lote_fefo = NULL;
+
+
+void actualizar_lote_fefo(Node *root) {
+    lote_fefo = lote_minimo(root);
+}
+
+
+Node* searchNode(Node *root, int fecha) {
+    // Primer lote (el de menor secuencia) que vence en la fecha
+#ifdef INDICE_BMAS
+    // root es siempre la raiz del inventario: el B+ lo indexa completo
+    if (bmas_activo) {
+        Node *n = root ? bmas_primero_desde(clave_lote(fecha, 0)) : NULL;
+        return (n && n->fecha_vencimiento == fecha) ? n : NULL;
+    }
+#endif
+    // Descenso iterativo: sin recursion, memoria O(1). Al encontrar la fecha
+    // se sigue por la izquierda, donde pueden estar lotes anteriores del mismo dia
+    Node *encontrado = NULL;
+    int profundidad = 0;
+    while (root) {
+        profundidad++;
+        if (fecha <= root->fecha_vencimiento) {
+            if (fecha == root->fecha_vencimiento) encontrado = root;
+            root = root->left;   // Buscar en subarbol izquierdo
+        } else {
+            root = root->right;  // Buscar en subarbol derecho
+        }
+    }
+    estad_busqueda(profundidad, encontrado != NULL);
+    return encontrado;  // Encontrado, o NULL si ningun lote vence ese dia
+}
+
+
+Node* buscar_lote(Node *root, int fecha, uint32_t secuencia) {
+    // Lote exacto por su clave completa (fecha y secuencia)
+    ClaveLote clave = clave_lote(fecha, secuencia);
+#ifdef INDICE_BMAS
+    if (bmas_activo) return root ? bmas_buscar(clave) : NULL;
+#endif
+    int profundidad = 0;
+    while (root && clave != clave_de(root)) {
+        root = (clave < clave_de(root)) ? root->left : root->right;
+        profundidad++;
+    }
+    estad_busqueda(profundidad + (root != NULL), root != NULL);
+    return root;
+}
+
+
+Node* buscar_lote_minimo(Node *root) {
+    // Lote mas proximo a vencer de todo el inventario, en O(1)
+    return root ? lote_fefo : NULL;
+}
+
+
+Node* insertAVL(Node *root, int fecha, const char *producto, int stock) {
+    estad_operacion(ESTAD_INSERCION);
+    // Descender iterativamente hasta el punto de insercion. Un lote de una
+    // fecha que ya existe va despues de los de ese dia: el ultimo de ellos por
+    // el que se pasa es el de mayor secuencia, asi que el mismo descenso
+    // inserta o agrega al dia sin buscar antes
+    Node *padre = NULL;
+    Node *cur = root;
+    uint32_t secuencia = 0;
+    while (cur) {
+        padre = cur;
+        if (fecha < cur->fecha_vencimiento) {
+            cur = cur->left;   // Fechas mas antiguas
+        } else {
+            if (fecha == cur->fecha_vencimiento) secuencia = cur->secuencia + 1;
+            cur = cur->right;  // Fechas mas futuras (o lotes del mismo dia)
+        }
+    }
+    
+    Node *nuevo = newNode(fecha, cadena_internar(producto), stock);
+    if (!nuevo) return NULL;  // Error de memoria (el arbol queda intacto)
+    nuevo->secuencia = secuencia;
+    bmas_insertar(clave_de(nuevo), nuevo);
+    version_insertar(nuevo);
+    if (!padre || !lote_fefo || fecha < lote_fefo->fecha_vencimiento) lote_fefo = nuevo;
+    if (!padre) {
+        producto_enlazar(nuevo);
+        return nuevo;  // Arbol vacio: el nuevo nodo es la raiz
+    }
+    
+    // Enganchar la hoja y rebalancear desde su padre hasta la raiz
+    nuevo->parent = padre;
+    if (fecha < padre->fecha_vencimiento) padre->left = nuevo;
+    else padre->right = nuevo;
+    root = lote_rebalancear_hacia_arriba(padre, root);
+    producto_enlazar(nuevo);  // Ya enganchado: sus predecesores en orden ayudan a ubicarlo
+    return root;
+}
+
+
+int comparar_lotes_entrada(const void *a, const void *b) {
+    const LoteEntrada *x = *(const LoteEntrada* const*)a;
+    const LoteEntrada *y = *(const LoteEntrada* const*)b;
+    if (x->fecha_vencimiento != y->fecha_vencimiento) {
+        return x->fecha_vencimiento < y->fecha_vencimiento ? -1 : 1;
+    }
+    // Desempate por posicion en la entrada: los lotes del mismo dia conservan
+    // el orden de llegada (el mismo que daria insertarlos uno por uno)
+    return (x > y) - (x < y);
+}
+
+
+void aplanar_arbol(Node *root, Node **nodos, size_t *k) {
+    IteradorInorden it = iterador_inorden(root);
+    Node *n;
+    while ((n = iterador_siguiente(&it)) != NULL) nodos[(*k)++] = n;
+}
+
+
+Node* construir_balanceado(Node **nodos, long lo, long hi, Node *padre) {
+    // Enlaza nodos ya creados (ordenados por fecha) como un AVL perfectamente balanceado
+    if (lo > hi) return NULL;
+    long mid = lo + (hi - lo) / 2;
+    Node *n = nodos[mid];
+    n->parent = padre;
+    n->left = construir_balanceado(nodos, lo, mid - 1, n);
+    n->right = construir_balanceado(nodos, mid + 1, hi, n);
+    lote_actualizar(n);
+    return n;
+}
+
+
+Node* insertar_lotes_masivo(Node *root, LoteEntrada *lotes, size_t n, size_t *insertados) {
+    *insertados = 0;
+    if (n == 0) return root;
+    
+    // Ordenar la entrada por fecha (sin mover los registros del llamador)
+    LoteEntrada **orden = (LoteEntrada**)malloc(n * sizeof(LoteEntrada*));
+    if (!orden) return root;
+    for (size_t i = 0; i < n; i++) {
+        lotes[i].insertado = false;
+        orden[i] = &lotes[i];
+    }
+    qsort(orden, n, sizeof(LoteEntrada*), comparar_lotes_entrada);
+    size_t m = n;
+    
+    // Lote pequeno frente al arbol: m inserciones O(log n) salen mas baratas
+    // que reconstruir los n nodos existentes
+    size_t existentes = root ? (size_t)root->lotes_subarbol : 0;
+    size_t log2_existentes = 0;
+    while ((existentes >> log2_existentes) > 1) log2_existentes++;
+    if (m * log2_existentes < existentes) {
+        for (size_t j = 0; j < m; j++) {
+            LoteEntrada *e = orden[j];
+            Node *nuevo_root = insertAVL(root, e->fecha_vencimiento, e->producto, e->stock);
+            if (!nuevo_root) break;
+            root = nuevo_root;
+            e->insertado = true;
+            (*insertados)++;
+        }
+        free(orden);
+        return root;
+    }
+    
+    // Mezcla ordenada de los nodos existentes con los nuevos y reconstruccion en O(n + m)
+    estad_operacion(ESTAD_MASIVA);
+    Node **viejos = (Node**)malloc((existentes + 1) * sizeof(Node*));
+    Node **nodos = (Node**)malloc((existentes + m) * sizeof(Node*));
+    if (!viejos || !nodos) {
+        free(viejos);
+        free(nodos);
+        free(orden);
+        return root;
+    }
+    size_t k = 0;
+    aplanar_arbol(root, viejos, &k);
+    
+    size_t i = 0, j = 0, total = 0;
+    while (i < k || j < m) {
+        if (j == m || (i < k && viejos[i]->fecha_vencimiento <= orden[j]->fecha_vencimiento)) {
+            // Los lotes ya presentes de una fecha van antes que los nuevos
+            nodos[total++] = viejos[i++];
+        } else {
+            LoteEntrada *e = orden[j++];
+            Node *nuevo = newNode(e->fecha_vencimiento, cadena_internar(e->producto), e->stock);
+            if (!nuevo) continue;  // Sin memoria: el lote queda sin insertar
+            Node *previo = total ? nodos[total - 1] : NULL;
+            if (previo && previo->fecha_vencimiento == nuevo->fecha_vencimiento) {
+                nuevo->secuencia = previo->secuencia + 1;
+            }
+            e->insertado = true;
+            (*insertados)++;
+            nodos[total++] = nuevo;
+        }
+    }
+    
+    root = construir_balanceado(nodos, 0, (long)total - 1, NULL);
+    bmas_reconstruir(root);
+    version_reconstruir(root);
+    productos_reconstruir(root);
+    actualizar_lote_fefo(root);
+    free(viejos);
+    free(nodos);
+    free(orden);
+    return root;
+}
+
+
+Node* trasplantar(Node *root, Node *u, Node *v) {
+    // Poner el subarbol v en el lugar de u (en su padre, o como raiz); devuelve la raiz
+    if (!u->parent) root = v;
+    else if (u->parent->left == u) u->parent->left = v;
+    else u->parent->right = v;
+    if (v) v->parent = u->parent;
+    return root;
+}
+
+
+Node* deleteNode(Node* root, int fecha, uint32_t secuencia) {
+    estad_operacion(ESTAD_ELIMINACION);
+    // Buscar el nodo a eliminar (descenso iterativo)
+    Node *n = buscar_lote(root, fecha, secuencia);
+    if (!n) return root;
+    bmas_eliminar(clave_de(n));
+    version_eliminar(n);
+    producto_desenlazar(n);
+    
+    // PASO CRÍTICO: Liberar la cola FIFO antes de eliminar el nodo
+    // Esto previene fugas de memoria (requisito de la rúbrica)
+    drenar_entrada(n);
+    free_orders(n->cabeza_pedidos);
+    
+    // Se reenlazan nodos en vez de copiar datos entre ellos: cada lote sigue en
+    // su propio Node, con su cola intacta, y la baja es O(log n) sin importar
+    // cuantos pedidos tenga el sucesor
+    Node *inicio;  // Primer nodo a rebalancear
+    if (!n->left || !n->right) {
+        // CASO 1: Nodo sin hijos o con un solo hijo: el hijo (o NULL) sube a su lugar
+        inicio = n->parent;
+        root = trasplantar(root, n, n->left ? n->left : n->right);
+    } else {
+        // CASO 2: Nodo con dos hijos
+        // Estrategia: el sucesor en orden (minimo del subarbol derecho) ocupa su lugar
+        Node *suc = lote_minimo(n->right);
+        if (suc->parent != n) {
+            // Desenganchar el sucesor (sin hijo izquierdo) y darle el subarbol derecho
+            inicio = suc->parent;
+            root = trasplantar(root, suc, suc->right);
+            suc->right = n->right;
+            suc->right->parent = suc;
+        } else {
+            inicio = suc;  // El sucesor es el hijo derecho: conserva su subarbol
+        }
+        root = trasplantar(root, n, suc);
+        suc->left = n->left;
+        suc->left->parent = suc;
+    }
+    pool_liberar(&pool_nodos, n);
+    
+    // PASO CRÍTICO: Rebalancear desde el punto de eliminacion hasta la raiz
+    // (el camino pasa por el sucesor, asi que tambien se recalculan sus agregados)
+    root = lote_rebalancear_hacia_arriba(inicio, root);
+    
+    // El minimo pudo ser el nodo liberado
+    actualizar_lote_fefo(root);
+    return root;
+}
+
+
+Node* findNode(Node *root, int fecha) {
+    return searchNode(root, fecha);
+}
+
+
+void sumar_subarbol(Totales *t, Node *n) {
+    if (!n) return;
+    t->lotes += n->lotes_subarbol;
+    t->stock += n->stock_subarbol;
+    t->pedidos += n->pedidos_subarbol;
+    t->pendiente += n->pendiente_subarbol;
+}
+
+
+Totales totales_hasta(Node *root, int fecha) {
+    // Totales de los lotes con fecha <= fecha en un solo descenso (O(log n)):
+    // al ir a la derecha se suma el nodo y todo su subarbol izquierdo
+    Totales t = {0, 0, 0, 0};
+    while (root) {
+        if (root->fecha_vencimiento <= fecha) {
+            sumar_subarbol(&t, root->left);
+            t.lotes++;
+            t.stock += root->stock_total;
+            t.pedidos += root->num_pedidos;
+            t.pendiente += root->cantidad_pendiente;
+            root = root->right;
+        } else {
+            root = root->left;
+        }
+    }
+    return t;
+}
+
+
+Totales totales_rango(Node *root, int desde, int hasta) {
+    // Totales de los lotes con desde <= fecha <= hasta
+    Totales a = totales_hasta(root, hasta);
+    Totales b = totales_hasta(root, desde - 1);
+    a.lotes -= b.lotes;
+    a.stock -= b.stock;
+    a.pedidos -= b.pedidos;
+    a.pendiente -= b.pendiente;
+    return a;
+}
+
+
+IteradorRango iterador_rango(Node *root, int desde, int hasta) {
+    // Descender hasta la cota inferior: el menor lote con fecha >= desde
+    IteradorRango it = { lote_primero_desde(root, clave_lote(desde, 0)), hasta };
+    return it;
+}
+
+
+Node* iterador_rango_siguiente(IteradorRango *it) {
+    // Avanzar por sucesores hasta pasar la cota superior: O(log n + k) en total
+    Node *n = it->actual;
+    if (!n || n->fecha_vencimiento > it->hasta) return NULL;
+    it->actual = siguiente_inorden(n);
+    return n;
+}
+
+
+Node* unir_avl(Node *l, Node *m, Node *r) {
+    // Une dos AVL con todas las fechas de l < m < todas las de r, en
+    // O(|altura(l) - altura(r)|): m se cuelga en la espina del mas alto
+    int hl = lote_altura(l), hr = lote_altura(r);
+    if (hl > hr + 1) {
+        Node *sub = unir_avl(l->right, m, r);
+        l->right = sub;
+        sub->parent = l;
+        return lote_balancear(l);
+    }
+    if (hr > hl + 1) {
+        Node *sub = unir_avl(l, m, r->left);
+        r->left = sub;
+        sub->parent = r;
+        return lote_balancear(r);
+    }
+    m->left = l;
+    m->right = r;
+    m->parent = NULL;
+    if (l) l->parent = m;
+    if (r) r->parent = m;
+    lote_actualizar(m);
+    return m;
+}
+
+
+void liberar_subarbol(Node *n) {
+    // Libera un subarbol ya desenganchado, con sus colas, en una sola pasada
+    // postorden por los punteros al padre (sin pila ni recursion)
+    while (n) {
+        if (n->left) {
+            n = n->left;
+        } else if (n->right) {
+            n = n->right;
+        } else {
+            Node *padre = n->parent;
+            if (padre) {
+                if (padre->left == n) padre->left = NULL;
+                else padre->right = NULL;
+            }
+            drenar_entrada(n);
+            free_orders(n->cabeza_pedidos);  // Los IDs salen del indice
+            bmas_eliminar(clave_de(n));
+            version_eliminar(n);
+            producto_desenlazar(n);
+            pool_liberar(&pool_nodos, n);
+            n = padre;
+        }
+    }
+}
+
+
+Node* separar_vencidos(Node *t, int corte, Totales *quitados) {
+    // Devuelve el AVL con los lotes de t con fecha >= corte. Los anteriores se
+    // liberan: cada subarbol izquierdo que queda entero antes del corte sale
+    // sin rebalanceos, y la parte que se conserva se recompone con uniones
+    // cuyo costo total es O(log n)
+    while (t && t->fecha_vencimiento < corte) {
+        // t y todo su subarbol izquierdo vencieron: seguir por la derecha
+        Node *izq = t->left, *der = t->right;
+        sumar_subarbol(quitados, izq);
+        quitados->lotes++;
+        quitados->stock += t->stock_total;
+        quitados->pedidos += t->num_pedidos;
+        quitados->pendiente += t->cantidad_pendiente;
+        if (izq) izq->parent = NULL;
+        liberar_subarbol(izq);
+        t->left = t->right = NULL;
+        if (der) der->parent = NULL;
+        liberar_subarbol(t);
+        t = der;
+    }
+    if (!t) return NULL;
+    
+    // t se conserva: recortar su subarbol izquierdo y volver a unirlo
+    Node *izq = t->left, *der = t->right;
+    if (izq) izq->parent = NULL;
+    if (der) der->parent = NULL;
+    t->parent = NULL;
+    return unir_avl(separar_vencidos(izq, corte, quitados), t, der);
+}
+
+
+Node* purgar_vencidos(Node *root, int corte, Totales *quitados) {
+    // Retira todos los lotes con fecha < corte en O(log n + k)
+    quitados->lotes = 0;
+    quitados->stock = quitados->pedidos = quitados->pendiente = 0;
+    if (!root) return NULL;
+    root = separar_vencidos(root, corte, quitados);
+    if (root) root->parent = NULL;
+    actualizar_lote_fefo(root);
+    return root;
+}
+
+
+void quitar_pedido(Order *o) {
+    estad_operacion(ESTAD_CANCELACION);
+    Node *node = o->lote;
+    
+    // Desenlazar en O(1) gracias al enlace al pedido anterior
+    Order *cabeza = node->cabeza_pedidos;
+    if (o == cabeza) node->cabeza_pedidos = o->siguiente;   // Era el primero: actualizar cabeza
+    else o->anterior->siguiente = o->siguiente;
+    if (o->siguiente) o->siguiente->anterior = o->anterior;  // La nueva cabeza hereda el enlace al ultimo
+    else if (o != cabeza) cabeza->anterior = o->anterior;    // Era el ultimo: la cabeza apunta al nuevo
+    
+    // Restaurar el stock del lote (sumar la cantidad cancelada) y los contadores
+    SUMAR_AGREGADO(node->stock_total, o->cantidad_solicitada);
+    SUMAR_AGREGADO(node->num_pedidos, -1);
+    SUMAR_AGREGADO(node->cantidad_pendiente, -o->cantidad_solicitada);
+    propagar_agregados(node, o->cantidad_solicitada, -1, -o->cantidad_solicitada);
+    version_quitar(node, o->id);
+    
+    // Quitar del indice y devolver el pedido al pool
+    bloquear_pedidos();
+    indice_quitar(o);
+    pool_liberar(&pool_pedidos, o);
+    desbloquear_pedidos();
+}
+
+
+int cancel_order_by_id(uint32_t id) {
+    Order *o = buscar_pedido_por_id(id);
+    if (!o) return 0;  // Pedido no encontrado
+    quitar_pedido(o);
+    return 1;  // Éxito
+}
+
+
+Order* buscar_pedido(Node *node, const char *destino, int cantidad) {
+    // Busqueda secuencial por destino Y cantidad (primer pedido que coincida).
+    // Un destino que no esta en la tabla de cadenas no tiene pedidos
+    uint32_t id_destino = cadena_buscar(destino);
+    if (!id_destino && destino[0]) return NULL;
+    Order *cur = node ? node->cabeza_pedidos : NULL;
+    while (cur) {
+        if (cur->cantidad_solicitada == cantidad && cur->destino == id_destino) {
+            return cur;
+        }
+        cur = cur->siguiente;
+    }
+    return NULL;
+}
+
+
+int cancel_order_in_node(Node *node, const char *destino, int cantidad) {
+    // Respaldo cuando no se conoce el ID: localizar por destino y cantidad
+    Order *o = buscar_pedido(node, destino, cantidad);
+    if (!o) return 0;  // Pedido no encontrado
+    quitar_pedido(o);
+    return 1;  // Éxito
+}
+
+
+/**
+ * Motor de reportes
+ *
+ * Los reportes se arman en un buffer grande con conversores propios de enteros
+ * y fechas (sin printf por campo ni el buffer estatico de formatear_fecha) y se
+ * escriben con un solo fwrite por bloque. Formatos: texto (el reporte del
+ * menu), JSON y CSV. Las columnas se eligen con una mascara; con
+ * COLUMNAS_RESUMEN solo se emiten los totales, que salen de los agregados de la
+ * raiz en O(1).
+ */
+#define REPORTE_BUFFER 65536              // Bytes formateados antes de cada fwrite
+#define REPORTE_MAX_CAMPO 32              // Mayor campo numerico o fecha formateado
+
+/**
+ * Estructura SalidaReporte: Buffer de salida de un reporte
+ */
+typedef struct SalidaReporte {
+    FILE *archivo;                    // Destino de los bloques
+    size_t usados;                    // Bytes pendientes de escribir
+    bool error;                       // Fallo alguna escritura
+    char buffer[REPORTE_BUFFER];      // Texto formateado
+} SalidaReporte;
+
+
+void salida_volcar(SalidaReporte *s) {
+    if (s->usados && fwrite(s->buffer, 1, s->usados, s->archivo) != s->usados) s->error = true;
+    s->usados = 0;
+}
+
+
+SalidaReporte* salida_crear(FILE *archivo) {
+    SalidaReporte *s = (SalidaReporte*)malloc(sizeof(SalidaReporte));
+    if (!s) return NULL;
+    s->archivo = archivo;
+    s->usados = 0;
+    s->error = false;
+    return s;
+}
+
+
+bool salida_cerrar(SalidaReporte *s) {
+    // Escribir lo pendiente y liberar; false si alguna escritura fallo
+    salida_volcar(s);
+    bool ok = !s->error;
+    free(s);
+    return ok;
+}
+
+
+char* salida_reservar(SalidaReporte *s, size_t n) {
+    // Espacio contiguo para n bytes (n <= REPORTE_BUFFER)
+    if (s->usados + n > REPORTE_BUFFER) salida_volcar(s);
+    return s->buffer + s->usados;
+}
+
+
+void salida_texto(SalidaReporte *s, const char *t, size_t n) {
+    if (n > REPORTE_BUFFER) {
+        // Mas grande que el buffer: escribirlo directo
+        salida_volcar(s);
+        if (fwrite(t, 1, n, s->archivo) != n) s->error = true;
+        return;
+    }
+    memcpy(salida_reservar(s, n), t, n);
+    s->usados += n;
+}
+
+// Solo para literales de cadena: el largo sale de sizeof
+#define salida_literal(s, lit) salida_texto((s), (lit), sizeof(lit) - 1)
+
+
+void salida_caracter(SalidaReporte *s, char c) {
+    *salida_reservar(s, 1) = c;
+    s->usados++;
+}
+
+
+void salida_cadena(SalidaReporte *s, const char *t) {
+    salida_texto(s, t, strlen(t));
+}
+
+
+void salida_relleno(SalidaReporte *s, int n) {
+    while (n-- > 0) salida_caracter(s, ' ');
+}
+
+
+void salida_entero(SalidaReporte *s, long long v, int ancho) {
+    // ancho > 0 alinea a la derecha y ancho < 0 a la izquierda (como printf)
+    char tmp[REPORTE_MAX_CAMPO];
+    int n = formatear_entero(tmp, v, 0);
+    if (ancho > n) salida_relleno(s, ancho - n);
+    salida_texto(s, tmp, (size_t)n);
+    if (-ancho > n) salida_relleno(s, -ancho - n);
+}
+
+
+void salida_cadena_ancho(SalidaReporte *s, const char *t, int ancho) {
+    // Alineada a la izquierda, sin recortar (como %-Ns)
+    size_t n = strlen(t);
+    salida_texto(s, t, n);
+    if (ancho > (int)n) salida_relleno(s, ancho - (int)n);
+}
+
+
+void salida_fecha(SalidaReporte *s, int fecha, bool iso) {
+    char tmp[REPORTE_MAX_CAMPO];
+    salida_texto(s, tmp, (size_t)formatear_fecha_en(tmp, fecha, iso));
+}
+
+
+void salida_json_cadena(SalidaReporte *s, const char *t) {
+    salida_caracter(s, '"');
+    for (const unsigned char *p = (const unsigned char*)t; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            salida_caracter(s, '\\');
+            salida_caracter(s, (char)*p);
+        } else if (*p < 0x20) {
+            // Caracteres de control como \u00XX
+            const char *hex = "0123456789abcdef";
+            char esc[6] = { '\\', 'u', '0', '0', hex[*p >> 4], hex[*p & 15] };
+            salida_texto(s, esc, sizeof(esc));
+        } else {
+            salida_caracter(s, (char)*p);
+        }
+    }
+    salida_caracter(s, '"');
+}
+
+
+void salida_csv_cadena(SalidaReporte *s, const char *t) {
+    // Entre comillas solo si hace falta; las comillas internas se duplican
+    if (!strpbrk(t, ",\"\r\n")) {
+        salida_cadena(s, t);
+        return;
+    }
+    salida_caracter(s, '"');
+    for (const char *p = t; *p; p++) {
+        if (*p == '"') salida_caracter(s, '"');
+        salida_caracter(s, *p);
+    }
+    salida_caracter(s, '"');
+}
+
+
+void reporte_pedidos_texto(SalidaReporte *s, Node *node) {
+    // Tabla de la cola FIFO del lote (la del reporte de estado)
+    if (!node || !node->cabeza_pedidos) {
+        salida_literal(s, "  No hay pedidos pendientes.\n");
+        return;
+    }
+    salida_literal(s, "  Pedidos pendientes:\n"
+                      "  +-----+------------+----------------------+--------------+\n"
+                      "  | No. | ID         | Destino              | Cantidad     |\n"
+                      "  +-----+------------+----------------------+--------------+\n");
+    int num = 1;
+    for (Order *p = node->cabeza_pedidos; p; p = p->siguiente) {
+        salida_literal(s, "  | ");
+        salida_entero(s, num++, -3);
+        salida_literal(s, " | ");
+        salida_entero(s, p->id, -10);
+        salida_literal(s, " | ");
+        salida_cadena_ancho(s, cadena_texto(p->destino), 20);
+        salida_literal(s, " | ");
+        salida_entero(s, p->cantidad_solicitada, 12);
+        salida_literal(s, " |\n");
+    }
+    salida_literal(s, "  +-----+------------+----------------------+--------------+\n");
+}
+
+
+void reporte_lote_texto(SalidaReporte *s, Node *n, unsigned columnas) {
+    if (columnas & COLUMNA_PRODUCTO) {
+        salida_literal(s, "LOTE: ");
+        salida_cadena(s, cadena_texto(n->producto));
+        salida_caracter(s, '\n');
+    }
+    if (columnas & COLUMNA_FECHA) {
+        salida_literal(s, "Fecha de vencimiento: ");
+        salida_fecha(s, n->fecha_vencimiento, false);
+        salida_caracter(s, '\n');
+    }
+    if (columnas & COLUMNA_STOCK) {
+        salida_literal(s, "Stock disponible: ");
+        salida_entero(s, LEER_CONTADOR(n->stock_total), 0);
+        salida_caracter(s, '\n');
+    }
+    if (columnas & COLUMNA_PEDIDOS) {
+        salida_literal(s, "Pedidos pendientes: ");
+        salida_entero(s, count_orders(n), 0);
+        salida_caracter(s, '\n');
+    }
+    if (columnas & COLUMNA_DETALLE) reporte_pedidos_texto(s, n);
+}
+
+
+void reporte_lote_json(SalidaReporte *s, Node *n, unsigned columnas, bool primero) {
+    salida_cadena(s, primero ? "\n    {" : ",\n    {");
+    const char *sep = "";
+    if (columnas & COLUMNA_FECHA) {
+        salida_literal(s, "\"fecha\":\"");
+        salida_fecha(s, n->fecha_vencimiento, true);
+        salida_caracter(s, '"');
+        sep = ",";
+    }
+    if (columnas & COLUMNA_PRODUCTO) {
+        salida_cadena(s, sep);
+        salida_literal(s, "\"producto\":");
+        salida_json_cadena(s, cadena_texto(n->producto));
+        sep = ",";
+    }
+    if (columnas & COLUMNA_STOCK) {
+        salida_cadena(s, sep);
+        salida_literal(s, "\"stock\":");
+        salida_entero(s, LEER_CONTADOR(n->stock_total), 0);
+        sep = ",";
+    }
+    if (columnas & COLUMNA_PEDIDOS) {
+        salida_cadena(s, sep);
+        salida_literal(s, "\"pedidos\":");
+        salida_entero(s, count_orders(n), 0);
+        sep = ",";
+    }
+    if (columnas & COLUMNA_DETALLE) {
+        salida_cadena(s, sep);
+        salida_literal(s, "\"detalle\":[");
+        for (Order *p = n->cabeza_pedidos; p; p = p->siguiente) {
+            salida_literal(s, "{\"id\":");
+            salida_entero(s, p->id, 0);
+            salida_literal(s, ",\"destino\":");
+            salida_json_cadena(s, cadena_texto(p->destino));
+            salida_literal(s, ",\"cantidad\":");
+            salida_entero(s, p->cantidad_solicitada, 0);
+            salida_cadena(s, p->siguiente ? "}," : "}");
+        }
+        salida_caracter(s, ']');
+    }
+    salida_caracter(s, '}');
+}
+
+
+void reporte_lote_csv_campos(SalidaReporte *s, Node *n, unsigned columnas) {
+    // Columnas del lote, en el orden de la cabecera; cada una termina en coma
+    if (columnas & COLUMNA_FECHA) {
+        salida_fecha(s, n->fecha_vencimiento, true);
+        salida_caracter(s, ',');
+    }
+    if (columnas & COLUMNA_PRODUCTO) {
+        salida_csv_cadena(s, cadena_texto(n->producto));
+        salida_caracter(s, ',');
+    }
+    if (columnas & COLUMNA_STOCK) {
+        salida_entero(s, LEER_CONTADOR(n->stock_total), 0);
+        salida_caracter(s, ',');
+    }
+    if (columnas & COLUMNA_PEDIDOS) {
+        salida_entero(s, count_orders(n), 0);
+        salida_caracter(s, ',');
+    }
+}
+
+
+void salida_terminar_fila(SalidaReporte *s) {
+    // Cambiar la coma final de la fila por el fin de linea
+    if (s->usados && s->buffer[s->usados - 1] == ',') s->usados--;
+    salida_caracter(s, '\n');
+}
+
+
+void reporte_lote_csv(SalidaReporte *s, Node *n, unsigned columnas) {
+    // Con detalle hay una fila por pedido (los lotes sin pedidos dejan esas columnas vacias)
+    if (!(columnas & COLUMNA_DETALLE) || !n->cabeza_pedidos) {
+        reporte_lote_csv_campos(s, n, columnas);
+        if (columnas & COLUMNA_DETALLE) salida_literal(s, ",,,");
+        salida_terminar_fila(s);
+        return;
+    }
+    for (Order *p = n->cabeza_pedidos; p; p = p->siguiente) {
+        reporte_lote_csv_campos(s, n, columnas);
+        salida_entero(s, p->id, 0);
+        salida_caracter(s, ',');
+        salida_csv_cadena(s, cadena_texto(p->destino));
+        salida_caracter(s, ',');
+        salida_entero(s, p->cantidad_solicitada, 0);
+        salida_caracter(s, '\n');
+    }
+}
+
+
+void reporte_totales(SalidaReporte *s, Node *root, FormatoReporte formato) {
+    long long totales[4] = { 0, 0, 0, 0 };
+    if (root) {
+        totales[0] = LEER_CONTADOR(root->lotes_subarbol);
+        totales[1] = LEER_CONTADOR(root->stock_subarbol);
+        totales[2] = LEER_CONTADOR(root->pedidos_subarbol);
+        totales[3] = LEER_CONTADOR(root->pendiente_subarbol);
+    }
+    switch (formato) {
+        case REPORTE_JSON:
+            salida_literal(s, "\"totales\":{\"lotes\":");
+            salida_entero(s, totales[0], 0);
+            salida_literal(s, ",\"stock\":");
+            salida_entero(s, totales[1], 0);
+            salida_literal(s, ",\"pedidos\":");
+            salida_entero(s, totales[2], 0);
+            salida_literal(s, ",\"pendiente\":");
+            salida_entero(s, totales[3], 0);
+            salida_caracter(s, '}');
+            break;
+        case REPORTE_CSV:
+            salida_literal(s, "lotes,stock,pedidos,pendiente\n");
+            for (int i = 0; i < 4; i++) {
+                salida_entero(s, totales[i], 0);
+                salida_caracter(s, i < 3 ? ',' : '\n');
+            }
+            break;
+        default:
+            salida_literal(s, "Lotes: ");
+            salida_entero(s, totales[0], 0);
+            salida_literal(s, " | Stock total: ");
+            salida_entero(s, totales[1], 0);
+            salida_literal(s, " | Pedidos pendientes: ");
+            salida_entero(s, totales[2], 0);
+            salida_literal(s, " (");
+            salida_entero(s, totales[3], 0);
+            salida_literal(s, " unidades)\n");
+            break;
+    }
+}
+
+
+bool reporte_inventario(Node *root, FILE *archivo, FormatoReporte formato, unsigned columnas) {
+    // Recorrido en orden iterativo (fechas mas antiguas primero), memoria O(1)
+    SalidaReporte *s = salida_crear(archivo);
+    if (!s) return false;
+    
+    if (columnas == COLUMNAS_RESUMEN) {
+        if (formato == REPORTE_JSON) salida_caracter(s, '{');
+        reporte_totales(s, root, formato);
+        if (formato == REPORTE_JSON) salida_literal(s, "}\n");
+    } else {
+        if (formato == REPORTE_JSON) salida_literal(s, "{\"lotes\":[");
+        if (formato == REPORTE_CSV) {
+            // Cabecera con las columnas elegidas
+            if (columnas & COLUMNA_FECHA) salida_literal(s, "fecha,");
+            if (columnas & COLUMNA_PRODUCTO) salida_literal(s, "producto,");
+            if (columnas & COLUMNA_STOCK) salida_literal(s, "stock,");
+            if (columnas & COLUMNA_PEDIDOS) salida_literal(s, "pedidos,");
+            if (columnas & COLUMNA_DETALLE) salida_literal(s, "pedido_id,destino,cantidad,");
+            salida_terminar_fila(s);
+        }
+        
+        IteradorInorden it = iterador_inorden(root);
+        Node *n;
+        bool primero = true;
+        while ((n = iterador_siguiente(&it)) != NULL) {
+            bloquear_lote(n);  // Stock y cola pueden cambiar desde otra terminal
+            drenar_entrada(n);
+            if (formato == REPORTE_JSON) reporte_lote_json(s, n, columnas, primero);
+            else if (formato == REPORTE_CSV) reporte_lote_csv(s, n, columnas);
+            else reporte_lote_texto(s, n, columnas);
+            desbloquear_lote(n);
+            primero = false;
+        }
+        
+        if (formato == REPORTE_JSON) {
+            salida_cadena(s, primero ? "],\n  " : "\n  ],\n  ");
+            reporte_totales(s, root, formato);
+            salida_literal(s, "}\n");
+        }
+    }
+    
+    return salida_cerrar(s);
+}
+
+
+void mostrar_pedidos(Node *node) {
+    SalidaReporte *s = salida_crear(stdout);
+    if (!s) return;
+    reporte_pedidos_texto(s, node);
+    salida_cerrar(s);
+}
+
+
+void inorder_report(Node *root) {
+    reporte_inventario(root, stdout, REPORTE_TEXTO, COLUMNAS_TODAS);
+}
+
+
+void vaciar_inventario(void) {
+    // Todos los lotes y pedidos del inventario viven en los pools, asi que
+    // liberar el arbol completo es un reinicio de ambos arenas (sin recorrerlo).
+    // Los bloques quedan reservados para reutilizarse en la siguiente carga.
+    pool_reiniciar(&pool_nodos);
+    pool_reiniciar(&pool_pedidos);
+    indice_vaciar();
+    bmas_vaciar();
+    version_vaciar();
+    productos_vaciar();
+    lote_fefo = NULL;
+}
+
+
+void free_tree(Node *root) {
+    if (!root) return;
+    vaciar_inventario();
+}
+
+
+void liberar_estado_activo(void) {
+    // Memoria propia del arbol activo: pools e indices (no la tabla de cadenas)
+    pool_destruir(&pool_nodos);
+    pool_destruir(&pool_pedidos);
+    bmas_destruir();
+    version_destruir();
+    productos_destruir();
+    indice_destruir();
+}
+
+
+void inventario_destruir(void) {
+    // Devolver al sistema la memoria retenida por pools, indices y tabla de
+    // cadenas (el arbol ya debe estar liberado con free_tree)
+    liberar_estado_activo();
+    cadenas_destruir();
+}
+
+
+#if !defined(VERSIONES) && !defined(INVENTARIO_CONCURRENTE)
+/**
+ * Estructura EstadoInventario: Estado propio de un arbol de lotes
+ *
+ * Varios inventarios independientes (los almacenes de almacenes.c) comparten
+ * la tabla de cadenas y el contador de IDs de pedido, asi un ID no se repite
+ * entre almacenes. Lo demas (pools, indice de pedidos, indices secundarios y
+ * lote FEFO cacheado) es de cada arbol y se intercambia con las globales al
+ * activarlo: unos pocos campos, sin copiar lotes ni pedidos.
+ */
+struct EstadoInventario {
+    Pool nodos;
+    Pool pedidos;
+    IndicePedidos indice;
+    IndiceProductos productos;
+    Node *lote_fefo;
+#ifdef INDICE_BMAS
+    Pool bmas;
+    BMasNodo *bmas_raiz;
+    bool bmas_activo;
+#endif
+};
+
+#define intercambiar(tipo, a, b) do { tipo t_ = (a); (a) = (b); (b) = t_; } while (0)
+
+EstadoInventario* estado_crear(void) {
+    // Estado de un inventario vacio, listo para intercambiarse con el activo
+    EstadoInventario *e = (EstadoInventario*)calloc(1, sizeof(EstadoInventario));
+    if (!e) return NULL;
+    e->nodos = (Pool)POOL_INICIALIZADOR(Node, POOL_NODOS_POR_BLOQUE);
+    e->pedidos = (Pool)POOL_INICIALIZADOR(Order, POOL_PEDIDOS_POR_BLOQUE);
+    e->productos.valido = true;
+#ifdef INDICE_BMAS
+    e->bmas = (Pool)POOL_INICIALIZADOR(BMasNodo, POOL_BMAS_POR_BLOQUE);
+    e->bmas_activo = true;
+#endif
+    return e;
+}
+
+
+void estado_intercambiar(EstadoInventario *e) {
+    // Llamado dos veces con el mismo estado deja todo como estaba
+    intercambiar(Pool, pool_nodos, e->nodos);
+    intercambiar(Pool, pool_pedidos, e->pedidos);
+    intercambiar(IndicePedidos, indice_pedidos, e->indice);
+    intercambiar(IndiceProductos, productos, e->productos);
+    intercambiar(Node*, lote_fefo, e->lote_fefo);
+#ifdef INDICE_BMAS
+    intercambiar(Pool, pool_bmas, e->bmas);
+    intercambiar(BMasNodo*, bmas_raiz, e->bmas_raiz);
+    intercambiar(bool, bmas_activo, e->bmas_activo);
+#endif
+}
+
+
+void estado_destruir(EstadoInventario *e) {
+    // Libera un estado inactivo; sus lotes y pedidos dejan de ser validos
+    if (!e) return;
+    estado_intercambiar(e);
+    liberar_estado_activo();
+    estado_intercambiar(e);
+    free(e);
+}
+#endif
+
+
+#ifdef ESTADISTICAS
+/**
+ * Estructura EstadColas: Longitudes de las colas de pedidos de todos los lotes
+ */
+typedef struct EstadColas {
+    unsigned long long histograma[ESTAD_COLAS];  // Lotes por longitud (0, 1, 2-3, 4-7, ...)
+    long lotes;                       // Lotes recorridos
+    long pedidos;                     // Pedidos en todas las colas
+    int maxima;                       // Cola mas larga actual
+    int fecha_maxima;                 // Lote con la cola mas larga
+} EstadColas;
+
+
+int estad_casillero_cola(int longitud) {
+    // 0 para colas vacias; si no, 1 + floor(log2(longitud))
+    int c = 0;
+    while (longitud > 0 && c < ESTAD_COLAS - 1) {
+        longitud >>= 1;
+        c++;
+    }
+    return c;
+}
+
+
+EstadColas estad_colas(Node *root) {
+    EstadColas e;
+    memset(&e, 0, sizeof(e));
+    IteradorInorden it = iterador_inorden(root);
+    for (Node *n = iterador_siguiente(&it); n; n = iterador_siguiente(&it)) {
+        int largo = LEER_CONTADOR(n->num_pedidos);
+        e.histograma[estad_casillero_cola(largo)]++;
+        e.lotes++;
+        e.pedidos += largo;
+        if (largo > e.maxima) {
+            e.maxima = largo;
+            e.fecha_maxima = n->fecha_vencimiento;
+        }
+    }
+    return e;
+}
+
+
+void estad_persistencia_reporte(const char *nombre, const EstadPersistencia *e) {
+    if (e->cantidad == 0) {
+        printf("  %-10s ninguna\n", nombre);
+        return;
+    }
+    printf("  %-10s %llu | promedio %.3f ms | maximo %.3f ms | %llu bytes\n",
+           nombre, e->cantidad, e->ns_total / 1e6 / e->cantidad, e->ns_max / 1e6, e->bytes);
+}
+
+
+void estadisticas_reporte(Node *root) {
+    printf("\n=== ESTADISTICAS INTERNAS ===\n");
+    printf("Operaciones (rotaciones y reservas de memoria por operacion):\n");
+    for (int op = 0; op < ESTAD_OPERACIONES; op++) {
+        unsigned long long n = estadisticas.operaciones[op];
+        if (n == 0 && estadisticas.rotaciones[op] == 0 && estadisticas.reservas[op] == 0) continue;
+        printf("  %-12s %10llu | rotaciones %10llu (%.2f) | reservas %10llu (%.2f)\n",
+               estad_nombres[op], n, estadisticas.rotaciones[op],
+               n ? (double)estadisticas.rotaciones[op] / n : 0.0, estadisticas.reservas[op],
+               n ? (double)estadisticas.reservas[op] / n : 0.0);
+    }
+    printf("  Bloques pedidos al sistema por los pools: %llu\n", estadisticas.bloques);
+    
+    printf("Busquedas por fecha: %llu (%llu sin resultado)\n", estadisticas.busquedas, estadisticas.fallidas);
+    unsigned long long ponderado = 0;
+    int profundidad_max = 0;
+    for (int d = 0; d < ESTAD_PROFUNDIDADES; d++) {
+        ponderado += estadisticas.profundidad[d] * (unsigned long long)d;
+        if (estadisticas.profundidad[d]) profundidad_max = d;
+    }
+    if (estadisticas.busquedas) {
+        printf("  Nodos visitados: promedio %.2f | maximo %d\n",
+               (double)ponderado / estadisticas.busquedas, profundidad_max);
+        for (int d = 0; d <= profundidad_max; d++) {
+            if (estadisticas.profundidad[d]) printf("    %2d: %llu\n", d, estadisticas.profundidad[d]);
+        }
+    }
+    
+    EstadColas colas = estad_colas(root);
+    printf("Colas de pedidos: %ld lotes, %ld pedidos | mas larga %d", colas.lotes, colas.pedidos, colas.maxima);
+    if (colas.maxima > 0) printf(" (lote %s)", formatear_fecha(colas.fecha_maxima));
+    printf(" | maxima observada %d\n", estadisticas.cola_maxima);
+    for (int c = 0; c < ESTAD_COLAS; c++) {
+        if (!colas.histograma[c]) continue;
+        if (c == 0) printf("    0: %llu lotes\n", colas.histograma[c]);
+        else printf("    %d-%d: %llu lotes\n", 1 << (c - 1), (1 << c) - 1, colas.histograma[c]);
+    }
+    
+    printf("Persistencia:\n");
+    estad_persistencia_reporte("Guardados", &estadisticas.guardados);
+    estad_persistencia_reporte("Cargas", &estadisticas.cargas);
+    estad_persistencia_reporte("Journal", &estadisticas.journal);
+}
+
+
+void estad_volcar_persistencia(FILE *f, const char *nombre, const EstadPersistencia *e) {
+    fprintf(f, "%s.cantidad %llu\n", nombre, e->cantidad);
+    fprintf(f, "%s.ns_total %llu\n", nombre, e->ns_total);
+    fprintf(f, "%s.ns_max %llu\n", nombre, e->ns_max);
+    fprintf(f, "%s.bytes %llu\n", nombre, e->bytes);
+}
+
+
+bool estadisticas_volcar(Node *root, const char *ruta) {
+    // Una metrica por linea, "nombre valor", para procesarlo con herramientas
+    FILE *f = strcmp(ruta, "-") == 0 ? stdout : fopen(ruta, "w");
+    if (!f) return false;
+    for (int op = 0; op < ESTAD_OPERACIONES; op++) {
+        fprintf(f, "operaciones.%s %llu\n", estad_nombres[op], estadisticas.operaciones[op]);
+        fprintf(f, "rotaciones.%s %llu\n", estad_nombres[op], estadisticas.rotaciones[op]);
+        fprintf(f, "reservas.%s %llu\n", estad_nombres[op], estadisticas.reservas[op]);
+    }
+    fprintf(f, "pools.bloques %llu\n", estadisticas.bloques);
+    fprintf(f, "busquedas.total %llu\n", estadisticas.busquedas);
+    fprintf(f, "busquedas.fallidas %llu\n", estadisticas.fallidas);
+    for (int d = 0; d < ESTAD_PROFUNDIDADES; d++) {
+        if (estadisticas.profundidad[d]) fprintf(f, "busquedas.profundidad.%d %llu\n", d, estadisticas.profundidad[d]);
+    }
+    EstadColas colas = estad_colas(root);
+    fprintf(f, "colas.lotes %ld\n", colas.lotes);
+    fprintf(f, "colas.pedidos %ld\n", colas.pedidos);
+    fprintf(f, "colas.maxima %d\n", colas.maxima);
+    fprintf(f, "colas.maxima_fecha %d\n", colas.fecha_maxima);
+    fprintf(f, "colas.maxima_observada %d\n", estadisticas.cola_maxima);
+    for (int c = 0; c < ESTAD_COLAS; c++) {
+        // Clave: longitud minima del casillero
+        if (colas.histograma[c]) fprintf(f, "colas.longitud.%d %llu\n", c ? 1 << (c - 1) : 0, colas.histograma[c]);
+    }
+    estad_volcar_persistencia(f, "guardados", &estadisticas.guardados);
+    estad_volcar_persistencia(f, "cargas", &estadisticas.cargas);
+    estad_volcar_persistencia(f, "journal", &estadisticas.journal);
+    if (f == stdout) return fflush(f) == 0;
+    return fclose(f) == 0;
+}
+#endif
+
+
+#ifdef VERIFICAR
+/**
+ * Verificacion de invariantes (compilar con -DVERIFICAR)
+ *
+ * Recorre el arbol completo y comprueba lo que las optimizaciones no deben
+ * romper: orden por (fecha, secuencia), punteros al padre, alturas y balance
+ * AVL, agregados de cada subarbol, colas FIFO circulares (contadores del lote,
+ * indice por ID, lote de cada pedido), listas por producto y lote FEFO
+ * cacheado. Compara ademas los elementos vivos de los pools con los lotes y
+ * pedidos del arbol, asi una fuga o una doble liberacion se detecta en el
+ * momento. Es O(n) y sin bloqueos: llamarla con el inventario quieto.
+ */
+#define VERIFICAR_MAX_INFORMES 10         // Fallas detalladas por llamada
+
+/**
+ * Estructura Verificacion: Estado de un recorrido de verificar_inventario
+ */
+typedef struct Verificacion {
+    FILE *informe;                    // Donde describir las fallas (NULL: no se describen)
+    int fallas;                       // Invariantes rotos encontrados
+    bool hay_anterior;                // Ya se visito un lote (orden in-order)
+    ClaveLote anterior;               // Clave del ultimo lote visitado
+    long lotes;                       // Lotes recorridos
+    long pedidos;                     // Pedidos en las colas (y entradas) recorridas
+} Verificacion;
+
+
+void verificar_falla(Verificacion *v, const Node *n, const char *que) {
+    if (v->informe && v->fallas < VERIFICAR_MAX_INFORMES) {
+        if (n) fprintf(v->informe, "✗ Lote %d/%u: %s\n", n->fecha_vencimiento, n->secuencia, que);
+        else fprintf(v->informe, "✗ Inventario: %s\n", que);
+    }
+    v->fallas++;
+}
+
+
+void verificar_cola(Verificacion *v, Node *n) {
+    // Cola circular: la cabeza apunta al ultimo, cada pedido a su anterior y
+    // el ultimo termina en NULL; contadores e indice coinciden con lo recorrido
+    long cantidad = 0;
+    long long pendiente = 0;
+    Order *cabeza = n->cabeza_pedidos, *anterior = NULL;
+    for (Order *o = cabeza; o; o = o->siguiente) {
+        if (cantidad > LEER_CONTADOR(n->num_pedidos)) {
+            verificar_falla(v, n, "la cola tiene mas pedidos que num_pedidos (o un ciclo)");
+            return;
+        }
+        if (o != cabeza && o->anterior != anterior) verificar_falla(v, n, "pedido con enlace anterior roto");
+        if (o->lote != n) verificar_falla(v, n, "pedido que apunta a otro lote");
+        if (o->cantidad_solicitada <= 0) verificar_falla(v, n, "pedido con cantidad no positiva");
+        if (o->id == 0 || o->id >= siguiente_id_pedido) verificar_falla(v, n, "pedido con ID fuera de rango");
+        if (buscar_pedido_por_id(o->id) != o) verificar_falla(v, n, "pedido ausente del indice por ID");
+        cantidad++;
+        pendiente += o->cantidad_solicitada;
+        anterior = o;
+    }
+    if (cabeza && cabeza->anterior != anterior) verificar_falla(v, n, "la cabeza no apunta al ultimo pedido");
+#ifdef INVENTARIO_CONCURRENTE
+    // Pedidos publicados aun sin drenar: ya cuentan en el lote y en el indice
+    for (Order *o = n->entrada_pedidos; o; o = o->siguiente) {
+        if (cantidad > LEER_CONTADOR(n->num_pedidos)) break;
+        if (o->lote != n) verificar_falla(v, n, "pedido de la entrada que apunta a otro lote");
+        cantidad++;
+        pendiente += o->cantidad_solicitada;
+    }
+#endif
+    if (cantidad != LEER_CONTADOR(n->num_pedidos)) verificar_falla(v, n, "num_pedidos no coincide con la cola");
+    if (pendiente != LEER_CONTADOR(n->cantidad_pendiente)) verificar_falla(v, n, "cantidad_pendiente no coincide con la cola");
+    v->pedidos += cantidad;
+}
+
+
+void verificar_producto(Verificacion *v, Node *n) {
+    // Lista doble del producto en orden de vencimiento
+    Node *sig = n->producto_siguiente, *ant = n->producto_anterior;
+    if (sig && (sig->producto_anterior != n || sig->producto != n->producto || clave_de(sig) <= clave_de(n))) {
+        verificar_falla(v, n, "lista del producto rota hacia adelante");
+    }
+    if (ant && (ant->producto_siguiente != n || ant->producto != n->producto)) {
+        verificar_falla(v, n, "lista del producto rota hacia atras");
+    }
+    if (!ant && (n->producto >= productos.capacidad || productos.entradas[n->producto].primero != n)) {
+        verificar_falla(v, n, "primer lote del producto fuera de su entrada");
+    }
+}
+
+
+int verificar_subarbol(Verificacion *v, Node *n, Node *padre) {
+    // Devuelve la altura real del subarbol (in-order: izquierda, nodo, derecha)
+    if (!n) return 0;
+    if (v->lotes > (long)pool_nodos.vivos + 1) return 0;  // Ciclo: ya se informara por los pools
+    if (n->parent != padre) verificar_falla(v, n, "puntero al padre incorrecto");
+    int hi = verificar_subarbol(v, n->left, n);
+
+    if (v->hay_anterior && clave_de(n) <= v->anterior) verificar_falla(v, n, "fuera de orden por (fecha, secuencia)");
+    v->hay_anterior = true;
+    v->anterior = clave_de(n);
+    v->lotes++;
+    if (LEER_CONTADOR(n->stock_total) < 0) verificar_falla(v, n, "stock negativo");
+    verificar_cola(v, n);
+    if (productos.valido) verificar_producto(v, n);
+#ifdef INDICE_BMAS
+    if (bmas_activo && bmas_buscar(clave_de(n)) != n) verificar_falla(v, n, "ausente del indice B+");
+#endif
+
+    int hd = verificar_subarbol(v, n->right, n);
+    int h = 1 + (hi > hd ? hi : hd);
+    if (n->height != h) verificar_falla(v, n, "altura guardada incorrecta");
+    if (hi - hd > 1 || hd - hi > 1) verificar_falla(v, n, "desbalanceado (AVL)");
+
+    // Agregados: se comparan con los de los hijos ya verificados
+    Node *l = n->left, *r = n->right;
+    if (n->lotes_subarbol != 1 + (l ? l->lotes_subarbol : 0) + (r ? r->lotes_subarbol : 0) ||
+        LEER_CONTADOR(n->stock_subarbol) != LEER_CONTADOR(n->stock_total) + (l ? l->stock_subarbol : 0) + (r ? r->stock_subarbol : 0) ||
+        LEER_CONTADOR(n->pedidos_subarbol) != LEER_CONTADOR(n->num_pedidos) + (l ? l->pedidos_subarbol : 0) + (r ? r->pedidos_subarbol : 0) ||
+        LEER_CONTADOR(n->pendiente_subarbol) != LEER_CONTADOR(n->cantidad_pendiente) + (l ? l->pendiente_subarbol : 0) + (r ? r->pendiente_subarbol : 0)) {
+        verificar_falla(v, n, "agregados del subarbol desactualizados");
+    }
+    return h;
+}
+
+
+bool verificar_inventario(Node *root, FILE *informe) {
+    Verificacion v = { informe, 0, false, 0, 0, 0 };
+    if (root && root->parent) verificar_falla(&v, root, "la raiz tiene padre");
+    verificar_subarbol(&v, root, root ? root->parent : NULL);
+
+    if (lote_fefo != lote_minimo(root)) verificar_falla(&v, NULL, "lote FEFO cacheado distinto del minimo");
+    if ((size_t)v.pedidos != indice_pedidos.cantidad) verificar_falla(&v, NULL, "el indice por ID no tiene los mismos pedidos que las colas");
+    if (pool_nodos.vivos != v.lotes) verificar_falla(&v, NULL, "el pool de lotes no coincide con el arbol (fuga o doble liberacion)");
+    if (pool_pedidos.vivos != v.pedidos) verificar_falla(&v, NULL, "el pool de pedidos no coincide con las colas (fuga o doble liberacion)");
+    if (informe && v.fallas > VERIFICAR_MAX_INFORMES) {
+        fprintf(informe, "✗ ... y %d fallas mas\n", v.fallas - VERIFICAR_MAX_INFORMES);
+    }
+    return v.fallas == 0;
+}
+
+
+ContadoresMemoria contadores_memoria(void) {
+    ContadoresMemoria c;
+    c.lotes_vivos = pool_nodos.vivos;
+    c.pedidos_vivos = pool_pedidos.vivos;
+    c.reservas_lotes = pool_nodos.reservas;
+    c.reservas_pedidos = pool_pedidos.reservas;
+    return c;
+}
+#endif
+
+
+/**
+ * Formato binario del inventario (instantanea, version 3)
+ *
+ * [SnapshotCabecera][SnapshotNodo x num_nodos][SnapshotPedido x num_pedidos][cadenas]
+ *
+ * Los lotes se guardan en orden (in-order) en un arreglo plano y los pedidos de
+ * cada lote son consecutivos en el arreglo de pedidos. Los nombres se guardan una
+ * sola vez, terminados en '\0', en la tabla de cadenas y se referencian por
+ * desplazamiento: todos los lotes y pedidos con el mismo nombre comparten el
+ * mismo desplazamiento. Enteros en el orden de bytes nativo de la maquina.
+ */
+#define SNAPSHOT_MAGIA "AVLI"
+#define SNAPSHOT_VERSION 3
+
+typedef struct SnapshotNodo {
+    int32_t fecha_vencimiento;        // Clave del lote (AAAAMMDD)
+    uint32_t secuencia;               // Desempate entre lotes de la misma fecha
+    int32_t stock_total;              // Stock disponible (ya descontados los pedidos)
+    uint32_t producto;                // Desplazamiento del nombre en la tabla de cadenas
+    uint32_t primer_pedido;           // Indice del primer pedido del lote
+    uint32_t num_pedidos;             // Pedidos del lote
+} SnapshotNodo;
+
+typedef struct SnapshotPedido {
+    uint32_t id;                      // ID del pedido
+    uint32_t destino;                 // Desplazamiento del destino en la tabla de cadenas
+    int32_t cantidad_solicitada;      // Cantidad del pedido
+} SnapshotPedido;
+
+/**
+ * Estructura SnapshotEscritor: Cursores de escritura sobre el buffer de salida
+ */
+typedef struct SnapshotEscritor {
+    SnapshotNodo *nodos;
+    SnapshotPedido *pedidos;
+    char *cadenas;
+    uint32_t n_nodos, n_pedidos, n_cadenas;
+    uint32_t *ubicacion;              // Por ID de cadena: desplazamiento + 1 (0 = aun no escrita)
+} SnapshotEscritor;
+
+
+uint32_t snapshot_medir_cadena(uint32_t *vista, uint32_t id) {
+    // Bytes que agrega la cadena a la tabla: solo cuenta su primera aparicion
+    if (vista[id]) return 0;
+    vista[id] = 1;
+    return (uint32_t)strlen(cadena_texto(id)) + 1;
+}
+
+
+void snapshot_contar(Node *root, SnapshotCabecera *cab, uint32_t *vista) {
+    IteradorInorden it = iterador_inorden(root);
+    Node *n;
+    while ((n = iterador_siguiente(&it)) != NULL) {
+        cab->num_nodos++;
+        cab->tam_cadenas += snapshot_medir_cadena(vista, n->producto);
+        for (Order *p = n->cabeza_pedidos; p; p = p->siguiente) {
+            cab->num_pedidos++;
+            cab->tam_cadenas += snapshot_medir_cadena(vista, p->destino);
+        }
+    }
+}
+
+
+uint32_t snapshot_agregar_cadena(SnapshotEscritor *w, uint32_t id) {
+    // Las siguientes apariciones del mismo nombre reutilizan su desplazamiento
+    if (w->ubicacion[id]) return w->ubicacion[id] - 1;
+    uint32_t desplazamiento = w->n_cadenas;
+    const char *s = cadena_texto(id);
+    size_t len = strlen(s) + 1;       // Incluir el terminador
+    memcpy(w->cadenas + desplazamiento, s, len);
+    w->n_cadenas += (uint32_t)len;
+    w->ubicacion[id] = desplazamiento + 1;
+    return desplazamiento;
+}
+
+
+void snapshot_volcar(Node *root, SnapshotEscritor *w) {
+    IteradorInorden it = iterador_inorden(root);
+    Node *n;
+    while ((n = iterador_siguiente(&it)) != NULL) {
+        // Registro plano del lote; sus pedidos quedan a continuacion de los del lote anterior
+        SnapshotNodo *r = &w->nodos[w->n_nodos++];
+        r->fecha_vencimiento = n->fecha_vencimiento;
+        r->secuencia = n->secuencia;
+        r->stock_total = n->stock_total;
+        r->producto = snapshot_agregar_cadena(w, n->producto);
+        r->primer_pedido = w->n_pedidos;
+        for (Order *p = n->cabeza_pedidos; p; p = p->siguiente) {
+            SnapshotPedido *rp = &w->pedidos[w->n_pedidos++];
+            rp->id = p->id;
+            rp->destino = snapshot_agregar_cadena(w, p->destino);
+            rp->cantidad_solicitada = p->cantidad_solicitada;
+        }
+        r->num_pedidos = w->n_pedidos - r->primer_pedido;
+    }
+}
+
+
+void snapshot_iniciar_cabecera(SnapshotCabecera *cab, uint32_t siguiente_id) {
+    memset(cab, 0, sizeof(*cab));
+    memcpy(cab->magia, SNAPSHOT_MAGIA, sizeof(cab->magia));
+    cab->version = SNAPSHOT_VERSION;
+    cab->siguiente_id = siguiente_id;
+}
+
+
+char* snapshot_preparar(const SnapshotCabecera *cab, SnapshotEscritor *w, size_t *tam,
+                        uint32_t *vista, uint32_t num_cadenas) {
+    // Reservar el archivo completo ya dimensionado y ubicar los cursores de
+    // escritura. La vista del conteo pasa a guardar los desplazamientos
+    size_t tam_nodos = (size_t)cab->num_nodos * sizeof(SnapshotNodo);
+    size_t tam_pedidos = (size_t)cab->num_pedidos * sizeof(SnapshotPedido);
+    *tam = sizeof(*cab) + tam_nodos + tam_pedidos + cab->tam_cadenas;
+    
+    char *buffer = (char*)malloc(*tam);
+    if (!buffer) return NULL;
+    w->nodos = (SnapshotNodo*)(buffer + sizeof(*cab));
+    w->pedidos = (SnapshotPedido*)(buffer + sizeof(*cab) + tam_nodos);
+    w->cadenas = buffer + sizeof(*cab) + tam_nodos + tam_pedidos;
+    w->n_nodos = w->n_pedidos = w->n_cadenas = 0;
+    memset(vista, 0, num_cadenas * sizeof(uint32_t));
+    w->ubicacion = vista;
+    return buffer;
+}
+
+
+bool snapshot_escribir(char *buffer, size_t tam, SnapshotCabecera *cab, const char *ruta) {
+    // Sellar la cabecera con el checksum y escribir el buffer (que se libera)
+    cab->checksum = checksum_fnv1a(buffer + sizeof(*cab), tam - sizeof(*cab));
+    memcpy(buffer, cab, sizeof(*cab));
+    
+    FILE *f = fopen(ruta, "wb");
+    if (!f) {
+        free(buffer);
+        return false;
+    }
+    bool ok = fwrite(buffer, 1, tam, f) == tam;
+    ok = (fclose(f) == 0) && ok;
+    free(buffer);
+    if (!ok) remove(ruta);
+    return ok;
+}
+
+
+bool guardar_arbol(Node *root, const char *filename) {
+    uint64_t inicio = estad_reloj();
+    // Primera pasada: dimensionar el archivo completo
+    uint32_t num_cadenas = cadenas_cantidad();
+    uint32_t *vista = (uint32_t*)calloc(num_cadenas, sizeof(uint32_t));
+    if (!vista) return false;
+    SnapshotCabecera cab;
+    snapshot_iniciar_cabecera(&cab, siguiente_id_pedido);
+    snapshot_contar(root, &cab, vista);
+    
+    SnapshotEscritor w;
+    size_t tam;
+    char *buffer = snapshot_preparar(&cab, &w, &tam, vista, num_cadenas);
+    if (!buffer) {
+        free(vista);
+        return false;
+    }
+    
+    // Segunda pasada: llenar los arreglos planos y la tabla de cadenas
+    snapshot_volcar(root, &w);
+    free(vista);
+    
+    // Escribir en un temporal y renombrar: un fallo a mitad no corrompe el inventario anterior
+    char temporal[512];
+    snprintf(temporal, sizeof(temporal), "%s.tmp", filename);
+    if (!snapshot_escribir(buffer, tam, &cab, temporal)) return false;
+    if (rename(temporal, filename) != 0) {
+        remove(temporal);
+        return false;
+    }
+    estad_guardado(inicio, tam);
+    return true;
+}
+
+
+void* mapear_archivo(const char *filename, size_t *tam) {
+    *tam = 0;
+#ifdef _WIN32
+    // Sin mmap: leer el archivo completo en memoria
+    FILE *f = fopen(filename, "rb");
+    if (!f) return NULL;
+    if (fseek(f, 0, SEEK_END) != 0) { fclose(f); return NULL; }
+    long largo = ftell(f);
+    rewind(f);
+    if (largo <= 0) { fclose(f); return NULL; }
+    void *datos = malloc((size_t)largo);
+    if (datos && fread(datos, 1, (size_t)largo, f) != (size_t)largo) {
+        free(datos);
+        datos = NULL;
+    }
+    fclose(f);
+    if (datos) *tam = (size_t)largo;
+    return datos;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    void *datos = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // El mapeo sigue siendo valido sin el descriptor
+    if (datos == MAP_FAILED) return NULL;
+    *tam = (size_t)st.st_size;
+    return datos;
+#endif
+}
+
+
+void desmapear_archivo(void *datos, size_t tam) {
+    if (!datos) return;
+#ifdef _WIN32
+    (void)tam;
+    free(datos);
+#else
+    munmap(datos, tam);
+#endif
+}
+
+
+bool snapshot_validar(const char *datos, size_t tam) {
+    if (tam < sizeof(SnapshotCabecera)) return false;
+    
+    SnapshotCabecera cab;
+    memcpy(&cab, datos, sizeof(cab));
+    if (memcmp(cab.magia, SNAPSHOT_MAGIA, sizeof(cab.magia)) != 0) return false;
+    if (cab.version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Error: Version de inventario no soportada (%u).\n", cab.version);
+        return false;
+    }
+    
+    // Verificar que los tamanos declarados coincidan con el archivo
+    size_t esperado = sizeof(cab) + (size_t)cab.num_nodos * sizeof(SnapshotNodo) +
+                      (size_t)cab.num_pedidos * sizeof(SnapshotPedido) + cab.tam_cadenas;
+    if (esperado != tam) return false;
+    if (checksum_fnv1a(datos + sizeof(cab), tam - sizeof(cab)) != cab.checksum) {
+        fprintf(stderr, "Error: El inventario esta corrupto (checksum invalido).\n");
+        return false;
+    }
+    
+    // Verificar referencias y orden de las claves en una pasada lineal
+    const SnapshotNodo *nodos = (const SnapshotNodo*)(datos + sizeof(cab));
+    const SnapshotPedido *pedidos = (const SnapshotPedido*)(nodos + cab.num_nodos);
+    const char *cadenas = (const char*)(pedidos + cab.num_pedidos);
+    if (cab.tam_cadenas > 0 && cadenas[cab.tam_cadenas - 1] != '\0') return false;
+    
+    uint32_t siguiente_pedido = 0;
+    for (uint32_t i = 0; i < cab.num_nodos; i++) {
+        const SnapshotNodo *r = &nodos[i];
+        if (i > 0 && clave_de(r) <= clave_de(&nodos[i - 1])) return false;
+        if (r->producto >= cab.tam_cadenas) return false;
+        if (r->primer_pedido != siguiente_pedido || r->num_pedidos > cab.num_pedidos - siguiente_pedido) return false;
+        siguiente_pedido += r->num_pedidos;
+    }
+    if (siguiente_pedido != cab.num_pedidos) return false;
+    for (uint32_t i = 0; i < cab.num_pedidos; i++) {
+        if (pedidos[i].destino >= cab.tam_cadenas) return false;
+        if (pedidos[i].id == 0 || pedidos[i].id >= cab.siguiente_id) return false;
+    }
+    return true;
+}
+
+
+uint32_t snapshot_cadena(const char *cadenas, uint32_t *ids, uint32_t desplazamiento) {
+    // ID interno del nombre guardado en el desplazamiento; ids (desplazamiento ->
+    // ID + 1) evita volver a internar el mismo nombre en cada referencia
+    if (!ids) return cadena_internar(cadenas + desplazamiento);
+    if (!ids[desplazamiento]) ids[desplazamiento] = cadena_internar(cadenas + desplazamiento) + 1;
+    return ids[desplazamiento] - 1;
+}
+
+
+Node* snapshot_construir(const SnapshotNodo *nodos, const SnapshotPedido *pedidos,
+                         const char *cadenas, uint32_t *ids, long lo, long hi, bool *fallo) {
+    // Sin memoria marca *fallo y deja de armar: el llamador descarta la carga
+    // entera (un arbol a medias no debe pasar por completo ni compactarse)
+    if (lo > hi || *fallo) return NULL;
+    long mid = lo + (hi - lo) / 2;
+    
+    // Los nodos se crean en orden (izquierda, centro, derecha): el archivo se
+    // lee de forma secuencial y el arbol resultante queda perfectamente balanceado
+    Node *left = snapshot_construir(nodos, pedidos, cadenas, ids, lo, mid - 1, fallo);
+    if (*fallo) return NULL;
+    
+    const SnapshotNodo *r = &nodos[mid];
+    Node *n = newNode(r->fecha_vencimiento, snapshot_cadena(cadenas, ids, r->producto), r->stock_total);
+    if (!n) {
+        *fallo = true;
+        return NULL;
+    }
+    n->secuencia = r->secuencia;
+    for (uint32_t i = 0; i < r->num_pedidos; i++) {
+        const SnapshotPedido *rp = &pedidos[r->primer_pedido + i];
+        // El stock guardado ya tiene descontados los pedidos: no se ajusta
+        if (!encolar_pedido(n, snapshot_cadena(cadenas, ids, rp->destino), rp->cantidad_solicitada, rp->id)) {
+            *fallo = true;
+            return NULL;
+        }
+    }
+    
+    n->left = left;
+    n->right = snapshot_construir(nodos, pedidos, cadenas, ids, mid + 1, hi, fallo);
+    if (n->left) n->left->parent = n;
+    if (n->right) n->right->parent = n;
+    lote_actualizar(n);
+    return n;
+}
+
+
+#ifdef CARGA_PARALELA
+/*
+ * Carga paralela de la instantanea (compilar con -DCARGA_PARALELA -pthread)
+ *
+ * El arreglo de lotes esta ordenado y los pedidos de cada lote son
+ * consecutivos, asi que el rango [lo, hi] de un subarbol ya da su ubicacion en
+ * el archivo (sus pedidos empiezan en nodos[lo].primer_pedido) sin cambiar el
+ * formato. Los primeros niveles del arbol balanceado parten el arreglo en
+ * tramos que arman hilos distintos, cada uno en pools propios; el hilo
+ * principal une despues las cimas, que son pocos lotes, y pasa los bloques de
+ * los pools de los tramos a los globales. Los nombres se internan antes, en
+ * serie, y los pedidos se indexan desde los hilos sobre un indice ya
+ * dimensionado (insercion atomica en la cabeza de cada bucket).
+ */
+#define CARGA_PARALELA_MINIMO 16384       // Con menos lotes se arma en serie
+#define CARGA_TRAMOS_POR_HILO 4           // Tramos por hilo, para repartir parejo
+#define CARGA_MAX_TRAMOS 256
+
+int hilos_carga = 0;                      // 0: uno por nucleo
+
+/**
+ * Estructura TramoCarga: Subarbol [lo, hi] que arma un hilo en sus propios pools
+ */
+typedef struct TramoCarga {
+    long lo, hi;
+    Node *raiz;                       // Subarbol armado
+    Pool nodos;
+    Pool pedidos;
+    size_t indexados;                 // Pedidos agregados al indice
+    bool fallo;                       // Falto memoria: el tramo quedo incompleto
+} TramoCarga;
+
+/**
+ * Estructura CargaParalela: Instantanea compartida (solo lectura) y tramos
+ */
+typedef struct CargaParalela {
+    const SnapshotNodo *nodos;
+    const SnapshotPedido *pedidos;
+    const char *cadenas;
+    const uint32_t *ids;              // Desplazamiento -> ID + 1, resuelto antes
+    TramoCarga tramos[CARGA_MAX_TRAMOS];
+    int num_tramos;
+    int siguiente;                    // Proximo tramo sin tomar (acceso atomico)
+    int consumidos;                   // Tramos ya unidos por la cima
+    bool fallo;                       // Falto memoria al unir la cima
+} CargaParalela;
+
+#ifndef _WIN32
+pthread_mutex_t bloqueo_carga_cadenas = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+void configurar_hilos_carga(int hilos) {
+    hilos_carga = hilos > 0 ? hilos : 0;
+}
+
+
+int carga_hilos_disponibles(void) {
+#ifdef _WIN32
+    return 1;
+#else
+    if (hilos_carga > 0) return hilos_carga;
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    return nucleos > 0 ? (int)nucleos : 1;
+#endif
+}
+
+
+uint32_t carga_cadena(const CargaParalela *c, uint32_t desplazamiento) {
+    // Los inicios de nombre ya estan resueltos; un desplazamiento a mitad de un
+    // nombre (valido, aunque guardar_arbol no lo genera) se interna con bloqueo
+    uint32_t id = c->ids[desplazamiento];
+    if (id) return id - 1;
+#ifndef _WIN32
+    pthread_mutex_lock(&bloqueo_carga_cadenas);
+#endif
+    id = cadena_internar(c->cadenas + desplazamiento);
+#ifndef _WIN32
+    pthread_mutex_unlock(&bloqueo_carga_cadenas);
+#endif
+    return id;
+}
+
+
+void carga_indexar(Order *o) {
+    // El indice ya tiene capacidad: solo se empuja en la cabeza del bucket
+    Order **cabeza = &indice_pedidos.buckets[indice_bucket(o->id, indice_pedidos.capacidad)];
+    Order *actual = __atomic_load_n(cabeza, __ATOMIC_RELAXED);
+    do {
+        o->siguiente_hash = actual;
+    } while (!__atomic_compare_exchange_n(cabeza, &actual, o, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+Node* carga_construir_tramo(const CargaParalela *c, TramoCarga *t, long lo, long hi) {
+    // Igual que snapshot_construir, sobre los pools del tramo (sin memoria
+    // marca t->fallo y deja de armar)
+    if (lo > hi || t->fallo) return NULL;
+    long mid = lo + (hi - lo) / 2;
+    Node *left = carga_construir_tramo(c, t, lo, mid - 1);
+    if (t->fallo) return NULL;
+    
+    const SnapshotNodo *r = &c->nodos[mid];
+    Node *n = crear_nodo_en(&t->nodos, r->fecha_vencimiento, carga_cadena(c, r->producto), r->stock_total);
+    if (!n) {
+        t->fallo = true;
+        return NULL;
+    }
+    n->secuencia = r->secuencia;
+    for (uint32_t i = 0; i < r->num_pedidos; i++) {
+        const SnapshotPedido *rp = &c->pedidos[r->primer_pedido + i];
+        Order *o = (Order*)pool_reservar(&t->pedidos);
+        if (!o) {
+            fprintf(stderr, "Error: No se pudo asignar memoria para el pedido.\n");
+            t->fallo = true;
+            return NULL;
+        }
+        o->destino = carga_cadena(c, rp->destino);
+        o->cantidad_solicitada = rp->cantidad_solicitada;
+        o->id = rp->id;
+        o->lote = n;
+        cola_agregar(n, o);
+        n->num_pedidos++;
+        n->cantidad_pendiente += rp->cantidad_solicitada;
+        carga_indexar(o);
+        t->indexados++;
+    }
+    
+    n->left = left;
+    n->right = carga_construir_tramo(c, t, mid + 1, hi);
+    if (n->left) n->left->parent = n;
+    if (n->right) n->right->parent = n;
+    lote_actualizar(n);
+    return n;
+}
+
+
+void carga_partir(CargaParalela *c, long lo, long hi, int niveles) {
+    // Tramos en el mismo orden en que carga_unir_cima los consume
+    if (lo > hi) return;
+    if (niveles == 0) {
+        TramoCarga *t = &c->tramos[c->num_tramos++];
+        t->lo = lo;
+        t->hi = hi;
+        return;
+    }
+    long mid = lo + (hi - lo) / 2;
+    carga_partir(c, lo, mid - 1, niveles - 1);
+    carga_partir(c, mid + 1, hi, niveles - 1);
+}
+
+
+Node* carga_unir_cima(CargaParalela *c, long lo, long hi, int niveles) {
+    // Los lotes de la cima se crean en el hilo principal, con el camino normal
+    if (lo > hi || c->fallo) return NULL;
+    if (niveles == 0) return c->tramos[c->consumidos++].raiz;
+    long mid = lo + (hi - lo) / 2;
+    Node *left = carga_unir_cima(c, lo, mid - 1, niveles - 1);
+    
+    const SnapshotNodo *r = &c->nodos[mid];
+    Node *n = newNode(r->fecha_vencimiento, carga_cadena(c, r->producto), r->stock_total);
+    Node *right = carga_unir_cima(c, mid + 1, hi, niveles - 1);
+    if (!n) c->fallo = true;
+    if (c->fallo) return NULL;
+    n->secuencia = r->secuencia;
+    for (uint32_t i = 0; i < r->num_pedidos; i++) {
+        const SnapshotPedido *rp = &c->pedidos[r->primer_pedido + i];
+        if (!encolar_pedido(n, carga_cadena(c, rp->destino), rp->cantidad_solicitada, rp->id)) {
+            c->fallo = true;
+            return NULL;
+        }
+    }
+    n->left = left;
+    n->right = right;
+    if (n->left) n->left->parent = n;
+    if (n->right) n->right->parent = n;
+    lote_actualizar(n);
+    return n;
+}
+
+
+void* carga_hilo(void *arg) {
+    // Cada hilo toma el proximo tramo libre hasta agotarlos
+    CargaParalela *c = (CargaParalela*)arg;
+    int i;
+    while ((i = __atomic_fetch_add(&c->siguiente, 1, __ATOMIC_RELAXED)) < c->num_tramos) {
+        TramoCarga *t = &c->tramos[i];
+        t->raiz = carga_construir_tramo(c, t, t->lo, t->hi);
+    }
+    return NULL;
+}
+
+
+bool snapshot_construir_paralelo(const SnapshotCabecera *cab, const SnapshotNodo *nodos,
+                                 const SnapshotPedido *pedidos, const char *cadenas,
+                                 uint32_t *ids, Node **root, bool *fallo) {
+    // false, sin haber tocado nada, si no conviene (o no se puede) repartir.
+    // Si falta memoria en un tramo o en la cima marca *fallo: los pools ya
+    // tienen todo lo armado y el llamador descarta la carga
+    int hilos = carga_hilos_disponibles();
+    if (hilos < 2 || cab->num_nodos < CARGA_PARALELA_MINIMO) return false;
+    
+    // Niveles de la cima: al menos CARGA_TRAMOS_POR_HILO tramos por hilo
+    int niveles = 0;
+    while ((1L << niveles) < (long)hilos * CARGA_TRAMOS_POR_HILO &&
+           (2L << niveles) <= CARGA_MAX_TRAMOS) {
+        niveles++;
+    }
+    
+    // Indice de pedidos con lugar para todos: los hilos no lo hacen crecer
+    while (indice_pedidos.capacidad < indice_pedidos.cantidad + cab->num_pedidos) {
+        if (!indice_crecer()) return false;
+    }
+    CargaParalela *c = (CargaParalela*)calloc(1, sizeof(CargaParalela));
+    if (!c) return false;
+    
+    // Internar en serie cada nombre de la tabla (todos empiezan tras un '\0')
+    for (uint32_t d = 0; d < cab->tam_cadenas; d += (uint32_t)strlen(cadenas + d) + 1) {
+        ids[d] = cadena_internar(cadenas + d) + 1;
+    }
+    c->nodos = nodos;
+    c->pedidos = pedidos;
+    c->cadenas = cadenas;
+    c->ids = ids;
+    carga_partir(c, 0, (long)cab->num_nodos - 1, niveles);
+    for (int i = 0; i < c->num_tramos; i++) {
+        c->tramos[i].nodos = (Pool)POOL_INICIALIZADOR(Node, POOL_NODOS_POR_BLOQUE);
+        c->tramos[i].pedidos = (Pool)POOL_INICIALIZADOR(Order, POOL_PEDIDOS_POR_BLOQUE);
+    }
+    
+    // Los bloques de reserva de los pools globales no se usarian: devolverlos
+    pool_recortar(&pool_nodos);
+    pool_recortar(&pool_pedidos);
+    
+    // El hilo actual tambien arma tramos
+#ifndef _WIN32
+    if (hilos > c->num_tramos) hilos = c->num_tramos;
+    pthread_t extra[CARGA_MAX_TRAMOS];
+    int lanzados = 0;
+    while (lanzados + 1 < hilos && pthread_create(&extra[lanzados], NULL, carga_hilo, c) == 0) {
+        lanzados++;
+    }
+    carga_hilo(c);
+    for (int k = 0; k < lanzados; k++) pthread_join(extra[k], NULL);
+#else
+    carga_hilo(c);
+#endif
+    
+    for (int i = 0; i < c->num_tramos; i++) {
+        pool_absorber(&pool_nodos, &c->tramos[i].nodos);
+        pool_absorber(&pool_pedidos, &c->tramos[i].pedidos);
+        indice_pedidos.cantidad += c->tramos[i].indexados;
+        if (c->tramos[i].fallo) c->fallo = true;
+    }
+    *root = carga_unir_cima(c, 0, (long)cab->num_nodos - 1, niveles);
+    if (c->fallo) {
+        *fallo = true;
+        *root = NULL;
+    }
+    free(c);
+    return true;
+}
+#endif
+
+
+Node* cargar_nodo_legado(FILE *file, bool *fallo) {
+    // Formato anterior: un registro truncado o sin memoria marca *fallo y el
+    // llamador descarta la carga entera (no se devuelve un subarbol a medias)
+    int fecha;
+    if (fread(&fecha, sizeof(int), 1, file) != 1) {
+        *fallo = true;
+        return NULL;
+    }
+    
+    if (fecha == -1) return NULL;  // Marcador de fin de nodo
+    
+    char producto[MAX_NAME];
+    int stock;
+    
+    // Leer datos del nodo
+    if (fread(producto, sizeof(char), MAX_NAME, file) != MAX_NAME ||
+        fread(&stock, sizeof(int), 1, file) != 1) {
+        *fallo = true;
+        return NULL;
+    }
+    
+    // Crear nodo con los datos leidos
+    producto[MAX_NAME-1] = '\0';
+    Node *n = newNode(fecha, cadena_internar(producto), stock);
+    if (!n) {
+        *fallo = true;
+        return NULL;
+    }
+    
+    // Cargar numero de pedidos
+    int num_pedidos;
+    if (fread(&num_pedidos, sizeof(int), 1, file) != 1) {
+        *fallo = true;
+        return NULL;
+    }
+    
+    // Cargar cada pedido y reconstruir la cola FIFO
+    for (int i = 0; i < num_pedidos; i++) {
+        char destino[MAX_DEST];
+        int cantidad;
+        if (fread(destino, sizeof(char), MAX_DEST, file) != MAX_DEST ||
+            fread(&cantidad, sizeof(int), 1, file) != 1) {
+            *fallo = true;
+            return NULL;
+        }
+        // El stock guardado ya tenia descontados los pedidos: no se vuelve a
+        // restar, y sin pasar por limite_desalojar (una carga no despacha)
+        destino[MAX_DEST-1] = '\0';
+        if (!encolar_pedido(n, cadena_internar(destino), cantidad, 0)) {
+            *fallo = true;
+            return NULL;
+        }
+    }
+    
+    // Cargar subarboles recursivamente (pre-order)
+    n->left = cargar_nodo_legado(file, fallo);
+    if (!*fallo) n->right = cargar_nodo_legado(file, fallo);
+    if (n->left) n->left->parent = n;
+    if (n->right) n->right->parent = n;
+    
+    // Actualizar altura y agregados del nodo
+    lote_actualizar(n);
+    
+    return n;
+}
+
+
+Node* cargar_arbol_legado(const char *filename, bool *fallo) {
+    // Formato anterior (pre-order con marcadores -1), todo o nada: *fallo
+    // distingue un archivo incompleto de uno que guardo un inventario vacio
+    *fallo = false;
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        *fallo = true;
+        return NULL;
+    }
+    version_pausar();  // La imagen se arma entera al final
+    Node *root = cargar_nodo_legado(f, fallo);
+    if (!*fallo && fgetc(f) != EOF) *fallo = true;  // Datos de mas tras el ultimo marcador
+    version_reanudar();
+    fclose(f);
+    if (*fallo) {
+        // Los lotes y pedidos ya armados quedan en los pools: reiniciarlos
+        vaciar_inventario();
+        fprintf(stderr, "Error: '%s' esta incompleto o danado; no se cargo.\n", filename);
+        return NULL;
+    }
+    bmas_reconstruir(root);
+    version_reconstruir(root);
+    productos_reconstruir(root);
+    actualizar_lote_fefo(root);
+    return root;
+}
+
+
+Node* cargar_arbol(const char *filename) {
+    estad_operacion(ESTAD_CARGA);
+    uint64_t inicio = estad_reloj();
+    size_t tam;
+    char *datos = (char*)mapear_archivo(filename, &tam);
+    if (!datos) return NULL;
+    
+    // Archivos sin cabecera son del formato anterior (pre-order con marcadores -1)
+    if (tam < sizeof(SnapshotCabecera) || memcmp(datos, SNAPSHOT_MAGIA, 4) != 0) {
+        desmapear_archivo(datos, tam);
+        bool fallo;
+        Node *root = cargar_arbol_legado(filename, &fallo);
+        estad_carga(inicio, tam);
+        return root;
+    }
+    
+    if (!snapshot_validar(datos, tam)) {
+        desmapear_archivo(datos, tam);
+        return NULL;
+    }
+    Node *root = snapshot_cargar(datos, tam);
+    estad_carga(inicio, tam);
+    return root;
+}
+
+
+Node* snapshot_cargar(void *mapeo, size_t tam) {
+    // Armar el arbol desde una instantanea ya mapeada y validada (la mapea
+    // cargar_arbol o, en paralelo por almacen, almacenes_cargar) y soltarla
+    char *datos = (char*)mapeo;
+    SnapshotCabecera cab;
+    memcpy(&cab, datos, sizeof(cab));
+    const SnapshotNodo *nodos = (const SnapshotNodo*)(datos + sizeof(cab));
+    const SnapshotPedido *pedidos = (const SnapshotPedido*)(nodos + cab.num_nodos);
+    const char *cadenas = (const char*)(pedidos + cab.num_pedidos);
+    
+    if (cab.siguiente_id > siguiente_id_pedido) siguiente_id_pedido = cab.siguiente_id;
+    uint32_t *ids = (uint32_t*)calloc(cab.tam_cadenas ? cab.tam_cadenas : 1, sizeof(uint32_t));
+    bool fallo = false;
+    version_pausar();
+#ifdef CARGA_PARALELA
+    Node *root = NULL;
+    if (!ids || !snapshot_construir_paralelo(&cab, nodos, pedidos, cadenas, ids, &root, &fallo)) {
+        root = snapshot_construir(nodos, pedidos, cadenas, ids, 0, (long)cab.num_nodos - 1, &fallo);
+    }
+#else
+    Node *root = snapshot_construir(nodos, pedidos, cadenas, ids, 0, (long)cab.num_nodos - 1, &fallo);
+#endif
+    version_reanudar();
+    free(ids);
+    desmapear_archivo(datos, tam);
+    if (fallo) {
+        // Carga incompleta: soltar lo armado y devolver NULL (cargar_inventario
+        // no reproduce ni compacta sobre una instantanea con lotes sin cargar)
+        fprintf(stderr, "Error: No hay memoria para cargar la instantanea completa.\n");
+        vaciar_inventario();
+        return NULL;
+    }
+    bmas_reconstruir(root);
+    version_reconstruir(root);
+    productos_reconstruir(root);
+    actualizar_lote_fefo(root);
+    return root;
+}
+
+
+bool snapshot_leer_cabecera(const char *filename, SnapshotCabecera *cab) {
+    FILE *f = fopen(filename, "rb");
+    if (!f) return false;
+    bool ok = fread(cab, sizeof(*cab), 1, f) == 1 &&
+              memcmp(cab->magia, SNAPSHOT_MAGIA, sizeof(cab->magia)) == 0;
+    fclose(f);
+    return ok;
+}
+
+
+/**
+ * Journal (write-ahead log) de mutaciones del inventario
+ *
+ * [JournalCabecera][JournalRegistro + cadena]...
+ *
+ * Cada mutacion confirmada (insercion de lote, baja de lote, pedido encolado,
+ * pedido cancelado, despachado o compactado) se agrega al final del journal. Los registros se acumulan en
+ * memoria y se escriben con un solo fsync por grupo (commit agrupado). La cabecera
+ * identifica la instantanea sobre la que aplica el journal, de modo que un journal
+ * que ya quedo incluido en un checkpoint se descarta en vez de aplicarse dos veces.
+ */
+#define JOURNAL_MAGIA "AVLJ"
+#define JOURNAL_VERSION 3
+#define ARCHIVO_JOURNAL "inventario.wal"  // Archivo del journal de mutaciones
+#define ARCHIVO_JOURNAL_ANTERIOR ARCHIVO_JOURNAL ".1"  // Journal previo durante un relevo
+#define JOURNAL_BUFFER 65536              // Bytes acumulados antes de forzar escritura
+#define JOURNAL_GRUPO 128                 // Registros pendientes por fsync como maximo
+#define JOURNAL_MAX_REGISTROS 10000       // Registros tras los que se compacta (checkpoint)
+
+typedef struct JournalCabecera {
+    char magia[4];                    // Identificador del formato (JOURNAL_MAGIA)
+    uint32_t version;                 // Version del formato
+    uint32_t base_tipo;               // JOURNAL_BASE_VACIA o JOURNAL_BASE_SNAPSHOT
+    uint32_t base_checksum;           // Checksum de la instantanea base
+} JournalCabecera;
+
+typedef struct JournalRegistro {
+    uint32_t checksum;                // FNV-1a del resto del registro y su cadena
+    uint16_t tipo;                    // JournalTipo
+    uint16_t largo;                   // Bytes de la cadena que sigue (sin terminador)
+    int32_t fecha;                    // Fecha del lote afectado
+    uint32_t secuencia;               // Secuencia del lote entre los de su fecha
+    int32_t cantidad;                 // Stock o cantidad del pedido
+    uint32_t id;                      // ID del pedido afectado (0 si no aplica)
+} JournalRegistro;
+
+/**
+ * Estructura Journal: Estado del journal abierto
+ */
+typedef struct Journal {
+    FILE *archivo;                    // Journal abierto para agregar
+    char buffer[JOURNAL_BUFFER];      // Registros aun no escritos
+    size_t usados;                    // Bytes ocupados en buffer
+    int pendientes;                   // Registros aun sin fsync
+    long registros;                   // Registros desde el ultimo checkpoint
+} Journal;
+
+Journal journal;
+
+
+JournalCabecera journal_cabecera(uint32_t base_tipo, uint32_t base_checksum) {
+    JournalCabecera cab;
+    memset(&cab, 0, sizeof(cab));
+    memcpy(cab.magia, JOURNAL_MAGIA, sizeof(cab.magia));
+    cab.version = JOURNAL_VERSION;
+    cab.base_tipo = base_tipo;
+    cab.base_checksum = base_checksum;
+    return cab;
+}
+
+
+bool journal_abrir(uint32_t base_tipo, uint32_t base_checksum) {
+    // Reiniciar el journal: todo lo anterior queda cubierto por la base indicada
+    if (journal.archivo) fclose(journal.archivo);
+    journal.usados = 0;
+    journal.pendientes = 0;
+    journal.registros = 0;
+    
+    journal.archivo = fopen(ARCHIVO_JOURNAL, "wb");
+    if (!journal.archivo) {
+        fprintf(stderr, "Advertencia: No se pudo abrir el journal '%s'.\n", ARCHIVO_JOURNAL);
+        return false;
+    }
+    
+    JournalCabecera cab = journal_cabecera(base_tipo, base_checksum);
+    memcpy(journal.buffer, &cab, sizeof(cab));
+    journal.usados = sizeof(cab);
+    journal.pendientes = 1;  // La cabecera tambien debe llegar a disco
+    return true;
+}
+
+
+bool sincronizar_archivo(FILE *f) {
+    // Vaciar el buffer de stdio y esperar a que los datos lleguen a disco
+    bool ok = fflush(f) == 0;
+#ifdef _WIN32
+    ok = _commit(_fileno(f)) == 0 && ok;
+#else
+    ok = fsync(fileno(f)) == 0 && ok;
+#endif
+    return ok;
+}
+
+
+bool journal_sincronizar(void) {
+    if (!journal.archivo || journal.pendientes == 0) return true;
+    
+    // El historial llega a disco antes que los despachos que lo descuentan
+    if (__atomic_exchange_n(&historial_pendiente, false, __ATOMIC_ACQ_REL) && !sincronizar_archivo(historial)) {
+        fprintf(stderr, "Advertencia: No se pudo escribir el historial.\n");
+    }
+    
+    // Una escritura y un fsync para todo el grupo de registros pendientes
+    uint64_t inicio = estad_reloj();
+    bool ok = fwrite(journal.buffer, 1, journal.usados, journal.archivo) == journal.usados;
+    ok = sincronizar_archivo(journal.archivo) && ok;
+    if (ok) estad_journal(inicio, journal.usados);
+    if (!ok) fprintf(stderr, "Advertencia: No se pudo escribir el journal.\n");
+    
+    journal.usados = 0;
+    journal.pendientes = 0;
+    return ok;
+}
+
+
+void journal_escribir(JournalTipo tipo, int fecha, uint32_t secuencia, int cantidad, uint32_t id, const char *cadena) {
+    // Agrega un registro al buffer; el llamador serializa (bloquear_journal)
+    if (!journal.archivo) return;
+    
+    size_t largo = cadena ? strlen(cadena) : 0;
+    if (largo > MAX_NAME - 1) largo = MAX_NAME - 1;
+    if (journal.usados + sizeof(JournalRegistro) + largo > JOURNAL_BUFFER) {
+        journal_sincronizar();
+    }
+    
+    JournalRegistro r;
+    r.tipo = (uint16_t)tipo;
+    r.largo = (uint16_t)largo;
+    r.fecha = fecha;
+    r.secuencia = secuencia;
+    r.cantidad = cantidad;
+    r.id = id;
+    
+    // El checksum cubre los campos del registro y la cadena
+    char *destino = journal.buffer + journal.usados;
+    if (largo > 0) memcpy(destino + sizeof(r), cadena, largo);
+    r.checksum = 0;
+    memcpy(destino, &r, sizeof(r));
+    r.checksum = checksum_fnv1a(destino + sizeof(r.checksum), sizeof(r) - sizeof(r.checksum) + largo);
+    memcpy(destino, &r, sizeof(r));
+    
+    journal.usados += sizeof(r) + largo;
+    journal.registros++;
+    if (++journal.pendientes >= JOURNAL_GRUPO) journal_sincronizar();
+}
+
+
+void journal_registrar(JournalTipo tipo, int fecha, uint32_t secuencia, int cantidad, uint32_t id, const char *cadena) {
+    bloquear_journal();  // Varias terminales pueden registrar a la vez
+    journal_escribir(tipo, fecha, secuencia, cantidad, id, cadena);
+    desbloquear_journal();
+}
+
+
+void journal_cerrar(void) {
+    journal_sincronizar();
+    if (journal.archivo) fclose(journal.archivo);
+    journal.archivo = NULL;
+}
+
+
+Node* journal_aplicar(Node *root, const JournalRegistro *r, const char *cadena) {
+    switch (r->tipo) {
+        case JOURNAL_INSERTAR:
+            return insertAVL(root, r->fecha, cadena, r->cantidad);
+        case JOURNAL_ELIMINAR:
+            return deleteNode(root, r->fecha, r->secuencia);
+        case JOURNAL_ENCOLAR: {
+            // Se reutiliza el ID original para que las cancelaciones posteriores coincidan
+            estad_operacion(ESTAD_PEDIDO);
+            Node *lote = buscar_lote(root, r->fecha, r->secuencia);
+            if (lote && encolar_pedido(lote, cadena_internar(cadena), r->cantidad, r->id)) {
+                ajustar_stock(lote, -r->cantidad);
+            }
+            return root;
+        }
+        case JOURNAL_CANCELAR:
+            cancel_order_by_id(r->id);
+            return root;
+        case JOURNAL_DESPACHAR: {
+            // Los despachados ya estan en el historial: no se vuelven a archivar
+            Node *lote = buscar_lote(root, r->fecha, r->secuencia);
+            if (lote) retirar_pedidos(lote, r->cantidad, false);
+            return root;
+        }
+        case JOURNAL_COMPACTAR: {
+            Node *lote = buscar_lote(root, r->fecha, r->secuencia);
+            if (lote) fusionar_pedidos(lote);
+            return root;
+        }
+        case JOURNAL_PURGAR: {
+            Totales quitados;
+            return purgar_vencidos(root, r->fecha, &quitados);
+        }
+    }
+    return root;
+}
+
+
+bool journal_coincide(const JournalCabecera *cab, uint32_t base_tipo, uint32_t base_checksum) {
+    // Solo se reproduce un journal escrito sobre la misma base que se cargo
+    return memcmp(cab->magia, JOURNAL_MAGIA, sizeof(cab->magia)) == 0 && cab->version == JOURNAL_VERSION &&
+           cab->base_tipo == base_tipo &&
+           (base_tipo != JOURNAL_BASE_SNAPSHOT || cab->base_checksum == base_checksum);
+}
+
+
+bool journal_leer_cabecera(const char *ruta, JournalCabecera *cab) {
+    FILE *f = fopen(ruta, "rb");
+    if (!f) return false;
+    bool ok = fread(cab, sizeof(*cab), 1, f) == 1;
+    fclose(f);
+    return ok;
+}
+
+
+Node* journal_reproducir(const char *ruta, Node *root, uint32_t base_tipo, uint32_t base_checksum, long *aplicados) {
+    *aplicados = 0;
+    size_t tam;
+    char *datos = (char*)mapear_archivo(ruta, &tam);
+    if (!datos) return root;
+    
+    JournalCabecera cab;
+    if (tam < sizeof(cab)) {
+        desmapear_archivo(datos, tam);
+        return root;
+    }
+    memcpy(&cab, datos, sizeof(cab));
+    if (!journal_coincide(&cab, base_tipo, base_checksum)) {
+        desmapear_archivo(datos, tam);
+        return root;
+    }
+    
+    size_t pos = sizeof(cab);
+    while (pos + sizeof(JournalRegistro) <= tam) {
+        JournalRegistro r;
+        memcpy(&r, datos + pos, sizeof(r));
+        if (r.largo > MAX_NAME - 1 || pos + sizeof(r) + r.largo > tam) break;  // Registro truncado
+        
+        const char *cuerpo = datos + pos + sizeof(r.checksum);
+        if (checksum_fnv1a(cuerpo, sizeof(r) - sizeof(r.checksum) + r.largo) != r.checksum) break;
+        
+        char cadena[MAX_NAME];
+        memcpy(cadena, datos + pos + sizeof(r), r.largo);
+        cadena[r.largo] = '\0';
+        root = journal_aplicar(root, &r, cadena);
+        (*aplicados)++;
+        pos += sizeof(r) + r.largo;
+    }
+    
+    desmapear_archivo(datos, tam);
+    return root;
+}
+
+
+#ifdef VERSIONES
+/*
+ * Guardado en segundo plano
+ *
+ * Se toma la version actual (O(1)) y un hilo la serializa al mismo formato de
+ * instantanea mientras el menu sigue aceptando cambios, que van al journal.
+ * Al terminar, el hilo principal releva el journal: el nuevo parte de la
+ * instantanea escrita y conserva solo los registros posteriores a la version.
+ * Orden de los renombres, para que una caida en cualquier punto se recupere:
+ *   1. journal nuevo completo y sincronizado en ARCHIVO_JOURNAL ".tmp"
+ *   2. ARCHIVO_JOURNAL -> ARCHIVO_JOURNAL_ANTERIOR (sigue coincidiendo con el .dat viejo)
+ *   3. ARCHIVO_JOURNAL ".tmp" -> ARCHIVO_JOURNAL
+ *   4. ARCHIVO_DATOS_FONDO -> ARCHIVO_DATOS, y recien entonces se borra el anterior
+ */
+#define ARCHIVO_DATOS_FONDO ARCHIVO_DATOS ".fondo"  // Instantanea escrita por el hilo
+
+/**
+ * Estructura GuardadoFondo: Guardado en curso en otro hilo
+ */
+typedef struct GuardadoFondo {
+    bool activo;                      // Hay un guardado lanzado y aun no recogido
+    bool terminado;                   // El hilo ya termino (acceso atomico)
+    bool ok;                          // La instantanea quedo escrita
+    VersionLote *version;             // Version que se guarda (referencia propia)
+    uint32_t siguiente_id;            // Proximo ID de pedido al tomar la version
+    uint32_t num_cadenas;             // Cota de los IDs de cadena de la version
+    uint32_t checksum;                // Checksum de la instantanea escrita
+    long journal_desde;               // Bytes del journal ya cubiertos por la version
+    long registros_desde;             // Registros del journal ya cubiertos por la version
+#ifndef _WIN32
+    pthread_t hilo;
+#endif
+} GuardadoFondo;
+
+GuardadoFondo guardado_fondo;
+
+
+void version_contar(const VersionLote *v, SnapshotCabecera *cab, uint32_t *vista) {
+    // Recorrido en orden; la recursion baja a lo sumo la altura del AVL
+    if (!v) return;
+    version_contar(v->left, cab, vista);
+    cab->num_nodos++;
+    cab->num_pedidos += (uint32_t)v->num_pedidos;
+    cab->tam_cadenas += snapshot_medir_cadena(vista, v->producto);
+    for (const VersionPedido *p = v->ultimo_pedido; p; p = p->anterior) {
+        cab->tam_cadenas += snapshot_medir_cadena(vista, p->destino);
+    }
+    version_contar(v->right, cab, vista);
+}
+
+
+void version_volcar(const VersionLote *v, SnapshotEscritor *w) {
+    if (!v) return;
+    version_volcar(v->left, w);
+    SnapshotNodo *r = &w->nodos[w->n_nodos++];
+    r->fecha_vencimiento = v->fecha_vencimiento;
+    r->secuencia = v->secuencia;
+    r->stock_total = v->stock_total;
+    r->producto = snapshot_agregar_cadena(w, v->producto);
+    r->primer_pedido = w->n_pedidos;
+    r->num_pedidos = (uint32_t)v->num_pedidos;
+    
+    // La lista va del mas nuevo al mas viejo: el tramo del lote se llena desde el final
+    w->n_pedidos += r->num_pedidos;
+    uint32_t i = w->n_pedidos;
+    for (const VersionPedido *p = v->ultimo_pedido; p; p = p->anterior) {
+        SnapshotPedido *rp = &w->pedidos[--i];
+        rp->id = p->id;
+        rp->destino = snapshot_agregar_cadena(w, p->destino);
+        rp->cantidad_solicitada = p->cantidad_solicitada;
+    }
+    version_volcar(v->right, w);
+}
+
+
+void* guardado_hilo(void *arg) {
+    // Solo lee la version recibida: el resto del inventario puede cambiar mientras tanto
+    GuardadoFondo *g = (GuardadoFondo*)arg;
+    uint64_t inicio = estad_reloj();
+    SnapshotCabecera cab;
+    snapshot_iniciar_cabecera(&cab, g->siguiente_id);
+    bool ok = false;
+    uint32_t *vista = (uint32_t*)calloc(g->num_cadenas, sizeof(uint32_t));
+    if (vista) {
+        version_contar(g->version, &cab, vista);
+        SnapshotEscritor w;
+        size_t tam;
+        char *buffer = snapshot_preparar(&cab, &w, &tam, vista, g->num_cadenas);
+        if (buffer) {
+            version_volcar(g->version, &w);
+            ok = snapshot_escribir(buffer, tam, &cab, ARCHIVO_DATOS_FONDO);
+            if (ok) estad_guardado(inicio, tam);
+        }
+        free(vista);
+    }
+    g->ok = ok;
+    g->checksum = cab.checksum;
+    __atomic_store_n(&g->terminado, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+
+bool guardado_iniciar(void) {
+    // Lanza el guardado de la version actual; false si no se pudo (guardar sincrono)
+    GuardadoFondo *g = &guardado_fondo;
+    if (g->activo || !version_valida || !journal_sincronizar()) return false;
+    
+    g->version = version_tomar();
+    g->siguiente_id = siguiente_id_pedido;
+    g->num_cadenas = cadenas_cantidad();
+    g->journal_desde = journal.archivo ? ftell(journal.archivo) : 0;
+    g->registros_desde = journal.registros;
+    g->terminado = false;
+    g->ok = false;
+    g->activo = true;
+#ifdef _WIN32
+    guardado_hilo(g);  // Sin hilos POSIX: el guardado es sincrono
+#else
+    if (pthread_create(&g->hilo, NULL, guardado_hilo, g) != 0) {
+        version_devolver(g->version);
+        g->activo = false;
+        return false;
+    }
+#endif
+    return true;
+}
+
+
+bool journal_relevar(const GuardadoFondo *g) {
+    // Pasos 1 a 3: el journal nuevo parte de la instantanea del hilo y
+    // conserva los registros escritos despues de tomar la version
+    if (!journal.archivo) return true;
+    if (!journal_sincronizar()) return false;
+    long fin = ftell(journal.archivo);
+    if (fin < g->journal_desde) return false;
+    size_t largo = (size_t)(fin - g->journal_desde);
+    
+    char *cola = (char*)malloc(largo ? largo : 1);
+    FILE *f = fopen(ARCHIVO_JOURNAL, "rb");
+    bool ok = cola && f && fseek(f, g->journal_desde, SEEK_SET) == 0 && fread(cola, 1, largo, f) == largo;
+    if (f) fclose(f);
+    
+    f = ok ? fopen(ARCHIVO_JOURNAL ".tmp", "wb") : NULL;
+    if (f) {
+        JournalCabecera cab = journal_cabecera(JOURNAL_BASE_SNAPSHOT, g->checksum);
+        ok = fwrite(&cab, sizeof(cab), 1, f) == 1 && fwrite(cola, 1, largo, f) == largo;
+        ok = sincronizar_archivo(f) && ok;
+        ok = fclose(f) == 0 && ok;
+    } else {
+        ok = false;
+    }
+    free(cola);
+    
+    fclose(journal.archivo);
+    journal.archivo = NULL;
+    if (ok && rename(ARCHIVO_JOURNAL, ARCHIVO_JOURNAL_ANTERIOR) != 0) ok = false;
+    else if (ok && rename(ARCHIVO_JOURNAL ".tmp", ARCHIVO_JOURNAL) != 0) {
+        rename(ARCHIVO_JOURNAL_ANTERIOR, ARCHIVO_JOURNAL);
+        ok = false;
+    }
+    if (!ok) remove(ARCHIVO_JOURNAL ".tmp");
+    
+    // Seguir agregando al journal vigente (el nuevo, o el de siempre si fallo)
+    journal.archivo = fopen(ARCHIVO_JOURNAL, "ab");
+    if (!journal.archivo) {
+        fprintf(stderr, "Advertencia: No se pudo reabrir el journal '%s'.\n", ARCHIVO_JOURNAL);
+        return false;
+    }
+    fseek(journal.archivo, 0, SEEK_END);  // ftell marca el cubierto por el proximo guardado
+    if (ok) journal.registros -= g->registros_desde;
+    return ok;
+}
+
+
+int guardado_recoger(bool esperar) {
+    // 0: nada que recoger; 1: guardado completo; -1: fallo (sigue valido el anterior)
+    GuardadoFondo *g = &guardado_fondo;
+    if (!g->activo) return 0;
+    if (!esperar && !__atomic_load_n(&g->terminado, __ATOMIC_ACQUIRE)) return 0;
+#ifndef _WIN32
+    pthread_join(g->hilo, NULL);
+#endif
+    g->activo = false;
+    version_devolver(g->version);
+    
+    bool ok = g->ok && journal_relevar(g);
+    if (ok && rename(ARCHIVO_DATOS_FONDO, ARCHIVO_DATOS) != 0) {
+        // La instantanea anterior sigue vigente: devolverle su journal completo
+        journal_cerrar();
+        rename(ARCHIVO_JOURNAL_ANTERIOR, ARCHIVO_JOURNAL);
+        journal.archivo = fopen(ARCHIVO_JOURNAL, "ab");
+        if (journal.archivo) fseek(journal.archivo, 0, SEEK_END);
+        journal.registros += g->registros_desde;
+        ok = false;
+    }
+    if (ok) remove(ARCHIVO_JOURNAL_ANTERIOR);
+    else remove(ARCHIVO_DATOS_FONDO);
+    return ok ? 1 : -1;
+}
+
+
+bool guardado_en_curso(void) {
+    return guardado_fondo.activo;
+}
+#endif
+
+
+bool checkpoint_inventario(Node *root) {
+    // Compactacion: la instantanea absorbe el journal y este vuelve a empezar
+    guardado_esperar();  // No pisar un guardado en segundo plano
+    journal_sincronizar();
+    if (!guardar_arbol(root, ARCHIVO_DATOS)) return false;
+    
+    SnapshotCabecera cab;
+    if (!snapshot_leer_cabecera(ARCHIVO_DATOS, &cab)) return false;
+    journal_abrir(JOURNAL_BASE_SNAPSHOT, cab.checksum);
+    journal_sincronizar();
+    return true;
+}
+
+
+bool archivo_formato_anterior(const char *filename) {
+    // Archivo con datos pero sin cabecera de instantanea (lo lee cargar_arbol_legado)
+    SnapshotCabecera cab;
+    if (snapshot_leer_cabecera(filename, &cab)) return false;
+    FILE *f = fopen(filename, "rb");
+    if (!f) return false;
+    bool hay_datos = fgetc(f) != EOF;
+    fclose(f);
+    return hay_datos;
+}
+
+
+void journal_desactivar(void) {
+    // Sin una base que el journal pueda reproducir: lo pendiente se descarta y
+    // no se registra nada hasta el proximo checkpoint
+    if (journal.archivo) fclose(journal.archivo);
+    journal.archivo = NULL;
+    journal.usados = 0;
+    journal.pendientes = 0;
+    journal.registros = 0;
+}
+
+
+bool convertir_formato_anterior(Node *root) {
+    // Solo tras una carga completa: el original se conserva como
+    // ARCHIVO_DATOS_ANTERIOR y el journal parte de una instantanea nueva
+    FILE *f = fopen(ARCHIVO_DATOS_ANTERIOR, "rb");
+    if (f) {
+        fclose(f);
+        fprintf(stderr, "Advertencia: Ya existe '%s'; no se convierte '%s'.\n", ARCHIVO_DATOS_ANTERIOR, ARCHIVO_DATOS);
+        return false;
+    }
+    if (rename(ARCHIVO_DATOS, ARCHIVO_DATOS_ANTERIOR) != 0) return false;
+    if (!checkpoint_inventario(root)) {
+        rename(ARCHIVO_DATOS_ANTERIOR, ARCHIVO_DATOS);
+        return false;
+    }
+    printf("ℹ Inventario convertido al formato actual (original en '%s').\n", ARCHIVO_DATOS_ANTERIOR);
+    return true;
+}
+
+
+Node* cargar_inventario_anterior(void) {
+    // ARCHIVO_DATOS en el formato anterior: sin conversion no hay journal,
+    // porque no tendria una instantanea sobre la cual reproducirse
+    bool fallo;
+    Node *root = cargar_arbol_legado(ARCHIVO_DATOS, &fallo);
+    if (fallo || !convertir_formato_anterior(root)) {
+        journal_desactivar();
+        fprintf(stderr, "Advertencia: Journal desactivado; los cambios solo se conservan al guardar.\n");
+    }
+    return root;
+}
+
+
+Node* cargar_inventario(void) {
+    // Recuperacion: instantanea mas los cambios del journal que aun no tiene
+    if (archivo_formato_anterior(ARCHIVO_DATOS)) return cargar_inventario_anterior();
+    
+    SnapshotCabecera cab;
+    bool hay_snapshot = snapshot_leer_cabecera(ARCHIVO_DATOS, &cab);
+    Node *root = cargar_arbol(ARCHIVO_DATOS);
+    
+    if (hay_snapshot && !root && cab.num_nodos > 0) {
+        // Instantanea ilegible: no reproducir ni compactar encima de ella
+        fprintf(stderr, "Advertencia: Journal desactivado hasta cargar un inventario valido.\n");
+        return NULL;
+    }
+    
+    uint32_t base_tipo = hay_snapshot ? JOURNAL_BASE_SNAPSHOT : JOURNAL_BASE_VACIA;
+    uint32_t checksum = hay_snapshot ? cab.checksum : 0;
+    
+    // Un relevo de journal interrumpido deja el que corresponde a la
+    // instantanea en disco como ARCHIVO_JOURNAL_ANTERIOR
+    JournalCabecera jcab;
+    const char *ruta = ARCHIVO_JOURNAL;
+    if (!journal_leer_cabecera(ARCHIVO_JOURNAL, &jcab) || !journal_coincide(&jcab, base_tipo, checksum)) {
+        ruta = ARCHIVO_JOURNAL_ANTERIOR;
+    }
+    long aplicados;
+    root = journal_reproducir(ruta, root, base_tipo, checksum, &aplicados);
+    
+    if (aplicados > 0) {
+        printf("ℹ Se recuperaron %ld operaciones del journal.\n", aplicados);
+        checkpoint_inventario(root);
+    } else {
+        journal_abrir(base_tipo, checksum);
+    }
+    remove(ARCHIVO_JOURNAL_ANTERIOR);
+    return root;
+}
+
+
+void journal_confirmar(Node *root) {
+    // Punto de commit: escribir el grupo pendiente y compactar si el journal crecio
+    journal_sincronizar();
+    if (journal.registros >= JOURNAL_MAX_REGISTROS) {
+#ifdef VERSIONES
+        // Compactar en segundo plano; sin imagen valida, de forma sincrona
+        if (guardado_fondo.activo || guardado_iniciar()) return;
+#endif
+        checkpoint_inventario(root);
+    }
+}
+
+
+#ifdef INVENTARIO_CONCURRENTE
+/*
+ * Operaciones para varias terminales de despacho sobre un inventario
+ * compartido. root es la raiz comun: solo cambia con el bloqueo de escritura.
+ */
+
+uint32_t encolar_pedido_concurrente(Node *lote, const char *destino, int cantidad) {
+    // Productor sin bloqueo del lote: reserva atomica de stock y publicacion
+    // en la entrada del lote, que el consumidor drena a la cola FIFO
+    estad_operacion(ESTAD_PEDIDO);
+    if (cantidad <= 0 || !reservar_stock(lote, cantidad)) return 0;
+    
+    // El lugar en el indice se reserva antes de publicar: despues de escribir
+    // el journal el pedido ya no se puede deshacer
+    bloquear_pedidos();
+    Order *o = (Order*)pool_reservar(&pool_pedidos);
+    if (o && !indice_reservar(1)) {
+        pool_liberar(&pool_pedidos, o);
+        o = NULL;
+    }
+    if (o) indice_pedidos.reservados++;
+    desbloquear_pedidos();
+    if (!o) {
+        ajustar_stock(lote, cantidad);  // Devolver la reserva
+        fprintf(stderr, "Error: No se pudo asignar memoria para el pedido.\n");
+        return 0;
+    }
+    o->destino = cadena_internar(destino);
+    o->cantidad_solicitada = cantidad;
+    o->anterior = NULL;
+    o->lote = lote;
+    SUMAR_AGREGADO(lote->num_pedidos, 1);
+    SUMAR_AGREGADO(lote->cantidad_pendiente, cantidad);
+    propagar_agregados(lote, 0, 1, cantidad);
+    estad_cola(LEER_CONTADOR(lote->num_pedidos));
+    
+    // ID, registro y publicacion juntos: la entrada del lote y el journal
+    // quedan en el mismo orden. Sin journal abierto no hace falta el mutex
+    bool serializar = journal.archivo != NULL;
+    if (serializar) bloquear_journal();
+    o->id = __atomic_fetch_add(&siguiente_id_pedido, 1, __ATOMIC_RELAXED);
+    journal_escribir(JOURNAL_ENCOLAR, lote->fecha_vencimiento, lote->secuencia, cantidad, o->id, destino);
+    publicar_pedido(lote, o);
+    if (serializar) desbloquear_journal();
+    
+    // Nadie conoce el ID hasta que se devuelve: indexarlo despues no abre
+    // carreras, y con el lugar reservado indice_insertar no necesita crecer
+    uint32_t id = o->id;
+    bloquear_pedidos();
+    indice_pedidos.reservados--;
+    indice_insertar(o);
+    desbloquear_pedidos();
+    return id;
+}
+
+
+uint32_t registrar_pedido_concurrente(Node **root, int fecha, const char *destino, int cantidad) {
+    // fecha 0: lote mas proximo a vencer. Devuelve el ID, o 0 si no se registro
+    uint32_t id = 0;
+    inventario_leer();
+    Node *lote = fecha ? searchNode(*root, fecha) : buscar_lote_minimo(*root);
+    if (lote) id = encolar_pedido_concurrente(lote, destino, cantidad);
+    inventario_soltar();
+    return id;
+}
+
+
+int cancelar_pedido_concurrente(uint32_t id) {
+    int ok = 0;
+    inventario_leer();
+    bloquear_pedidos();
+    Order *o = buscar_pedido_por_id(id);
+    Node *lote = o ? o->lote : NULL;
+    desbloquear_pedidos();
+    
+    if (lote) {
+        // Con el bloqueo de lectura el pedido no cambia de lote; se vuelve a
+        // buscar porque otra terminal pudo cancelarlo antes de tomar el del lote
+        bloquear_lote(lote);
+        drenar_entrada(lote);  // El pedido puede seguir en la entrada del lote
+        bloquear_pedidos();
+        o = buscar_pedido_por_id(id);
+        desbloquear_pedidos();
+        if (o) {
+            journal_registrar(JOURNAL_CANCELAR, lote->fecha_vencimiento, lote->secuencia, o->cantidad_solicitada, id, cadena_texto(o->destino));
+            quitar_pedido(o);
+            ok = 1;
+        }
+        desbloquear_lote(lote);
+    }
+    inventario_soltar();
+    return ok;
+}
+
+
+void reporte_concurrente(Node **root) {
+    // Los lectores no se bloquean entre si: solo esperan a los cambios de estructura
+    inventario_leer();
+    inorder_report(*root);
+    inventario_soltar();
+}
+
+
+bool insertar_lote_concurrente(Node **root, int fecha, const char *producto, int stock) {
+    bool ok = false;
+    inventario_escribir();
+    Node *nuevo_root = insertAVL(*root, fecha, producto, stock);
+    if (nuevo_root) {
+        *root = nuevo_root;
+        journal_registrar(JOURNAL_INSERTAR, fecha, 0, stock, 0, producto);
+        ok = true;
+    }
+    inventario_soltar();
+    return ok;
+}
+
+
+bool eliminar_lote_concurrente(Node **root, int fecha, uint32_t secuencia) {
+    bool ok = false;
+    inventario_escribir();
+    if (buscar_lote(*root, fecha, secuencia)) {
+        *root = deleteNode(*root, fecha, secuencia);
+        journal_registrar(JOURNAL_ELIMINAR, fecha, secuencia, 0, 0, NULL);
+        ok = true;
+    }
+    inventario_soltar();
+    return ok;
+}
+
+
+void drenar_todas(Node *root) {
+    // Con el bloqueo de escritura: pasar todas las entradas a sus colas
+    IteradorInorden it = iterador_inorden(root);
+    Node *n;
+    while ((n = iterador_siguiente(&it)) != NULL) drenar_entrada(n);
+}
+
+
+void confirmar_concurrente(Node **root) {
+    // El checkpoint recorre el arbol entero: se hace sin terminales activas
+    inventario_escribir();
+    if (journal.registros >= JOURNAL_MAX_REGISTROS) drenar_todas(*root);
+    journal_confirmar(*root);
+    inventario_soltar();
+}
+#endif
+
+
+int repartir_pedido_fefo(Node *root, const char *destino, int cantidad, bool informar) {
+    // Reparte un pedido entre lotes consecutivos en orden de vencimiento (FEFO):
+    // parte del minimo cacheado y avanza con el sucesor en orden, asi que cada
+    // lote adicional cuesta O(1) amortizado en lugar de un descenso nuevo.
+    // Cada parte es un pedido propio en la cola de su lote (con su ID).
+    // Devuelve las unidades asignadas: todo o nada, salvo falta de memoria.
+    if (!root || cantidad <= 0 || root->stock_subarbol < cantidad) return 0;
+    
+    int restante = cantidad;
+    for (Node *lote = buscar_lote_minimo(root); lote && restante > 0; lote = siguiente_inorden(lote)) {
+        if (lote->stock_total <= 0) continue;  // Lote agotado: pasar al siguiente
+        int parte = lote->stock_total < restante ? lote->stock_total : restante;
+        uint32_t id = enqueue_order(lote, destino, parte);
+        if (!id) break;
+        ajustar_stock(lote, -parte);
+        journal_registrar(JOURNAL_ENCOLAR, lote->fecha_vencimiento, lote->secuencia, parte, id, destino);
+        if (informar) {
+            printf("  Pedido #%u: %d unidades del lote %s\n", id, parte, formatear_fecha(lote->fecha_vencimiento));
+        }
+        restante -= parte;
+    }
+    return cantidad - restante;
+}
+
+
+int repartir_pedido_producto(Node *root, const char *producto, const char *destino, int cantidad, bool informar) {
+    // Como repartir_pedido_fefo, pero solo entre los lotes del producto (indice
+    // por producto): no se recorren los lotes de los demas productos
+    Totales t = totales_producto(root, producto);
+    if (cantidad <= 0 || t.stock < cantidad) return 0;
+    
+    int restante = cantidad;
+    for (Node *lote = producto_lote_fefo(root, producto); lote && restante > 0; lote = lote->producto_siguiente) {
+        if (lote->stock_total <= 0) continue;  // Lote agotado: pasar al siguiente
+        int parte = lote->stock_total < restante ? lote->stock_total : restante;
+        uint32_t id = enqueue_order(lote, destino, parte);
+        if (!id) break;
+        ajustar_stock(lote, -parte);
+        journal_registrar(JOURNAL_ENCOLAR, lote->fecha_vencimiento, lote->secuencia, parte, id, destino);
+        if (informar) {
+            printf("  Pedido #%u: %d unidades del lote %s\n", id, parte, formatear_fecha(lote->fecha_vencimiento));
+        }
+        restante -= parte;
+    }
+    return cantidad - restante;
+}
+
+
+/*
+ * Tandas de pedidos
+ *
+ * Cada pedido de la tanda apunta al primer lote de una fecha o al lote FEFO
+ * de un producto. Los de fecha se resuelven en un solo barrido en orden
+ * (ordenados por fecha, cada uno parte del lote del anterior en lugar de
+ * descender desde la raiz) y luego la tanda se agrupa por lote: cada grupo decide
+ * en el orden de entrada que pedidos alcanzan el stock, los aceptados reciben
+ * sus IDs en el orden de entrada de toda la tanda y recien entonces cada grupo
+ * encola los suyos y descuenta el stock y los agregados de los ancestros una
+ * sola vez. Pedidos e indice se reservan antes de empezar. Colas, stock e IDs
+ * quedan como si los pedidos se aplicaran uno por uno en orden.
+ */
+/**
+ * Estructura ObjetivoTanda: Pedido de la tanda con la clave por la que se ordena
+ */
+typedef struct ObjetivoTanda {
+    ClaveLote clave;                  // Fecha (al resolver) o clave del lote (al agrupar)
+    size_t i;                         // Posicion en la tanda (desempata: orden de entrada)
+    uint32_t destino;                 // Destino internado del pedido aceptado
+} ObjetivoTanda;
+
+
+int comparar_objetivos(const void *a, const void *b) {
+    const ObjetivoTanda *x = (const ObjetivoTanda*)a, *y = (const ObjetivoTanda*)b;
+    if (x->clave != y->clave) return x->clave < y->clave ? -1 : 1;
+    return (x->i > y->i) - (x->i < y->i);
+}
+
+
+Node* tanda_avanzar(Node *actual, int fecha) {
+    // Primer lote con fecha >= la pedida, partiendo del lote del pedido
+    // anterior (busqueda con dedo): se sube hasta el primer ancestro que la
+    // alcanza y se vuelve a bajar por el subarbol del que se llego, O(log d)
+    // para d lotes de salto
+    if (actual->fecha_vencimiento >= fecha) return actual;
+    Node *x = actual;
+    while (x->parent && (x == x->parent->right || x->parent->fecha_vencimiento < fecha)) {
+        x = x->parent;
+    }
+    Node *mejor = x->parent;  // Si existe, x es su hijo izquierdo y su fecha alcanza
+    for (Node *r = x; r; ) {
+        if (r->fecha_vencimiento >= fecha) {
+            mejor = r;
+            r = r->left;
+        } else {
+            r = r->right;
+        }
+    }
+    return mejor;
+}
+
+
+void tanda_decidir_grupo(Node *lote, PedidoTanda *pedidos, ObjetivoTanda *grupo, size_t m) {
+    // Pedidos de un mismo lote, en orden de entrada: cuales alcanzan el stock.
+    // Los aceptados quedan TANDA_REGISTRADO, todavia sin ID ni encolar
+    int disponible = LEER_CONTADOR(lote->stock_total);
+    for (size_t k = 0; k < m; k++) {
+        PedidoTanda *p = &pedidos[grupo[k].i];
+        if (p->cantidad > disponible) {
+            p->resultado = TANDA_SIN_STOCK;
+            continue;
+        }
+        grupo[k].destino = cadena_internar(p->destino);
+        if (!grupo[k].destino) {
+            p->resultado = TANDA_SIN_MEMORIA;
+            continue;
+        }
+        disponible -= p->cantidad;
+        p->resultado = TANDA_REGISTRADO;
+    }
+}
+
+
+int tanda_encolar_grupo(Node *lote, PedidoTanda *pedidos, const ObjetivoTanda *grupo, size_t m) {
+    // Encola los pedidos aceptados del grupo, ya con su ID; devuelve los registrados
+    int registrados = 0;
+    long long descontado = 0;
+    bloquear_pedidos();
+    drenar_entrada(lote);  // Con el bloqueo de escritura: lo publicado antes va primero
+    for (size_t k = 0; k < m; k++) {
+        PedidoTanda *p = &pedidos[grupo[k].i];
+        if (p->resultado != TANDA_REGISTRADO) continue;
+        estad_operacion(ESTAD_PEDIDO);
+        // pool_preparar e indice_reservar ya dejaron lugar para toda la tanda
+        Order *o = (Order*)pool_reservar(&pool_pedidos);
+        if (!o) {
+            p->id = 0;
+            p->resultado = TANDA_SIN_MEMORIA;
+            continue;
+        }
+        o->destino = grupo[k].destino;
+        o->cantidad_solicitada = p->cantidad;
+        o->id = p->id;
+        o->lote = lote;
+        if (!indice_insertar(o)) {
+            pool_liberar(&pool_pedidos, o);
+            p->id = 0;
+            p->resultado = TANDA_SIN_MEMORIA;
+            continue;
+        }
+        cola_agregar(lote, o);
+        version_encolar(lote, o);
+        descontado += p->cantidad;
+        registrados++;
+    }
+    desbloquear_pedidos();
+    
+    // Contadores del lote y agregados de los ancestros: una vez por grupo
+    SUMAR_AGREGADO(lote->num_pedidos, registrados);
+    SUMAR_AGREGADO(lote->cantidad_pendiente, descontado);
+    propagar_agregados(lote, 0, registrados, descontado);
+    if (descontado) ajustar_stock(lote, (int)-descontado);
+    estad_cola(LEER_CONTADOR(lote->num_pedidos));
+    
+    for (size_t k = 0; k < m; k++) {
+        const PedidoTanda *p = &pedidos[grupo[k].i];
+        if (p->resultado == TANDA_REGISTRADO) {
+            journal_registrar(JOURNAL_ENCOLAR, lote->fecha_vencimiento, lote->secuencia, p->cantidad, p->id, p->destino);
+        }
+    }
+    
+    // El limite por lote se aplica al final del grupo, despues de sus registros
+    // de ENCOLAR, para que el journal lo reproduzca en el mismo orden
+    limite_desalojar(lote, 0);
+    return registrados;
+}
+
+
+size_t despachar_tanda(Node *root, PedidoTanda *pedidos, size_t n) {
+    // Devuelve los pedidos registrados; cada pedido queda con su resultado.
+    // Con INVENTARIO_CONCURRENTE el llamador tiene el bloqueo de escritura:
+    // el stock se lee y se descuenta sin la reserva atomica de reservar_stock
+    ObjetivoTanda *objetivos = (ObjetivoTanda*)malloc((n ? n : 1) * sizeof(ObjetivoTanda));
+    bool reservado = objetivos && pool_preparar(&pool_pedidos, n) && indice_reservar(n);
+    size_t k = 0, por_producto = 0;
+    for (size_t i = 0; i < n; i++) {
+        PedidoTanda *p = &pedidos[i];
+        p->id = 0;
+        p->lote = NULL;
+        if (!reservado) {
+            p->resultado = TANDA_SIN_MEMORIA;
+        } else if (p->cantidad <= 0 || p->destino[0] == '\0') {
+            p->resultado = TANDA_INVALIDO;
+        } else if (p->fecha_vencimiento == 0) {
+            // Lote FEFO del producto: O(1) con el indice por producto
+            p->lote = producto_lote_fefo(root, p->producto);
+            if (!p->lote) p->resultado = TANDA_SIN_LOTE;
+            else por_producto++;
+        } else {
+            objetivos[k].clave = p->fecha_vencimiento;
+            objetivos[k++].i = i;
+            p->resultado = TANDA_SIN_LOTE;
+        }
+    }
+    if (!reservado) {
+        free(objetivos);
+        return 0;
+    }
+    
+    // Resolver las fechas en un barrido en orden
+    qsort(objetivos, k, sizeof(ObjetivoTanda), comparar_objetivos);
+    Node *actual = NULL;
+    for (size_t j = 0; j < k; j++) {
+        PedidoTanda *p = &pedidos[objetivos[j].i];
+        Node *lote = actual ? tanda_avanzar(actual, p->fecha_vencimiento)
+                            : iterador_rango(root, p->fecha_vencimiento, INT_MAX).actual;
+        if (!lote) break;  // Las fechas restantes son posteriores al ultimo lote
+        actual = lote;
+        if (lote->fecha_vencimiento == p->fecha_vencimiento) p->lote = lote;
+    }
+    
+    // Agrupar por lote (estable: dentro del lote se respeta el orden de entrada);
+    // cada grupo fija el resultado de sus pedidos. Con solo pedidos por fecha
+    // el barrido ya los dejo agrupados (una fecha resuelve a un unico lote) y
+    // basta con descartar los que no encontraron lote
+    if (por_producto == 0) {
+        size_t m = 0;
+        for (size_t j = 0; j < k; j++) {
+            if (pedidos[objetivos[j].i].lote) objetivos[m++] = objetivos[j];
+        }
+        k = m;
+    } else {
+        k = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (!pedidos[i].lote) continue;
+            objetivos[k].clave = clave_de(pedidos[i].lote);
+            objetivos[k++].i = i;
+        }
+        qsort(objetivos, k, sizeof(ObjetivoTanda), comparar_objetivos);
+    }
+    for (size_t j = 0; j < k; ) {
+        Node *lote = pedidos[objetivos[j].i].lote;
+        size_t m = 1;
+        while (j + m < k && pedidos[objetivos[j + m].i].lote == lote) m++;
+        tanda_decidir_grupo(lote, pedidos, objetivos + j, m);
+        j += m;
+    }
+    
+    // IDs en el orden de entrada de la tanda, no en el de los lotes
+    bloquear_pedidos();
+    for (size_t i = 0; i < n; i++) {
+        if (pedidos[i].resultado == TANDA_REGISTRADO) pedidos[i].id = siguiente_id_pedido++;
+    }
+    desbloquear_pedidos();
+    
+    size_t registrados = 0;
+    for (size_t j = 0; j < k; ) {
+        Node *lote = pedidos[objetivos[j].i].lote;
+        size_t m = 1;
+        while (j + m < k && pedidos[objetivos[j + m].i].lote == lote) m++;
+        registrados += (size_t)tanda_encolar_grupo(lote, pedidos, objetivos + j, m);
+        j += m;
+    }
+    free(objetivos);
+    return registrados;
+}
+
+
+#ifdef INVENTARIO_CONCURRENTE
+size_t despachar_tanda_concurrente(Node **root, PedidoTanda *pedidos, size_t n) {
+    // Excluye a las terminales mientras dura la tanda
+    inventario_escribir();
+    size_t registrados = despachar_tanda(*root, pedidos, n);
+    inventario_soltar();
+    return registrados;
+}
+#endif
+
+
+/**
+ * Modo por lotes (sin menu): ingesta de lotes y pedidos desde un archivo
+ *
+ *   distribucion --ingesta <archivo|->
+ *
+ * Una instruccion por linea, campos separados por comas (sin comillas):
+ *   L,<fecha>,<producto>,<stock>          Recepcion de un lote
+ *   P,<fecha|*>,<destino>,<cantidad>      Pedido sobre el lote de esa fecha, o '*'
+ *                                         para repartirlo en orden de vencimiento
+ *                                         (FEFO) entre los lotes necesarios
+ * Fechas en AAAAMMDD, AAAA-MM-DD o DD/MM/AAAA. Las lineas vacias y las que
+ * empiezan con '#' se ignoran.
+ */
+#define INGESTA_BUFFER (1 << 20)          // Bytes leidos por bloque
+#define INGESTA_LOTES 65536               // Lotes acumulados por insercion masiva
+#define INGESTA_PEDIDOS 8192              // Pedidos con fecha por tanda
+#define INGESTA_CAMPOS 4                  // Campos por instruccion
+
+/**
+ * Estructura LectorLineas: Lector de lineas sobre un buffer grande
+ */
+typedef struct LectorLineas {
+    FILE *archivo;                    // Origen de los datos
+    char *buffer;                     // INGESTA_BUFFER bytes + terminador
+    size_t inicio, fin;               // Bytes aun no consumidos: [inicio, fin)
+    bool eof;                         // Ya no quedan datos por leer del archivo
+} LectorLineas;
+
+/**
+ * Estructura TandaIngesta: Pedidos con fecha a la espera de despachar_tanda
+ */
+typedef struct TandaIngesta {
+    PedidoTanda *pedidos;
+    long *lineas;                     // Linea de cada pedido, para los mensajes
+    size_t n;
+} TandaIngesta;
+
+/**
+ * Estructura ResumenIngesta: Contadores del modo por lotes
+ */
+typedef struct ResumenIngesta {
+    long lotes_insertados, lotes_omitidos;
+    long pedidos_registrados, pedidos_rechazados;
+    long lineas_invalidas;
+    TandaIngesta tanda;
+} ResumenIngesta;
+
+
+char* leer_linea_bloque(LectorLineas *l) {
+    while (1) {
+        // Buscar el fin de linea dentro de lo ya leido
+        char *inicio = l->buffer + l->inicio;
+        char *nl = (char*)memchr(inicio, '\n', l->fin - l->inicio);
+        if (!nl && l->eof && l->inicio < l->fin) nl = l->buffer + l->fin;  // Ultima linea sin '\n'
+        if (!nl && l->fin - l->inicio == INGESTA_BUFFER) nl = l->buffer + l->fin;  // Linea demasiado larga
+        if (nl) {
+            *nl = '\0';
+            l->inicio = (size_t)(nl - l->buffer) + (nl < l->buffer + l->fin ? 1 : 0);
+            if (nl > inicio && nl[-1] == '\r') nl[-1] = '\0';  // Fin de linea CRLF
+            return inicio;
+        }
+        if (l->eof) return NULL;
+        
+        // Mover el resto al principio y leer el siguiente bloque
+        size_t resto = l->fin - l->inicio;
+        memmove(l->buffer, inicio, resto);
+        l->inicio = 0;
+        l->fin = resto;
+        size_t leidos = fread(l->buffer + l->fin, 1, INGESTA_BUFFER - l->fin, l->archivo);
+        l->fin += leidos;
+        if (leidos == 0) l->eof = true;
+    }
+}
+
+
+int separar_campos(char *linea, char **campos, int max_campos) {
+    int n = 0;
+    campos[n++] = linea;
+    for (char *p = linea; *p; p++) {
+        if (*p == ',') {
+            if (n == max_campos) return -1;  // Sobran campos
+            *p = '\0';
+            campos[n++] = p + 1;
+        }
+    }
+    return n;
+}
+
+
+int parsear_fecha_rapida(const char *s) {
+    // Posiciones de AAAA, MM y DD segun el formato, deducido de la longitud y separadores
+    static const unsigned char dias_mes[16] = {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31, 0, 0, 0};
+    size_t len = strlen(s);
+    int pa, pm, pd;
+    if (len == 8) { pa = 0; pm = 4; pd = 6; }                                    // AAAAMMDD
+    else if (len == 10 && s[4] == '-' && s[7] == '-') { pa = 0; pm = 5; pd = 8; } // AAAA-MM-DD
+    else if (len == 10 && s[2] == '/' && s[5] == '/') { pa = 6; pm = 3; pd = 0; } // DD/MM/AAAA
+    else return -1;
+    
+    unsigned d[8] = {
+        (unsigned)(s[pa] - '0'), (unsigned)(s[pa + 1] - '0'), (unsigned)(s[pa + 2] - '0'), (unsigned)(s[pa + 3] - '0'),
+        (unsigned)(s[pm] - '0'), (unsigned)(s[pm + 1] - '0'), (unsigned)(s[pd] - '0'), (unsigned)(s[pd + 1] - '0')
+    };
+    unsigned digitos = 1;
+    for (int i = 0; i < 8; i++) digitos &= d[i] <= 9;
+    
+    unsigned anio = d[0] * 1000 + d[1] * 100 + d[2] * 10 + d[3];
+    unsigned mes = d[4] * 10 + d[5];
+    unsigned dia = d[6] * 10 + d[7];
+    
+    // Validacion sin ramas: rangos sin signo y tabla de dias por mes
+    unsigned valida = digitos & (anio - MIN_YEAR <= MAX_YEAR - MIN_YEAR) &
+                      (mes - 1 < 12) & (dia - 1 < dias_mes[mes & 15]);
+    return valida ? (int)(anio * 10000 + mes * 100 + dia) : -1;
+}
+
+
+bool parsear_entero_positivo(const char *s, int *valor) {
+    char *fin;
+    long v = strtol(s, &fin, 10);
+    if (fin == s || *fin != '\0' || v <= 0 || v > 2147483647L) return false;
+    *valor = (int)v;
+    return true;
+}
+
+
+Node* ingesta_aplicar_lotes(Node *root, LoteEntrada *lotes, size_t *n, ResumenIngesta *res) {
+    // Aplicar los lotes acumulados con una sola insercion masiva
+    if (*n == 0) return root;
+    size_t insertados;
+    root = insertar_lotes_masivo(root, lotes, *n, &insertados);
+    for (size_t i = 0; i < *n; i++) {
+        if (lotes[i].insertado) {
+            journal_registrar(JOURNAL_INSERTAR, lotes[i].fecha_vencimiento, 0, lotes[i].stock, 0, lotes[i].producto);
+        }
+    }
+    res->lotes_insertados += (long)insertados;
+    res->lotes_omitidos += (long)(*n - insertados);
+    *n = 0;
+    journal_confirmar(root);
+    return root;
+}
+
+
+void ingesta_aplicar_pedidos(Node *root, ResumenIngesta *res) {
+    // Registrar los pedidos con fecha acumulados en un solo barrido del arbol
+    TandaIngesta *t = &res->tanda;
+    if (t->n == 0) return;
+    res->pedidos_registrados += (long)despachar_tanda(root, t->pedidos, t->n);
+    for (size_t i = 0; i < t->n; i++) {
+        switch (t->pedidos[i].resultado) {
+            case TANDA_REGISTRADO:
+                continue;
+            case TANDA_SIN_LOTE:
+                fprintf(stderr, "linea %ld: no existe el lote del pedido.\n", t->lineas[i]);
+                break;
+            case TANDA_SIN_STOCK:
+                fprintf(stderr, "linea %ld: stock insuficiente en el lote.\n", t->lineas[i]);
+                break;
+            default:
+                fprintf(stderr, "linea %ld: pedido no registrado (error de memoria).\n", t->lineas[i]);
+                break;
+        }
+        res->pedidos_rechazados++;
+    }
+    t->n = 0;
+}
+
+
+Node* ingesta_pedido(Node *root, char **campos, long num_linea, ResumenIngesta *res) {
+    int qty;
+    if (campos[2][0] == '\0' || !parsear_entero_positivo(campos[3], &qty)) {
+        fprintf(stderr, "linea %ld: pedido invalido.\n", num_linea);
+        res->lineas_invalidas++;
+        return root;
+    }
+    
+    // Sin fecha: repartir en orden de vencimiento entre los lotes necesarios
+    // (despues de la tanda pendiente, que descuenta stock antes que este)
+    if (strcmp(campos[1], "*") == 0 || campos[1][0] == '\0') {
+        ingesta_aplicar_pedidos(root, res);
+        if (!root || root->stock_subarbol < qty) {
+            fprintf(stderr, "linea %ld: stock insuficiente en el inventario.\n", num_linea);
+            res->pedidos_rechazados++;
+        } else if (repartir_pedido_fefo(root, campos[2], qty, false) < qty) {
+            fprintf(stderr, "linea %ld: pedido asignado solo en parte (error de memoria).\n", num_linea);
+            res->pedidos_rechazados++;
+        } else {
+            res->pedidos_registrados++;
+        }
+        return root;
+    }
+    
+    // Lote destino: el de la fecha indicada; el pedido espera en la tanda
+    int fecha = parsear_fecha_rapida(campos[1]);
+    if (fecha == -1) {
+        fprintf(stderr, "linea %ld: fecha invalida '%s'.\n", num_linea, campos[1]);
+        res->lineas_invalidas++;
+        return root;
+    }
+    TandaIngesta *t = &res->tanda;
+    PedidoTanda *p = &t->pedidos[t->n];
+    p->fecha_vencimiento = fecha;
+    p->producto[0] = '\0';
+    strncpy(p->destino, campos[2], MAX_DEST - 1);
+    p->destino[MAX_DEST - 1] = '\0';
+    p->cantidad = qty;
+    t->lineas[t->n] = num_linea;
+    if (++t->n == INGESTA_PEDIDOS) ingesta_aplicar_pedidos(root, res);
+    return root;
+}
+
+
+int ejecutar_ingesta(const char *ruta) {
+    FILE *f = strcmp(ruta, "-") == 0 ? stdin : fopen(ruta, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: No se pudo abrir '%s'.\n", ruta);
+        return 1;
+    }
+    
+    // Partir del inventario persistido (instantanea + journal)
+    Node *root = cargar_inventario();
+    if (!journal.archivo) {
+        fprintf(stderr, "Error: No se pudo preparar el inventario; no se aplica la ingesta.\n");
+        if (f != stdin) fclose(f);
+        return 1;
+    }
+    
+    LectorLineas lector = {f, (char*)malloc(INGESTA_BUFFER + 1), 0, 0, false};
+    LoteEntrada *lotes = (LoteEntrada*)malloc(INGESTA_LOTES * sizeof(LoteEntrada));
+    ResumenIngesta res = {0, 0, 0, 0, 0, {NULL, NULL, 0}};
+    res.tanda.pedidos = (PedidoTanda*)malloc(INGESTA_PEDIDOS * sizeof(PedidoTanda));
+    res.tanda.lineas = (long*)malloc(INGESTA_PEDIDOS * sizeof(long));
+    if (!lector.buffer || !lotes || !res.tanda.pedidos || !res.tanda.lineas) {
+        fprintf(stderr, "Error: No hay memoria para la ingesta.\n");
+        free(lector.buffer);
+        free(lotes);
+        free(res.tanda.pedidos);
+        free(res.tanda.lineas);
+        if (f != stdin) fclose(f);
+        return 1;
+    }
+    
+    size_t n = 0;
+    long num_linea = 0;
+    char *linea;
+    while ((linea = leer_linea_bloque(&lector)) != NULL) {
+        num_linea++;
+        if (linea[0] == '\0' || linea[0] == '#') continue;
+        
+        char *campos[INGESTA_CAMPOS];
+        if (separar_campos(linea, campos, INGESTA_CAMPOS) != INGESTA_CAMPOS || campos[0][1] != '\0') {
+            fprintf(stderr, "linea %ld: formato invalido.\n", num_linea);
+            res.lineas_invalidas++;
+            continue;
+        }
+        
+        if (campos[0][0] == 'L') {
+            // Acumular el lote; se inserta cuando se llena el bloque o llega un
+            // pedido. Los pedidos pendientes van antes: no ven lotes posteriores
+            ingesta_aplicar_pedidos(root, &res);
+            LoteEntrada *e = &lotes[n];
+            e->fecha_vencimiento = parsear_fecha_rapida(campos[1]);
+            if (e->fecha_vencimiento == -1 || campos[2][0] == '\0' || !parsear_entero_positivo(campos[3], &e->stock)) {
+                fprintf(stderr, "linea %ld: lote invalido.\n", num_linea);
+                res.lineas_invalidas++;
+                continue;
+            }
+            strncpy(e->producto, campos[2], MAX_NAME - 1);
+            e->producto[MAX_NAME - 1] = '\0';
+            if (++n == INGESTA_LOTES) root = ingesta_aplicar_lotes(root, lotes, &n, &res);
+        } else if (campos[0][0] == 'P') {
+            // Los pedidos pueden referirse a lotes recien leidos
+            root = ingesta_aplicar_lotes(root, lotes, &n, &res);
+            root = ingesta_pedido(root, campos, num_linea, &res);
+        } else {
+            fprintf(stderr, "linea %ld: instruccion desconocida '%s'.\n", num_linea, campos[0]);
+            res.lineas_invalidas++;
+        }
+    }
+    root = ingesta_aplicar_lotes(root, lotes, &n, &res);
+    ingesta_aplicar_pedidos(root, &res);
+    
+    free(lector.buffer);
+    free(lotes);
+    free(res.tanda.pedidos);
+    free(res.tanda.lineas);
+    if (f != stdin) fclose(f);
+    
+    // Compactar: la instantanea queda con todo lo ingerido
+    bool guardado = checkpoint_inventario(root);
+    journal_cerrar();
+    
+    printf("Lotes insertados: %ld | Lotes omitidos (sin memoria): %ld\n", res.lotes_insertados, res.lotes_omitidos);
+    printf("Pedidos registrados: %ld | Pedidos rechazados: %ld\n", res.pedidos_registrados, res.pedidos_rechazados);
+    printf("Lineas invalidas: %ld\n", res.lineas_invalidas);
+    if (!guardado) fprintf(stderr, "Error: No se pudo guardar el inventario.\n");
+    
+    free_tree(root);
+    inventario_destruir();
+    return guardado ? 0 : 1;
+}
+
+
@@ -0,0 +1,301 @@
+/**
+ * inventario.h: Nucleo del inventario de lotes (arbol AVL por fecha de
+ * vencimiento con colas FIFO de pedidos), persistencia y journal
+*/
+#ifndef INVENTARIO_H
+#define INVENTARIO_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Constantes de configuracion */
+#define MAX_NAME 64      // Longitud maxima del nombre del producto
+#define MAX_DEST 64      // Longitud maxima del nombre del destino
+#define MIN_YEAR 2000    // Anio minimo valido para fechas
+#define MAX_YEAR 2100    // Anio maximo valido para fechas
+#define ARCHIVO_DATOS "inventario.dat"  // Archivo para persistencia
+#define ARCHIVO_DATOS_ANTERIOR ARCHIVO_DATOS ".v1"  // Original en el formato anterior ya convertido
+#define ARCHIVO_HISTORIAL "inventario.hist"  // Pedidos despachados (solo agregado)
+
+/**
+ * Estructura Order: Representa un pedido de despacho en la cola FIFO
+*/
+typedef struct Order {
+    uint32_t destino;                 // ID del nombre del destino (tabla de cadenas)
+    int cantidad_solicitada;          // Cantidad solicitada segun especificación
+    uint32_t id;                      // Identificador unico del pedido
+    struct Order *siguiente;          // Puntero al siguiente pedido segun especificación (NULL en el ultimo)
+    struct Order *anterior;           // Pedido anterior; en la cabeza, el ultimo de la cola
+    struct Node *lote;                // Lote en cuya cola esta el pedido
+    struct Order *siguiente_hash;     // Siguiente pedido en el mismo bucket del indice
+} Order;
+
+/**
+ * Estructura Node: Representa un nodo del arbol AVL (un lote de productos)
+ */
+typedef struct Node {
+    // Campos de la busqueda al principio: una bajada lee solo estos 24 bytes
+    int fecha_vencimiento;            // Fecha de vencimiento AAAAMMDD (clave del arbol)
+    uint32_t secuencia;               // Orden de llegada entre los lotes de la misma fecha (desempata la clave)
+    struct Node *left, *right;       // Hijos izquierdo y derecho del arbol AVL
+    struct Node *parent;              // Padre en el arbol AVL (NULL en la raiz)
+    int height;                       // Altura del nodo para balanceo AVL
+    uint32_t producto;                // ID del nombre del producto (tabla de cadenas)
+    int stock_total;                  // Stock total disponible segun especificacion
+    int num_pedidos;                  // Pedidos en la cola FIFO (cache de count_orders)
+    Order *cabeza_pedidos;            // Cabeza de la cola FIFO; su anterior es el ultimo pedido
+    struct Node *producto_anterior;   // Lote anterior del mismo producto (por vencimiento)
+    struct Node *producto_siguiente;  // Lote siguiente del mismo producto
+    long long cantidad_pendiente;     // Suma de cantidades de los pedidos en cola
+    
+    // Agregados del subarbol con raiz en este nodo (incluido el propio nodo)
+    int lotes_subarbol;               // Cantidad de lotes
+    long long stock_subarbol;         // Stock disponible total
+    long pedidos_subarbol;            // Pedidos pendientes
+    long long pendiente_subarbol;     // Cantidad pendiente de despacho
+#ifdef INVENTARIO_CONCURRENTE
+    Order *entrada_pedidos;           // Pedidos recien llegados (pila sin bloqueos, LIFO)
+#endif
+} Node;
+
+
+/**
+ * Estructura LoteEntrada: Lote a ingresar mediante insercion masiva
+ */
+typedef struct LoteEntrada {
+    int fecha_vencimiento;            // Fecha de vencimiento AAAAMMDD
+    char producto[MAX_NAME];          // Nombre del producto
+    int stock;                        // Stock inicial del lote
+    bool insertado;                   // Salida: el lote quedo en el arbol
+} LoteEntrada;
+
+
+/* Resultado de cada pedido de una tanda (despachar_tanda) */
+typedef enum {
+    TANDA_REGISTRADO,                 // Encolado en el lote (id asignado)
+    TANDA_SIN_LOTE,                   // No hay lote de esa fecha o de ese producto
+    TANDA_SIN_STOCK,                  // El lote no alcanza (descontados los pedidos previos de la tanda)
+    TANDA_INVALIDO,                   // Cantidad no positiva o destino vacio
+    TANDA_SIN_MEMORIA                 // No se pudo reservar el pedido
+} ResultadoTanda;
+
+/**
+ * Estructura PedidoTanda: Pedido a registrar mediante despacho por tandas
+ */
+typedef struct PedidoTanda {
+    int fecha_vencimiento;            // Primer lote de esa fecha (0: lote FEFO del producto)
+    char producto[MAX_NAME];          // Producto del pedido (solo con fecha 0)
+    char destino[MAX_DEST];           // Destino del pedido
+    int cantidad;                     // Cantidad solicitada
+    ResultadoTanda resultado;         // Salida: que paso con el pedido
+    uint32_t id;                      // Salida: ID del pedido (0 si no se registro)
+    Node *lote;                       // Salida: lote elegido (NULL si no hay)
+} PedidoTanda;
+
+
+/**
+ * Estructura Totales: Totales acumulados de un conjunto de lotes
+ */
+typedef struct Totales {
+    int lotes;                        // Cantidad de lotes
+    long long stock;                  // Stock disponible
+    long pedidos;                     // Pedidos pendientes
+    long long pendiente;              // Cantidad pendiente de despacho
+} Totales;
+
+
+/**
+ * Estructura IteradorRango: Lotes con desde <= fecha <= hasta, en orden
+ */
+typedef struct IteradorRango {
+    Node *actual;                     // Proximo lote a devolver (NULL al terminar)
+    int hasta;                        // Ultima fecha incluida
+} IteradorRango;
+
+
+/**
+ * Estructura SnapshotCabecera: Cabecera del archivo de instantanea (formato en
+ * inventario.c)
+ */
+typedef struct SnapshotCabecera {
+    char magia[4];                    // Identificador del formato (SNAPSHOT_MAGIA)
+    uint32_t version;                 // Version del formato
+    uint32_t num_nodos;               // Cantidad de lotes
+    uint32_t num_pedidos;             // Cantidad total de pedidos
+    uint32_t tam_cadenas;             // Bytes de la tabla de cadenas
+    uint32_t siguiente_id;            // Proximo ID de pedido (los IDs no se reutilizan)
+    uint32_t checksum;                // FNV-1a de todo lo que sigue a la cabecera
+} SnapshotCabecera;
+
+
+#define JOURNAL_BASE_VACIA 0              // El journal parte de un inventario vacio
+#define JOURNAL_BASE_SNAPSHOT 1           // El journal parte de la instantanea indicada
+
+typedef enum {
+    JOURNAL_INSERTAR = 1,                 // insertAVL(fecha, producto, stock): la secuencia se vuelve a asignar igual
+    JOURNAL_ELIMINAR = 2,                 // deleteNode(fecha, secuencia)
+    JOURNAL_ENCOLAR = 3,                  // enqueue_order(lote, destino, cantidad) -> id, y descuento de stock
+    JOURNAL_CANCELAR = 4,                 // cancel_order_by_id(id)
+    JOURNAL_PURGAR = 5,                   // purgar_vencidos(fecha de corte)
+    JOURNAL_DESPACHAR = 6,                // despachar_pedidos(lote, cantidad de pedidos desde la cabeza)
+    JOURNAL_COMPACTAR = 7                 // compactar_pedidos(lote)
+} JournalTipo;
+
+
+
+/* Reportes: formato y columnas (mascara de bits) */
+typedef enum {
+    REPORTE_TEXTO,                        // Reporte de estado del menu
+    REPORTE_JSON,                         // Objeto con el arreglo de lotes y los totales
+    REPORTE_CSV                           // Una fila por lote (o por pedido con el detalle)
+} FormatoReporte;
+
+#define COLUMNA_PRODUCTO 0x01             // Nombre del producto
+#define COLUMNA_FECHA 0x02                // Fecha de vencimiento
+#define COLUMNA_STOCK 0x04                // Stock disponible
+#define COLUMNA_PEDIDOS 0x08              // Cantidad de pedidos en cola
+#define COLUMNA_DETALLE 0x10              // Cada pedido de la cola
+#define COLUMNAS_TODAS 0x1f
+#define COLUMNAS_RESUMEN 0                // Sin columnas: solo los totales del inventario
+
+/* Fechas */
+int convertir_fecha_a_int(int dia, int mes, int anio);
+char* formatear_fecha(int fecha);
+bool validar_fecha(int fecha);
+
+/* Tabla de cadenas (nombres internados como IDs de 32 bits) */
+uint32_t cadena_internar(const char *s);
+uint32_t cadena_buscar(const char *s);
+const char* cadena_texto(uint32_t id);
+
+/* Arbol de lotes */
+Node* insertAVL(Node *root, int fecha, const char *producto, int stock);
+Node* insertar_lotes_masivo(Node *root, LoteEntrada *lotes, size_t n, size_t *insertados);
+Node* deleteNode(Node* root, int fecha, uint32_t secuencia);
+Node* searchNode(Node *root, int fecha);
+Node* buscar_lote(Node *root, int fecha, uint32_t secuencia);
+Node* findNode(Node *root, int fecha);
+Node* buscar_lote_minimo(Node *root);
+Node* siguiente_inorden(Node *n);
+void ajustar_stock(Node *n, int delta);
+Totales totales_rango(Node *root, int desde, int hasta);
+IteradorRango iterador_rango(Node *root, int desde, int hasta);
+Node* iterador_rango_siguiente(IteradorRango *it);
+Node* purgar_vencidos(Node *root, int corte, Totales *quitados);
+void free_tree(Node *root);
+void inventario_destruir(void);
+
+/* Pedidos */
+uint32_t enqueue_order(Node *node, const char *destino, int cantidad);
+int count_orders(Node *node);
+Order* buscar_pedido(Node *node, const char *destino, int cantidad);
+Order* buscar_pedido_por_id(uint32_t id);
+int cancel_order_in_node(Node *node, const char *destino, int cantidad);
+int cancel_order_by_id(uint32_t id);
+int repartir_pedido_fefo(Node *root, const char *destino, int cantidad, bool informar);
+/* Con INVENTARIO_CONCURRENTE, despachar_tanda exige el bloqueo de escritura del
+ * inventario (lee el stock sin reservar_stock): despachar_tanda_concurrente lo toma */
+size_t despachar_tanda(Node *root, PedidoTanda *pedidos, size_t n);
+
+/* Despacho desde la cabeza de la cola, compactacion e historial. El limite por
+ * lote se aplica en enqueue_order, los repartos y despachar_tanda (no en
+ * encolar_pedido_concurrente) */
+uint32_t dequeue_order(Node *node);
+int despachar_pedidos(Node *node, int maximo);
+int compactar_pedidos(Node *node);
+bool historial_abrir(const char *ruta);
+void historial_cerrar(void);
+bool limitar_cola_pedidos(int maximo);
+
+/* Indice por producto (lotes de cada producto en orden de vencimiento) */
+Node* producto_lote_fefo(Node *root, const char *producto);
+Totales totales_producto(Node *root, const char *producto);
+int repartir_pedido_producto(Node *root, const char *producto, const char *destino, int cantidad, bool informar);
+
+/* Reportes */
+void mostrar_pedidos(Node *node);
+void inorder_report(Node *root);
+bool reporte_inventario(Node *root, FILE *archivo, FormatoReporte formato, unsigned columnas);
+
+/* Persistencia: instantanea, journal y checkpoint */
+bool guardar_arbol(Node *root, const char *filename);
+Node* cargar_arbol(const char *filename);
+Node* cargar_arbol_legado(const char *filename, bool *fallo);
+bool archivo_formato_anterior(const char *filename);
+void* mapear_archivo(const char *filename, size_t *tam);
+void desmapear_archivo(void *datos, size_t tam);
+bool snapshot_validar(const char *datos, size_t tam);
+Node* snapshot_cargar(void *mapeo, size_t tam);
+bool snapshot_leer_cabecera(const char *filename, SnapshotCabecera *cab);
+bool journal_abrir(uint32_t base_tipo, uint32_t base_checksum);
+void journal_registrar(JournalTipo tipo, int fecha, uint32_t secuencia, int cantidad, uint32_t id, const char *cadena);
+void journal_confirmar(Node *root);
+void journal_cerrar(void);
+void journal_desactivar(void);
+bool checkpoint_inventario(Node *root);
+Node* cargar_inventario(void);
+Node* cargar_inventario_anterior(void);
+int ejecutar_ingesta(const char *ruta);
+
+#ifdef CARGA_PARALELA
+/* Hilos que arman la instantanea al cargarla (0: uno por nucleo) */
+void configurar_hilos_carga(int hilos);
+#endif
+
+#if !defined(VERSIONES) && !defined(INVENTARIO_CONCURRENTE)
+/* Estado de un arbol inactivo (varios inventarios en un proceso, ver almacenes.h) */
+typedef struct EstadoInventario EstadoInventario;
+EstadoInventario* estado_crear(void);
+void estado_intercambiar(EstadoInventario *e);
+void estado_destruir(EstadoInventario *e);
+#endif
+
+#ifdef VERSIONES
+/* Guardado en segundo plano de la version actual */
+bool guardado_iniciar(void);
+int guardado_recoger(bool esperar);
+bool guardado_en_curso(void);
+#define guardado_esperar() ((void)guardado_recoger(true))
+#else
+#define guardado_esperar() ((void)0)
+#endif
+
+#ifdef ESTADISTICAS
+/* Metricas internas */
+#define ARCHIVO_ESTADISTICAS "inventario.stats"  // Volcado legible por maquina
+void estadisticas_reporte(Node *root);
+bool estadisticas_volcar(Node *root, const char *ruta);
+#endif
+
+#ifdef VERIFICAR
+/**
+ * Estructura ContadoresMemoria: Elementos de los pools de lotes y pedidos
+ */
+typedef struct ContadoresMemoria {
+    long lotes_vivos;                 // Lotes reservados y no devueltos
+    long pedidos_vivos;               // Pedidos reservados y no devueltos
+    unsigned long long reservas_lotes;    // Lotes entregados desde el inicio
+    unsigned long long reservas_pedidos;  // Pedidos entregados desde el inicio
+} ContadoresMemoria;
+
+/* Invariantes del arbol, las colas y los pools (falso si alguno no se cumple) */
+bool verificar_inventario(Node *root, FILE *informe);
+ContadoresMemoria contadores_memoria(void);
+#endif
+
+#ifdef INVENTARIO_CONCURRENTE
+/* Operaciones seguras entre hilos sobre el inventario compartido */
+uint32_t encolar_pedido_concurrente(Node *lote, const char *destino, int cantidad);
+uint32_t registrar_pedido_concurrente(Node **root, int fecha, const char *destino, int cantidad);
+int cancelar_pedido_concurrente(uint32_t id);
+void reporte_concurrente(Node **root);
+bool insertar_lote_concurrente(Node **root, int fecha, const char *producto, int stock);
+bool eliminar_lote_concurrente(Node **root, int fecha, uint32_t secuencia);
+void drenar_todas(Node *root);
+void confirmar_concurrente(Node **root);
+size_t despachar_tanda_concurrente(Node **root, PedidoTanda *pedidos, size_t n);
+#endif
+
+#endif
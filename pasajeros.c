@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "pasajeros.h"
+
+// Manifiesto global del muelle (listas por destino y contadores)
+Manifiesto manifiesto;
+
+const char *NOMBRES_DESTINO[NUM_DESTINOS] = {"Timbiqui", "Juanchaco", "Tumaco", "Guapi"};
+const char *NOMBRES_TIPO[NUM_TIPOS_PASAJE] = {"Ida", "Ida y Regreso"};
+
+// Comparar sin distinguir mayusculas (el menu acepta "tumaco" o "TUMACO")
+int igualesSinMayusculas(const char *a, const char *b) {
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return *a == '\0' && *b == '\0';
+}
+
+// Destino a partir de su nombre o de su numero en el menu (1..NUM_DESTINOS)
+Destino destinoDesdeTexto(const char *texto) {
+    int numero = atoi(texto);
+    if (numero >= 1 && numero <= NUM_DESTINOS) return (Destino)(numero - 1);
+    for (int d = 0; d < NUM_DESTINOS; d++) {
+        if (igualesSinMayusculas(texto, NOMBRES_DESTINO[d])) return (Destino)d;
+    }
+    return DESTINO_INVALIDO;
+}
+
+// Tipo de pasaje a partir de su nombre o de su numero en el menu
+TipoPasaje tipoDesdeTexto(const char *texto) {
+    int numero = atoi(texto);
+    if (numero >= 1 && numero <= NUM_TIPOS_PASAJE) return (TipoPasaje)(numero - 1);
+    for (int t = 0; t < NUM_TIPOS_PASAJE; t++) {
+        if (igualesSinMayusculas(texto, NOMBRES_TIPO[t])) return (TipoPasaje)t;
+    }
+    return PASAJE_INVALIDO;
+}
+
+const char* nombreDestino(Destino d) {
+    return d >= 0 && d < NUM_DESTINOS ? NOMBRES_DESTINO[d] : "?";
+}
+
+const char* nombreTipo(TipoPasaje t) {
+    return t >= 0 && t < NUM_TIPOS_PASAJE ? NOMBRES_TIPO[t] : "?";
+}
+
+// Crear un nuevo nodo
+Pasajero* nuevoPasajero(int documento, Destino destino, TipoPasaje tipo) {
+    Pasajero *p = (Pasajero*)malloc(sizeof(Pasajero));
+    if (p == NULL) {
+        printf("Error: no hay memoria para el pasajero.\n");
+        return NULL;
+    }
+    p->documento = documento;
+    p->destino = (unsigned char)destino;
+    p->tipo_pasaje = (unsigned char)tipo;
+    p->bote = 0;
+    p->izq = p->der = NULL;
+    p->altura = 1;
+    p->tamano = 1;
+    p->ant_destino = p->sig_destino = NULL;
+    return p;
+}
+
+// Agregar un pasajero al final de la lista de su destino
+void agregarADestino(Pasajero *p) {
+    int d = p->destino;
+    p->ant_destino = manifiesto.ultimo[d];
+    p->sig_destino = NULL;
+    if (manifiesto.ultimo[d]) manifiesto.ultimo[d]->sig_destino = p;
+    else manifiesto.primero[d] = p;
+    manifiesto.ultimo[d] = p;
+    // Los embarcados son un prefijo: si todos lo estaban, este es el primero sin bote
+    if (manifiesto.sin_bote[d] == NULL) manifiesto.sin_bote[d] = p;
+    manifiesto.por_tipo[d][p->tipo_pasaje]++;
+}
+
+// Sacar un pasajero de la lista de su destino y de los contadores
+void quitarDeDestino(Pasajero *p) {
+    int d = p->destino;
+    if (p->ant_destino) p->ant_destino->sig_destino = p->sig_destino;
+    else manifiesto.primero[d] = p->sig_destino;
+    if (p->sig_destino) p->sig_destino->ant_destino = p->ant_destino;
+    else manifiesto.ultimo[d] = p->ant_destino;
+    if (manifiesto.sin_bote[d] == p) manifiesto.sin_bote[d] = p->sig_destino;
+    manifiesto.por_tipo[d][p->tipo_pasaje]--;
+    if (p->bote) manifiesto.embarcados[d]--;
+}
+
+// Pasar los datos y el lugar en el manifiesto de un nodo a otro (eliminar con
+// dos hijos reutiliza el nodo y descarta el del sucesor)
+void moverEnDestino(Pasajero *desde, Pasajero *hacia) {
+    int d = desde->destino;
+    hacia->documento = desde->documento;
+    hacia->destino = desde->destino;
+    hacia->tipo_pasaje = desde->tipo_pasaje;
+    hacia->bote = desde->bote;
+    hacia->ant_destino = desde->ant_destino;
+    hacia->sig_destino = desde->sig_destino;
+    if (hacia->ant_destino) hacia->ant_destino->sig_destino = hacia;
+    else manifiesto.primero[d] = hacia;
+    if (hacia->sig_destino) hacia->sig_destino->ant_destino = hacia;
+    else manifiesto.ultimo[d] = hacia;
+    if (manifiesto.sin_bote[d] == desde) manifiesto.sin_bote[d] = hacia;
+}
+
+int tamano(Pasajero *p) {
+    return p ? p->tamano : 0;
+}
+
+// Nucleo AVL generico instanciado para Pasajero: la clave es el documento y
+// cada nodo guarda ademas el tamano de su subarbol
+#define AVL_TIPO Pasajero
+#define AVL_PREFIJO pasajero
+#define AVL_CLAVE int
+#define AVL_COMPARAR(c, n) (((c) > (n)->documento) - ((c) < (n)->documento))
+#define AVL_IZQ izq
+#define AVL_DER der
+#define AVL_ALTURA altura
+#define AVL_ACTUALIZAR(n) ((n)->tamano = 1 + tamano((n)->izq) + tamano((n)->der))
+#include "avl_nucleo.h"
+
+int altura(Pasajero *p) {
+    return pasajero_altura(p);
+}
+
+// Insertar en el AVL (iterativo: se guardan los enlaces del camino y se
+// rebalancea al subir, asi la altura queda en O(log n))
+Pasajero* insertar(Pasajero *raiz, int documento, Destino destino, TipoPasaje tipo) {
+    if (destino < 0 || destino >= NUM_DESTINOS || tipo < 0 || tipo >= NUM_TIPOS_PASAJE) {
+        printf("Destino o tipo de pasaje invalido, no se inserta.\n");
+        return raiz;
+    }
+    Pasajero **camino[MAX_ALTURA];
+    int n = 0;
+    Pasajero **enlace = &raiz;
+    while (*enlace != NULL) {
+        camino[n++] = enlace;
+        if (documento < (*enlace)->documento) {
+            enlace = &(*enlace)->izq;
+        } else if (documento > (*enlace)->documento) {
+            enlace = &(*enlace)->der;
+        } else {
+            printf("El documento ya existe, no se inserta.\n");
+            return raiz;
+        }
+    }
+    *enlace = nuevoPasajero(documento, destino, tipo);
+    if (*enlace == NULL) return raiz;
+    agregarADestino(*enlace);
+    pasajero_rebalancear_camino(camino, n);
+    return raiz;
+}
+
+// Mostrar un pasajero
+void mostrarPasajero(Pasajero *r) {
+    printf("Doc: %d | Destino: %s | Tipo: %s", r->documento,
+           nombreDestino((Destino)r->destino), nombreTipo((TipoPasaje)r->tipo_pasaje));
+    if (r->bote) printf(" | Bote: %d", r->bote);
+    printf("\n");
+}
+
+// Recorrido INORDEN (Morris: memoria O(1), sin pila ni recursion).
+// Cada subarbol izquierdo se enlaza temporalmente con su sucesor y el enlace
+// se deshace al volver, asi que el arbol queda igual al terminar.
+void inorden(Pasajero *r) {
+    while (r != NULL) {
+        if (r->izq == NULL) {
+            mostrarPasajero(r);
+            r = r->der;
+        } else {
+            Pasajero *pred = r->izq;
+            while (pred->der != NULL && pred->der != r) pred = pred->der;
+            if (pred->der == NULL) {
+                pred->der = r;      // Enlace temporal al sucesor
+                r = r->izq;
+            } else {
+                pred->der = NULL;   // Restaurar el arbol
+                mostrarPasajero(r);
+                r = r->der;
+            }
+        }
+    }
+}
+
+// Recorrido PREORDEN (Morris: se visita el nodo al crear el enlace temporal)
+void preorden(Pasajero *r) {
+    while (r != NULL) {
+        if (r->izq == NULL) {
+            mostrarPasajero(r);
+            r = r->der;
+        } else {
+            Pasajero *pred = r->izq;
+            while (pred->der != NULL && pred->der != r) pred = pred->der;
+            if (pred->der == NULL) {
+                mostrarPasajero(r);
+                pred->der = r;
+                r = r->izq;
+            } else {
+                pred->der = NULL;
+                r = r->der;
+            }
+        }
+    }
+}
+
+// Pila explicita para los recorridos que no admiten Morris
+typedef struct Pila {
+    Pasajero **datos;
+    int tope;
+    int capacidad;
+} Pila;
+
+int apilar(Pila *p, Pasajero *n) {
+    if (p->tope == p->capacidad) {
+        int capacidad = p->capacidad ? p->capacidad * 2 : 64;
+        Pasajero **datos = (Pasajero**)realloc(p->datos, capacidad * sizeof(Pasajero*));
+        if (datos == NULL) return 0;
+        p->datos = datos;
+        p->capacidad = capacidad;
+    }
+    p->datos[p->tope++] = n;
+    return 1;
+}
+
+// Recorrido POSTORDEN (iterativo con pila explicita en el heap)
+void postorden(Pasajero *r) {
+    Pila pila = {NULL, 0, 0};
+    Pasajero *ultimo = NULL;    // Ultimo nodo visitado
+    while (r != NULL || pila.tope > 0) {
+        if (r != NULL) {
+            if (!apilar(&pila, r)) {
+                printf("Error: no hay memoria para el recorrido.\n");
+                break;
+            }
+            r = r->izq;
+        } else {
+            Pasajero *cima = pila.datos[pila.tope - 1];
+            if (cima->der != NULL && cima->der != ultimo) {
+                r = cima->der;      // Falta recorrer el subarbol derecho
+            } else {
+                mostrarPasajero(cima);
+                ultimo = cima;
+                pila.tope--;
+            }
+        }
+    }
+    free(pila.datos);
+}
+
+// Liberar todos los nodos (postorden iterativo con la misma pila)
+void liberarArbol(Pasajero *r) {
+    Pila pila = {NULL, 0, 0};
+    if (r != NULL && !apilar(&pila, r)) return;
+    while (pila.tope > 0) {
+        Pasajero *n = pila.datos[--pila.tope];
+        if ((n->izq != NULL && !apilar(&pila, n->izq)) ||
+            (n->der != NULL && !apilar(&pila, n->der))) {
+            printf("Error: no hay memoria para liberar el arbol.\n");
+            break;
+        }
+        free(n);
+    }
+    free(pila.datos);
+    // Con el arbol se va todo el manifiesto
+    memset(&manifiesto, 0, sizeof(manifiesto));
+}
+
+// Contar nodos (O(1): cada nodo guarda el tamano de su subarbol)
+int contar(Pasajero *r) {
+    return tamano(r);
+}
+
+// Buscar un pasajero por documento (O(log n))
+Pasajero* buscar(Pasajero *r, int documento) {
+    return pasajero_buscar(r, documento);
+}
+
+// Buscar el menor (para eliminación)
+Pasajero* minimo(Pasajero* r) {
+    return pasajero_minimo(r);
+}
+
+// Eliminar un pasajero (iterativo, sobre el enlace que apunta al nodo, y
+// rebalanceando el camino al terminar)
+Pasajero* eliminar(Pasajero *r, int documento) {
+    Pasajero **camino[MAX_ALTURA];
+    int n = 0;
+    Pasajero **enlace = &r;
+    while (*enlace != NULL && (*enlace)->documento != documento) {
+        camino[n++] = enlace;
+        enlace = documento < (*enlace)->documento ? &(*enlace)->izq : &(*enlace)->der;
+    }
+    Pasajero *nodo = *enlace;
+    if (nodo == NULL) return r;
+    camino[n++] = enlace;
+    quitarDeDestino(nodo);
+
+    if (nodo->izq == NULL) {
+        *enlace = nodo->der;
+        free(nodo);
+    } else if (nodo->der == NULL) {
+        *enlace = nodo->izq;
+        free(nodo);
+    } else {
+        // Dos hijos: el nodo toma los datos del sucesor (y su lugar en el
+        // manifiesto) y se desengancha el sucesor
+        Pasajero **enlace_suc = &nodo->der;
+        while ((*enlace_suc)->izq != NULL) {
+            camino[n++] = enlace_suc;
+            enlace_suc = &(*enlace_suc)->izq;
+        }
+        Pasajero *temp = *enlace_suc;
+        moverEnDestino(temp, nodo);
+        *enlace_suc = temp->der;
+        free(temp);
+    }
+    pasajero_rebalancear_camino(camino, n);
+    return r;
+}
+
+// Pasajeros registrados para un destino (O(1))
+int pasajerosDestino(Destino d) {
+    int total = 0;
+    for (int t = 0; t < NUM_TIPOS_PASAJE; t++) total += manifiesto.por_tipo[d][t];
+    return total;
+}
+
+// Pasajeros de un destino con un tipo de pasaje (O(1))
+int pasajerosTipo(Destino d, TipoPasaje t) {
+    return manifiesto.por_tipo[d][t];
+}
+
+// Pasajeros de todos los destinos con un tipo de pasaje (O(1))
+int contarTipo(TipoPasaje t) {
+    int total = 0;
+    for (int d = 0; d < NUM_DESTINOS; d++) total += manifiesto.por_tipo[d][t];
+    return total;
+}
+
+// Pasajeros de un destino que aun no tienen bote (O(1))
+int sinEmbarcar(Destino d) {
+    return pasajerosDestino(d) - manifiesto.embarcados[d];
+}
+
+// Mostrar los pasajeros de un destino en orden de registro (O(k))
+void mostrarDestino(Destino d) {
+    for (Pasajero *p = manifiesto.primero[d]; p != NULL; p = p->sig_destino) {
+        mostrarPasajero(p);
+    }
+}
+
+// Llenar el proximo bote de un destino con hasta `capacidad` pasajeros sin
+// embarcar, en orden de registro. Devuelve el primero del bote (el resto sigue
+// por sig_destino con el mismo numero de bote) o NULL si no hay a quien embarcar
+Pasajero* llenarBote(Destino d, int capacidad, int *asignados) {
+    Pasajero *primero = manifiesto.sin_bote[d];
+    *asignados = 0;
+    if (primero == NULL || capacidad <= 0) return NULL;
+
+    int bote = ++manifiesto.botes[d];
+    Pasajero *p = primero;
+    while (p != NULL && *asignados < capacidad) {
+        p->bote = bote;
+        (*asignados)++;
+        p = p->sig_destino;
+    }
+    manifiesto.sin_bote[d] = p;
+    manifiesto.embarcados[d] += *asignados;
+    return primero;
+}
@@ -0,0 +1,78 @@
+// Nucleo del arbol AVL de pasajeros (clave: documento)
+#ifndef PASAJEROS_H
+#define PASAJEROS_H
+
+// Destinos del muelle y tipos de pasaje, codificados como enteros pequenos
+typedef enum {
+    DESTINO_TIMBIQUI,
+    DESTINO_JUANCHACO,
+    DESTINO_TUMACO,
+    DESTINO_GUAPI,
+    NUM_DESTINOS,
+    DESTINO_INVALIDO = -1
+} Destino;
+
+typedef enum {
+    PASAJE_IDA,
+    PASAJE_IDA_Y_REGRESO,
+    NUM_TIPOS_PASAJE,
+    PASAJE_INVALIDO = -1
+} TipoPasaje;
+
+// Estructura del pasajero (nodo del árbol)
+typedef struct Pasajero {
+    int documento; 
+    unsigned char destino;          // Destino
+    unsigned char tipo_pasaje;      // TipoPasaje
+    int bote;                       // Bote asignado (0 = sin embarcar)
+    struct Pasajero *izq;
+    struct Pasajero *der;
+    int altura;     // Altura del subarbol (AVL)
+    int tamano;     // Pasajeros en el subarbol, para contar en O(1)
+    struct Pasajero *ant_destino;   // Pasajero anterior del mismo destino (orden de registro)
+    struct Pasajero *sig_destino;   // Pasajero siguiente del mismo destino
+} Pasajero;
+
+// Manifiesto por destino: lista en orden de registro y contadores que
+// mantienen insertar y eliminar. Los embarcados son siempre un prefijo de la
+// lista, asi que el primero sin bote marca desde donde llenar el proximo
+typedef struct Manifiesto {
+    Pasajero *primero[NUM_DESTINOS];
+    Pasajero *ultimo[NUM_DESTINOS];
+    Pasajero *sin_bote[NUM_DESTINOS];          // Primer pasajero sin embarcar
+    int por_tipo[NUM_DESTINOS][NUM_TIPOS_PASAJE];
+    int embarcados[NUM_DESTINOS];
+    int botes[NUM_DESTINOS];                   // Botes llenados por destino
+} Manifiesto;
+
+// Altura maxima de un AVL con enteros de 32 bits como clave: 1.44*log2(2^32) < 48
+#define MAX_ALTURA 64
+
+Destino destinoDesdeTexto(const char *texto);
+TipoPasaje tipoDesdeTexto(const char *texto);
+const char* nombreDestino(Destino d);
+const char* nombreTipo(TipoPasaje t);
+
+Pasajero* nuevoPasajero(int documento, Destino destino, TipoPasaje tipo);
+int altura(Pasajero *p);
+int tamano(Pasajero *p);
+Pasajero* insertar(Pasajero *raiz, int documento, Destino destino, TipoPasaje tipo);
+void mostrarPasajero(Pasajero *r);
+void inorden(Pasajero *r);
+void preorden(Pasajero *r);
+void postorden(Pasajero *r);
+int contar(Pasajero *r);
+Pasajero* buscar(Pasajero *r, int documento);
+Pasajero* minimo(Pasajero* r);
+Pasajero* eliminar(Pasajero *r, int documento);
+void liberarArbol(Pasajero *r);
+
+// Manifiesto (O(1) los conteos, O(k) los listados de k pasajeros)
+int pasajerosDestino(Destino d);
+int pasajerosTipo(Destino d, TipoPasaje t);
+int contarTipo(TipoPasaje t);
+int sinEmbarcar(Destino d);
+void mostrarDestino(Destino d);
+Pasajero* llenarBote(Destino d, int capacidad, int *asignados);
+
+#endif